@@ -0,0 +1,309 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "arch/cpu_topology.h"
+
+#ifdef __x86_64__
+#include <cpuid.h>
+#endif
+
+namespace spec {
+
+static bool read_line(const std::string& path, std::string& line) {
+    std::ifstream in(path);
+    if (!in || !std::getline(in, line)) {
+        return false;
+    }
+    while (!line.empty() && isspace((unsigned char)line.back())) {
+        line.pop_back();
+    }
+    return true;
+}
+
+static bool read_uint(const std::string& path, unsigned& v) {
+    std::string line;
+    if (!read_line(path, line) || line.empty()) {
+        return false;
+    }
+    v = strtoul(line.c_str(), nullptr, 10);
+    return true;
+}
+
+// "0-3,8,10-11"
+static std::vector<unsigned> parse_cpulist(const std::string& s) {
+    std::vector<unsigned> cpus;
+    const char *p = s.c_str();
+    while (*p) {
+        char *end;
+        unsigned first = strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        unsigned last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned c = first; c <= last && c < 65536; ++c) {
+            cpus.push_back(c);
+        }
+        if (*p == ',') {
+            ++p;
+        }
+    }
+    return cpus;
+}
+
+// "32K", "1024K", "8M"
+static size_t parse_size(const std::string& s) {
+    char *end;
+    size_t v = strtoull(s.c_str(), &end, 10);
+    switch (*end) {
+    case 'K':
+        return v << 10;
+    case 'M':
+        return v << 20;
+    case 'G':
+        return v << 30;
+    default:
+        return v;
+    }
+}
+
+static size_t pow2_floor(size_t v) {
+    size_t p = 1;
+    while (p * 2 <= v) {
+        p *= 2;
+    }
+    return p;
+}
+
+const cpu_topology& cpu_topology::get() {
+    static const cpu_topology topo = [] {
+        cpu_topology t;
+        t.probe("/sys/devices/system");
+        return t;
+    }();
+    return topo;
+}
+
+void cpu_topology::probe(const std::string& sysfs_root) {
+    caches.clear();
+    if (probe_cpuid() != 0) {
+        probe_sysfs_cache(sysfs_root);
+    }
+
+    size_t l1d = 0, l2 = 0, l3 = 0;
+    for (const auto& c : caches) {
+        if (c.level == 1 && c.type != 'I') {
+            l1d = c.size;
+            if (c.line_size) {
+                cache_line_size = c.line_size;
+            }
+        } else if (c.level == 2) {
+            l2 = c.size;
+        } else if (c.level == 3) {
+            l3 = c.size;
+        }
+    }
+    if (l1d) {
+        l1d_size = l1d;
+    }
+    if (l2) {
+        l2_size = l2;
+    }
+    l3_size = l3;
+
+    probe_sysfs_topology(sysfs_root);
+}
+
+int cpu_topology::probe_cpuid() {
+#ifdef __x86_64__
+    unsigned eax, ebx, ecx, edx;
+    unsigned max_level = __get_cpuid_max(0, &ebx);
+    if (max_level == 0) {
+        return -1;
+    }
+
+    // "GenuineIntel" or "AuthenticAMD"/"HygonGenuine"
+    unsigned leaf = 0;
+    __cpuid(0, eax, ebx, ecx, edx);
+    if (ebx == 0x756e6547 && max_level >= 4) {
+        leaf = 4;
+    } else if (ebx == 0x68747541 || ebx == 0x6f677948) {
+        // cache topology extension
+        if (__get_cpuid_max(0x80000000, nullptr) >= 0x8000001d) {
+            __cpuid(0x80000001, eax, ebx, ecx, edx);
+            if (ecx & (1 << 22)) {
+                leaf = 0x8000001d;
+            }
+        }
+    }
+    if (!leaf) {
+        return -1;
+    }
+
+    for (unsigned sub = 0; sub < 16; ++sub) {
+        __cpuid_count(leaf, sub, eax, ebx, ecx, edx);
+        unsigned type = eax & 0x1f;
+        if (type == 0) {
+            break;
+        }
+        cpu_cache_info c;
+        c.level = (eax >> 5) & 0x7;
+        c.type = type == 1 ? 'D' : (type == 2 ? 'I' : 'U');
+        c.shared_cpus = ((eax >> 14) & 0xfff) + 1;
+        c.line_size = (ebx & 0xfff) + 1;
+        unsigned partitions = ((ebx >> 12) & 0x3ff) + 1;
+        c.ways = ((ebx >> 22) & 0x3ff) + 1;
+        size_t sets = (size_t)ecx + 1;
+        c.size = (size_t)c.ways * partitions * c.line_size * sets;
+        caches.push_back(c);
+    }
+    return caches.empty() ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+int cpu_topology::probe_sysfs_cache(const std::string& sysfs_root) {
+    for (unsigned i = 0; i < 16; ++i) {
+        std::string dir = sysfs_root + "/cpu/cpu0/cache/index" + std::to_string(i);
+        std::string line;
+        cpu_cache_info c;
+        if (!read_uint(dir + "/level", c.level)) {
+            break;
+        }
+        if (read_line(dir + "/type", line)) {
+            c.type = line == "Data" ? 'D' : (line == "Instruction" ? 'I' : 'U');
+        }
+        if (read_line(dir + "/size", line)) {
+            c.size = parse_size(line);
+        }
+        read_uint(dir + "/coherency_line_size", c.line_size);
+        read_uint(dir + "/ways_of_associativity", c.ways);
+        if (read_line(dir + "/shared_cpu_list", line)) {
+            c.shared_cpus = std::max<size_t>(1, parse_cpulist(line).size());
+        }
+        caches.push_back(c);
+    }
+    return caches.empty() ? -1 : 0;
+}
+
+void cpu_topology::probe_sysfs_topology(const std::string& sysfs_root) {
+    std::string line;
+    std::vector<unsigned> online;
+    if (read_line(sysfs_root + "/cpu/online", line)) {
+        online = parse_cpulist(line);
+    }
+    if (online.empty()) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < std::max(1L, n); ++i) {
+            online.push_back(i);
+        }
+    }
+
+    unsigned max_cpu = *std::max_element(online.begin(), online.end());
+    cpu_core.assign(max_cpu + 1, -1);
+    cpu_socket.assign(max_cpu + 1, -1);
+    cpu_node.assign(max_cpu + 1, -1);
+
+    std::map<std::pair<unsigned, unsigned>, int> cores;
+    std::set<unsigned> sockets;
+    for (unsigned cpu : online) {
+        std::string dir = sysfs_root + "/cpu/cpu" + std::to_string(cpu) + "/topology";
+        unsigned socket = 0;
+        unsigned core = cpu;
+        read_uint(dir + "/physical_package_id", socket);
+        read_uint(dir + "/core_id", core);
+        auto r = cores.emplace(std::make_pair(socket, core), (int)cores.size());
+        cpu_core[cpu] = r.first->second;
+        cpu_socket[cpu] = socket;
+        sockets.insert(socket);
+    }
+
+    num_cpus = online.size();
+    num_cores = cores.size();
+    num_sockets = sockets.size();
+    threads_per_core = (num_cpus + num_cores - 1) / num_cores;
+
+    num_nodes = 0;
+    DIR *d = opendir((sysfs_root + "/node").c_str());
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != nullptr) {
+            unsigned node;
+            char c;
+            if (sscanf(de->d_name, "node%u%c", &node, &c) != 1) {
+                continue;
+            }
+            std::string path = sysfs_root + "/node/" + de->d_name + "/cpulist";
+            if (!read_line(path, line)) {
+                continue;
+            }
+            auto cpus = parse_cpulist(line);
+            if (cpus.empty()) {
+                continue;   // memory only node
+            }
+            for (unsigned cpu : cpus) {
+                if (cpu <= max_cpu) {
+                    cpu_node[cpu] = node;
+                }
+            }
+            num_nodes++;
+        }
+        closedir(d);
+    }
+    if (num_nodes == 0) {
+        num_nodes = 1;
+        for (unsigned cpu : online) {
+            cpu_node[cpu] = 0;
+        }
+    }
+}
+
+int cpu_topology::node_of_cpu(unsigned cpu) const {
+    return cpu < cpu_node.size() ? cpu_node[cpu] : -1;
+}
+
+size_t cpu_topology::buffer_append_unit() const {
+    return std::clamp<size_t>(pow2_floor(l1d_size / 8), 4096, 16384);
+}
+
+unsigned cpu_topology::mempool_shards() const {
+    unsigned n = 1;
+    while (n < num_cpus) {
+        n *= 2;
+    }
+    return n;
+}
+
+size_t cpu_topology::nt_store_threshold() const {
+    unsigned level = l3_size ? 3 : 2;
+    size_t size = l3_size ? l3_size : l2_size;
+    unsigned shared = 1;
+    for (const auto& c : caches) {
+        if (c.level == level && c.type != 'I') {
+            // cpuid reports the addressable ids, not the present cores
+            shared = std::clamp(c.shared_cpus / threads_per_core, 1u, num_cores);
+        }
+    }
+    return size / shared * 3 / 4;
+}
+
+} //namespace: spec
@@ -0,0 +1,180 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/dispatch.h"
+#include "arch/intel.h"
+#include "arch/probe_arch.h"
+
+static const char *const arch_level_names[ARCH_LEVEL_MAX] = {
+    "scalar", "sse42", "avx2", "avx512",
+};
+
+static struct arch_kernel *arch_kernels;
+static int arch_cur_level = -1;
+
+int arch_level_detected(void) {
+    probe_arch();
+
+#if defined(__x86_64__)
+    if (!arch_intel_sse42) {
+        return ARCH_LEVEL_SCALAR;
+    }
+    if (!arch_intel_avx || !arch_intel_avx2) {
+        return ARCH_LEVEL_SSE42;
+    }
+    if (!arch_intel_avx512f || !arch_intel_avx512vl ||
+        !arch_intel_avx512bw || !arch_intel_avx512dq) {
+        return ARCH_LEVEL_AVX2;
+    }
+    return ARCH_LEVEL_AVX512;
+#else
+    return ARCH_LEVEL_SCALAR;
+#endif
+}
+
+int arch_has_pclmul(void) {
+    probe_arch();
+#if defined(__x86_64__)
+    return arch_intel_pclmul;
+#else
+    return 0;
+#endif
+}
+
+int arch_has_ssse3(void) {
+    probe_arch();
+#if defined(__x86_64__)
+    return arch_intel_ssse3;
+#else
+    return 0;
+#endif
+}
+
+int arch_has_sse41(void) {
+    probe_arch();
+#if defined(__x86_64__)
+    return arch_intel_sse41;
+#else
+    return 0;
+#endif
+}
+
+static int arch_level_from_env(void) {
+    int level = arch_level_detected();
+    const char *env = getenv("SPEC_ARCH_LEVEL");
+    if (env) {
+        int cap = arch_level_from_name(env);
+        if (cap >= 0 && cap < level) {
+            level = cap;
+        }
+    }
+    return level;
+}
+
+int arch_level(void) {
+    if (arch_cur_level < 0) {
+        arch_cur_level = arch_level_from_env();
+    }
+    return arch_cur_level;
+}
+
+const char *arch_level_name(int level) {
+    if (level < 0 || level >= ARCH_LEVEL_MAX) {
+        return "unknown";
+    }
+    return arch_level_names[level];
+}
+
+int arch_level_from_name(const char *name) {
+    int i;
+    for (i = 0; i < ARCH_LEVEL_MAX; ++i) {
+        if (!strcmp(arch_level_names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int arch_variant_usable(const struct arch_kernel_variant *v, int level) {
+    return v->level <= level && (!v->available || v->available());
+}
+
+static void arch_kernel_select(struct arch_kernel *k) {
+    int level = arch_level();
+    unsigned i;
+
+    k->chosen = &k->variants[0];
+    for (i = 1; i < k->num_variants; ++i) {
+        if (arch_variant_usable(&k->variants[i], level)) {
+            k->chosen = &k->variants[i];
+        }
+    }
+    // the slot may have any function pointer type
+    memcpy(k->slot, &k->chosen->fn, sizeof(arch_fn_t));
+}
+
+arch_fn_t arch_kernel_register(struct arch_kernel *k) {
+    struct arch_kernel *p;
+    for (p = arch_kernels; p && p != k; p = p->next) {
+    }
+    if (!p) {
+        k->next = arch_kernels;
+        arch_kernels = k;
+    }
+    arch_kernel_select(k);
+    return k->chosen->fn;
+}
+
+const struct arch_kernel *arch_kernel_find(const char *name) {
+    struct arch_kernel *p;
+    for (p = arch_kernels; p; p = p->next) {
+        if (!strcmp(p->name, name)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+int arch_kernel_self_test(void (*report)(const char *kernel,
+                                         const char *variant,
+                                         int ok)) {
+    // every variant the cpu can run, not only the chosen ones
+    int level = arch_level_detected();
+    int failed = 0;
+    struct arch_kernel *p;
+    unsigned i;
+
+    for (p = arch_kernels; p; p = p->next) {
+        if (!p->self_test) {
+            continue;
+        }
+        for (i = 1; i < p->num_variants; ++i) {
+            const struct arch_kernel_variant *v = &p->variants[i];
+            if (!arch_variant_usable(v, level)) {
+                continue;
+            }
+            int ok = p->self_test(p->variants[0].fn, v->fn) == 0;
+            if (!ok) {
+                failed++;
+            }
+            if (report) {
+                report(p->name, v->name, ok);
+            }
+        }
+    }
+    return failed;
+}
+
+void arch_kernel_reselect(void) {
+    struct arch_kernel *p;
+
+    arch_cur_level = arch_level_from_env();
+    for (p = arch_kernels; p; p = p->next) {
+        arch_kernel_select(p);
+    }
+}
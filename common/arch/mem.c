@@ -0,0 +1,132 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "arch/dispatch.h"
+#include "arch/mem.h"
+
+static int mem_is_zero_scalar(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+
+    // 64 bytes per check, the 8 loads are independent
+    while (len >= 64) {
+        uint64_t v[8];
+        memcpy(v, p, sizeof(v));
+        if (v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7]) {
+            return 0;
+        }
+        p += 64;
+        len -= 64;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        if (v) {
+            return 0;
+        }
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        if (*p++) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#ifdef __x86_64__
+
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static int mem_is_zero_sse42(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+
+    while (len >= 64) {
+        __m128i v = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)p),
+                         _mm_loadu_si128((const __m128i *)(p + 16))),
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)(p + 32)),
+                         _mm_loadu_si128((const __m128i *)(p + 48))));
+        if (!_mm_testz_si128(v, v)) {
+            return 0;
+        }
+        p += 64;
+        len -= 64;
+    }
+    return mem_is_zero_scalar(p, len);
+}
+
+__attribute__((target("avx2")))
+static int mem_is_zero_avx2(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+
+    while (len >= 128) {
+        __m256i v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i *)p),
+                            _mm256_loadu_si256((const __m256i *)(p + 32))),
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(p + 64)),
+                            _mm256_loadu_si256((const __m256i *)(p + 96))));
+        if (!_mm256_testz_si256(v, v)) {
+            return 0;
+        }
+        p += 128;
+        len -= 128;
+    }
+    return mem_is_zero_sse42(p, len);
+}
+
+#endif
+
+static int mem_is_zero_self_test(arch_fn_t ref, arch_fn_t fn) {
+    arch_mem_is_zero_func_t f0 = (arch_mem_is_zero_func_t)ref;
+    arch_mem_is_zero_func_t f1 = (arch_mem_is_zero_func_t)fn;
+    unsigned char buf[1024 + 64];
+    size_t off, len, pos;
+
+    memset(buf, 0, sizeof(buf));
+    for (off = 0; off < 64; off += 7) {
+        for (len = 0; len <= 1024; len += (len < 200 ? 1 : 61)) {
+            if (f0(buf + off, len) != f1(buf + off, len)) {
+                return -1;
+            }
+            // one non-zero byte at the head, middle and tail
+            for (pos = 0; len && pos < len; pos += (len + 2) / 3) {
+                buf[off + pos] = 0x10;
+                int r0 = f0(buf + off, len);
+                int r1 = f1(buf + off, len);
+                buf[off + pos] = 0;
+                if (r0 != r1) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static const struct arch_kernel_variant mem_is_zero_variants[] = {
+    {ARCH_LEVEL_SCALAR, "scalar", (arch_fn_t)mem_is_zero_scalar, NULL},
+#ifdef __x86_64__
+    {ARCH_LEVEL_SSE42, "sse42", (arch_fn_t)mem_is_zero_sse42, arch_has_sse41},
+    {ARCH_LEVEL_AVX2, "avx2", (arch_fn_t)mem_is_zero_avx2, NULL},
+#endif
+};
+
+static struct arch_kernel mem_is_zero_kernel = {
+    "mem_is_zero", (arch_fn_t *)&arch_mem_is_zero_func, mem_is_zero_variants,
+    ARCH_ARRAY_SIZE(mem_is_zero_variants), mem_is_zero_self_test, NULL, NULL,
+};
+
+// usable before the constructor runs
+arch_mem_is_zero_func_t arch_mem_is_zero_func = mem_is_zero_scalar;
+
+__attribute__((constructor))
+static void mem_kernels_init(void) {
+    arch_kernel_register(&mem_is_zero_kernel);
+}
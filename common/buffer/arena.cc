@@ -0,0 +1,166 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <sys/mman.h>
+
+#include <mutex>
+#include <new>
+
+#include "intarith.h"
+#include "mempool/arena.h"
+#include "spinlock/spinlock.h"
+
+namespace mempool {
+
+thread_local arena *current_arena = nullptr;
+
+spec::atomic<char*> arena_region_begin{nullptr};
+
+namespace {
+
+struct page_pool {
+    spec::spinlock lock;
+    void *free_head = nullptr;  // free pages linked by their first word
+    char *unused = nullptr;     // never used part of the region
+    size_t pages_in_use = 0;
+    uint64_t escaped_scopes = 0;
+};
+
+page_pool pool;
+
+void reserve_region() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        /* Only reserve the address space, physical memory is taken
+         * when the page is touched at the first time.
+         */
+        void *p = ::mmap(nullptr, arena_region_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            return;
+        }
+        pool.unused = (char*)p;
+        arena_region_begin.store((char*)p, std::memory_order_release);
+    });
+}
+
+void* get_page() {
+    reserve_region();
+
+    std::lock_guard lg(pool.lock);
+    void *p = pool.free_head;
+    if (p) {
+        pool.free_head = *(void**)p;
+    } else if (pool.unused &&
+               pool.unused < arena_region_begin.load(std::memory_order_relaxed) +
+                             arena_region_size) {
+        p = pool.unused;
+        pool.unused += arena_page_size;
+    } else {
+        return nullptr;
+    }
+    pool.pages_in_use++;
+    return p;
+}
+
+// return the page chain [first, last] which has n pages in O(1)
+void put_pages(void *first, void *last, size_t n) {
+    std::lock_guard lg(pool.lock);
+    *(void**)last = pool.free_head;
+    pool.free_head = first;
+    pool.pages_in_use -= n;
+}
+
+} //namespace: anonymous
+
+arena* arena::create() {
+    char *p = (char*)get_page();
+    if (!p) {
+        return nullptr;
+    }
+
+    // the arena object lives at the head of its first page
+    page *first = (page*)p;
+    char *pos = p + round_up_to(sizeof(page) + sizeof(arena), alignof(std::max_align_t));
+    arena *a = new (p + sizeof(page)) arena(first, pos, p + arena_page_size);
+    first->next = nullptr;
+    first->owner = a;
+    return a;
+}
+
+bool arena::refill() {
+    page *pg = (page*)get_page();
+    if (!pg) {
+        return false;
+    }
+    pg->next = nullptr;
+    pg->owner = this;
+    tail->next = pg;
+    tail = pg;
+    pos = (char*)pg + round_up_to(sizeof(page), alignof(std::max_align_t));
+    end = (char*)pg + arena_page_size;
+    return true;
+}
+
+void* arena::allocate(size_t bytes, size_t align) {
+    if (unlikely(bytes + align + sizeof(page) > arena_page_size)) {
+        return nullptr;
+    }
+
+    char *p = (char*)(((uintptr_t)pos + align - 1) & ~(uintptr_t)(align - 1));
+    if (unlikely(p + bytes > end)) {
+        if (!refill()) {
+            return nullptr;
+        }
+        p = (char*)(((uintptr_t)pos + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    pos = p + bytes;
+    nref.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+void arena::end_scope() {
+    if (nref.load(std::memory_order_acquire) != 1) {
+        std::lock_guard lg(pool.lock);
+        pool.escaped_scopes++;
+    }
+    put();
+}
+
+void arena::put() {
+    if (nref.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    size_t n = 0;
+    for (page *pg = head; pg; pg = pg->next) {
+        ++n;
+    }
+    page *first = head;
+    page *last = tail;
+    this->~arena();
+    put_pages(first, last, n);
+}
+
+arena* arena::owner_of(const void *p) {
+    /* Pages of one arena aren't contiguous in the region, the owner is
+     * kept in the header of every page.
+     */
+    const char *region = arena_region_begin.load(std::memory_order_acquire);
+    size_t idx = ((const char*)p - region) / arena_page_size;
+    return ((const page*)(region + idx * arena_page_size))->owner;
+}
+
+size_t get_arena_pages_in_use() {
+    std::lock_guard lg(pool.lock);
+    return pool.pages_in_use;
+}
+
+uint64_t get_arena_escaped_scopes() {
+    std::lock_guard lg(pool.lock);
+    return pool.escaped_scopes;
+}
+
+} //namespace: mempool
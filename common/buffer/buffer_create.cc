@@ -3,6 +3,9 @@
  * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
  */
 
+#include <algorithm>
+
+#include "arch/cpu_topology.h"
 #include "mempool/mempool.h"
 #include "buffer/buffer_create.h"
 #include "buffer/buffer_raw_posix_aligned.h"
@@ -107,4 +110,10 @@ claim_buffer(uint64_t len, char *buf, deleter del) {
             new raw_claim_buffer(buf, len, std::move(del)));
 }
 
+uint64_t get_append_alloc_unit() {
+    static const uint64_t unit = std::max<uint64_t>(
+        SPEC_BUFFER_ALLOC_UNIT, cpu_topology::get().buffer_append_unit());
+    return unit;
+}
+
 } //namespace spec::buffer
@@ -0,0 +1,105 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <limits.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "buffer/buffer_hash.h"
+#include "crc32/checksum.h"
+#include "crc32/crc32c.h"
+#include "crc32/crc64.h"
+
+namespace spec::buffer {
+
+// crc32c_zeros takes 32-bit length
+static uint32_t crc32c_shift(uint32_t crc, uint64_t len) {
+    while (len) {
+        uint64_t n = std::min<uint64_t>(len, 1U << 31);
+        crc = crc32c_zeros(crc, n);
+        len -= n;
+    }
+    return crc;
+}
+
+void hash::update(const buffer_list& blist) {
+    if (_width != width::bits64) {
+        _crc = blist.crc32c(_crc);
+    }
+    if (_width != width::bits32) {
+        _crc64 = blist.checksum(SPEC_CSUM_CRC64, _crc64);
+    }
+    _len += blist.length();
+}
+
+void hash::update(const char *data, uint64_t len) {
+    auto p = (const unsigned char*)data;
+    if (_width != width::bits64) {
+        for (uint64_t off = 0; off < len; ) {
+            uint64_t n = std::min<uint64_t>(len - off, 1U << 31);
+            _crc = spec_crc32c(_crc, p + off, n);
+            off += n;
+        }
+    }
+    if (_width != width::bits32) {
+        _crc64 = spec_crc64(_crc64, p, len);
+    }
+    _len += len;
+}
+
+void hash::update(const buffer_list *const *blists, size_t n) {
+    if (_width == width::bits64) {
+        for (size_t i = 0; i < n; ++i) {
+            update(*blists[i]);
+        }
+        return;
+    }
+
+    std::vector<const unsigned char*> bufs;
+    std::vector<unsigned> lens;
+    for (size_t i = 0; i < n; ++i) {
+        for (const auto& node : blists[i]->buffers()) {
+            if (node.length()) {
+                spec_assert(node.length() <= UINT_MAX);
+                bufs.push_back((const unsigned char*)node.c_str());
+                lens.push_back(node.length());
+            }
+        }
+    }
+
+    // every segment from 0, then crc(a + b) = crc_zeros(crc(a), len(b)) ^ crc(b)
+    std::vector<uint32_t> crcs(bufs.size(), 0);
+    crc32c_multi(bufs.data(), lens.data(), crcs.data(), bufs.size());
+    for (size_t i = 0; i < crcs.size(); ++i) {
+        _crc = crc32c_zeros(_crc, lens[i]) ^ crcs[i];
+    }
+
+    if (_width == width::bits128) {
+        for (size_t i = 0; i < n; ++i) {
+            _crc64 = blists[i]->checksum(SPEC_CSUM_CRC64, _crc64);
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        _len += blists[i]->length();
+    }
+}
+
+void hash::combine(const hash& other) {
+    spec_assert(_width == other._width);
+
+    // other = crc_zeros(init, len) ^ (crc of its bytes from 0)
+    if (_width != width::bits64) {
+        uint32_t crc = other._crc ^ crc32c_shift(other._init, other._len);
+        _crc = crc32c_shift(_crc, other._len) ^ crc;
+    }
+    if (_width != width::bits32) {
+        uint64_t crc = other._crc64 ^ crc64_zeros(other._init64, other._len);
+        _crc64 = crc64_zeros(_crc64, other._len) ^ crc;
+    }
+    _len += other._len;
+}
+
+} //namespace spec::buffer
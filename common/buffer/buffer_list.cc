@@ -8,21 +8,31 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
+#include <linux/falloc.h>
 
 #include <iomanip>
 #include <algorithm>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arch/mem.h"
 #include "compiler/likely.h"
 #include "buffer/buffer_list.h"
 #include "buffer/buffer_raw_combined.h"
 #include "buffer/buffer_create.h"
+#include "crc32/checksum.h"
 #include "crc32/crc32c.h"
+#include "crc32/xxhash64.h"
 #include "compact_map.h"
 #include "mempool/mempool.h"
 #include "intarith.h"
 #include "compat.h"
 #include "safe_io.h"
 #include "encode/armor.h"
+#include "trace/trace.h"
 
 
 using namespace spec;
@@ -337,10 +347,11 @@ ptr_node& list::refill_append_space(const uint64_t len) {
      */
     auto need = round_up_to(len, sizeof(uint64_t)) +
                 sizeof(raw_combined);
-    auto alen = round_up_to(need, SPEC_BUFFER_ALLOC_UNIT) -
+    auto alen = round_up_to(need, get_append_alloc_unit()) -
                 sizeof(raw_combined);
     auto new_back = ptr_node::create(
             raw_combined::create(alen, 0, get_mempool_type()));
+    SPEC_TRACE("buffer.list.alloc", "list {} append space {} for {}", this, alen, len);
     new_back->set_length(0);
     _tail_pnode_cache = new_back.get();
     _buffers.push_back(*new_back.release());
@@ -505,9 +516,101 @@ bool list::is_zero() const {
     return true;
 }
 
+// the shared zero area of the sparse lists, never released
+static const ptr& zero_area() {
+    static const ptr *zp = [] {
+        void *p = ::mmap(nullptr, SPEC_BUFFER_ZERO_AREA_SIZE, PROT_READ,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        spec_assert(p != MAP_FAILED);
+        return new ptr(create_static(SPEC_BUFFER_ZERO_AREA_SIZE, (char*)p));
+    }();
+    return *zp;
+}
+
+static bool is_zero_area(const ptr& bptr) {
+    return bptr.raw_c_str() == zero_area().raw_c_str();
+}
+
+std::vector<uint64_t> list::scan_zero_blocks(uint64_t block_size) const {
+    spec_assert(block_size);
+    std::vector<uint64_t> bitmap(((_len + block_size - 1) / block_size + 63) / 64);
+
+    uint64_t block = 0;
+    uint64_t block_off = 0;
+    bool zero = true;
+    for (const auto& node : _buffers) {
+        const char *p = node.c_str();
+        uint64_t left = node.length();
+        bool known = is_zero_area(node);
+        while (left) {
+            uint64_t n = std::min(left, block_size - block_off);
+            if (zero && !known) {
+                zero = arch_mem_is_zero(p, n);
+            }
+            p += n;
+            left -= n;
+            block_off += n;
+            if (block_off == block_size) {
+                bitmap[block / 64] |= (uint64_t)zero << (block % 64);
+                ++block;
+                block_off = 0;
+                zero = true;
+            }
+        }
+    }
+    if (block_off) {
+        bitmap[block / 64] |= (uint64_t)zero << (block % 64);
+    }
+    return bitmap;
+}
+
+void list::sparsify(uint64_t block_size) {
+    auto bitmap = scan_zero_blocks(block_size);
+    uint64_t nblocks = (_len + block_size - 1) / block_size;
+    auto is_zero_block = [&](uint64_t b) {
+        return (bitmap[b / 64] >> (b % 64)) & 1;
+    };
+
+    buffer_list sparse;
+    auto node = _buffers.begin();
+    uint64_t node_off = 0;
+    for (uint64_t b = 0; b < nblocks; ) {
+        // a run of the zero or data blocks
+        bool zero = is_zero_block(b);
+        uint64_t end = b + 1;
+        while (end < nblocks && is_zero_block(end) == zero) {
+            ++end;
+        }
+        uint64_t len = std::min(end * block_size, _len) - b * block_size;
+        b = end;
+
+        for (uint64_t left = len; left; ) {
+            if (node_off == node->length()) {
+                ++node;
+                node_off = 0;
+                continue;
+            }
+            uint64_t n = std::min(left, node->length() - node_off);
+            if (!zero) {
+                sparse.push_back(ptr(*node, node_off, n));
+            }
+            node_off += n;
+            left -= n;
+        }
+        while (zero && len) {
+            uint64_t n = std::min<uint64_t>(len, SPEC_BUFFER_ZERO_AREA_SIZE);
+            sparse.push_back(ptr(zero_area(), 0, n));
+            len -= n;
+        }
+    }
+    swap(sparse);
+}
+
 void list::zero() {
     for (auto&node : _buffers) {
-        node.zero();
+        if (!is_zero_area(node)) {
+            node.zero();
+        }
     }
 }
 void list::zero(uint64_t off, uint64_t len) {
@@ -520,7 +623,8 @@ void list::zero(uint64_t off, uint64_t len) {
             //                 'pos'-- node.length() --|
             break;
         }
-        if (node.length() == 0 || pos + node.length() <= off) {
+        if (node.length() == 0 || pos + node.length() <= off ||
+            is_zero_area(node)) {
             //                          'pos'-- len --|
             // 'pos'-- node.length() --|
             pos += node.length();
@@ -569,6 +673,7 @@ void list::rebuild() {
     }
 }
 void list::rebuild(std::unique_ptr<ptr_node, ptr_node::disposer> nb) {
+    SPEC_TRACE("buffer.list.rebuild", "list {} len {} from {} buffers", this, _len, _num);
     uint64_t pos = 0;
     for (auto& node : _buffers) {
         nb->copy_in(pos, node.length(), node.c_str(), false);
@@ -636,6 +741,10 @@ bool list::rebuild_aligned_size_and_memory(uint64_t align_size,
 
         if (!(unaligned_list.is_contiguous() &&
               unaligned_list._buffers.front().is_aligned(align_memory))) {
+            SPEC_TRACE("buffer.list.rebuild_aligned",
+                       "list {} {} bytes of {} buffers to align {} size {}",
+                       this, unaligned_list._len, unaligned_list._num,
+                       align_memory, align_size);
             unaligned_list.rebuild(
                     ptr_node::create(
                         buffer::create_aligned(unaligned_list._len,
@@ -654,10 +763,30 @@ bool list::rebuild_page_aligned() {
     return rebuild_aligned(SPEC_PAGE_SIZE);
 }
 
+bool list::unshare_arena() {
+    bool in_arena = false;
+    for (const auto& node : _buffers) {
+        if (mempool::arena::contains(&node) ||
+            mempool::arena::contains(node.m_raw) ||
+            mempool::arena::contains(node.raw_c_str())) {
+            in_arena = true;
+            break;
+        }
+    }
+    if (!in_arena) {
+        return false;
+    }
+
+    mempool::arena_bypass bypass;
+    rebuild();
+    return true;
+}
+
 void list::reserve(uint64_t pre_alloc_size) {
     if (get_append_buffer_unused_tail_length() < pre_alloc_size) {
         auto bptr =
             ptr_node::create(buffer::create_page_aligned(pre_alloc_size));
+        SPEC_TRACE("buffer.list.alloc", "list {} reserve {}", this, pre_alloc_size);
 
         bptr->set_length(0);
         _tail_pnode_cache = bptr.get();
@@ -695,8 +824,8 @@ void list::append(char c) {
     auto gap = get_append_buffer_unused_tail_length();
     if (!gap) {
         auto bptr = ptr_node::create(
-                raw_combined::create(SPEC_BUFFER_APPEND_SIZE, 0,
-                                     get_mempool_type()));
+                raw_combined::create(get_append_alloc_unit() - sizeof(raw_combined),
+                                     0, get_mempool_type()));
         bptr->set_length(0);
         _tail_pnode_cache = bptr.get();
         _buffers.push_back(*bptr.release());
@@ -848,6 +977,7 @@ list::reserve_t list::obtain_contiguous_space(const uint64_t len) {
     if (unlikely(get_append_buffer_unused_tail_length() < len)) {
         auto new_back =
             buffer::ptr_node::create(buffer::create(len)).release();
+        SPEC_TRACE("buffer.list.alloc", "list {} contiguous space {}", this, len);
         new_back->set_length(0);
         _buffers.push_back(*new_back);
         _num += 1;
@@ -1016,28 +1146,110 @@ void list::write(uint64_t off, uint64_t len, std::ostream& out) const {
     }
 }
 
+// Both walk the segments without flattening: a 3-byte group(or 4-char
+// quad) spanning two segments is carried over, the rest is coded chunk by
+// chunk on the stack and written out through a page_aligned_appender
+// sized for the whole output.
 void list::encode_base64(buffer_list& waiting_encode_list) {
-    buffer_ptr bptr(length() * 4 /3 + 3);
-    uint64_t len = spec_armor(bptr.c_str(), bptr.c_str() + bptr.length(),
-                              c_str(), c_str() + length());
-    bptr.set_length(len);
-    waiting_encode_list.push_back(std::move(bptr));
+    const uint64_t chunk = 3 * 1024;
+    uint64_t out_len = (length() + 2) / 3 * 4;
+    auto appender = waiting_encode_list.get_page_aligned_appender(
+        (out_len + SPEC_PAGE_SIZE - 1) / SPEC_PAGE_SIZE);
+    char out[chunk / 3 * 4];
+    char carry[3];
+    uint64_t ncarry = 0;
+
+    for (const auto& node : _buffers) {
+        const char *p = node.c_str();
+        const char *end = p + node.length();
+        if (ncarry) {
+            while (ncarry < 3 && p < end) {
+                carry[ncarry++] = *p++;
+            }
+            if (ncarry < 3) {
+                continue;
+            }
+            appender.append(out, spec_armor(out, out + 4, carry, carry + 3));
+            ncarry = 0;
+        }
+        while (end - p >= 3) {
+            uint64_t n = std::min<uint64_t>((end - p) / 3 * 3, chunk);
+            appender.append(out, spec_armor(out, out + sizeof(out), p, p + n));
+            p += n;
+        }
+        while (p < end) {
+            carry[ncarry++] = *p++;
+        }
+    }
+    if (ncarry) {
+        appender.append(out, spec_armor(out, out + 4, carry, carry + ncarry));
+    }
 }
 
 void list::decode_base64(buffer_list& encoded_list) {
-    buffer_ptr bptr(4 + ((encoded_list.length() * 3) / 4));
-    int64_t len = spec_unarmor(bptr.c_str(), bptr.c_str() + bptr.length(),
-                                encoded_list.c_str(),
-                                encoded_list.c_str() + encoded_list.length());
-    if (len < 0) {
+    const uint64_t chunk = 4 * 1024;
+    // nothing is appended if the decoding fails
+    buffer_list decoded;
+    int64_t r = 0;
+    bool done = false;
+    {
+        uint64_t max_len = encoded_list.length() / 4 * 3 + 3;
+        auto appender = decoded.get_page_aligned_appender(
+            (max_len + SPEC_PAGE_SIZE - 1) / SPEC_PAGE_SIZE);
+        char out[chunk / 4 * 3];
+        char carry[4];
+        uint64_t ncarry = 0;
+
+        // the whole quads of src, done after the padding
+        auto decode = [&](const char *src, uint64_t n) {
+            int64_t len = spec_unarmor(out, out + sizeof(out), src, src + n);
+            if (len >= 0) {
+                appender.append(out, len);
+                done = (uint64_t)len < n / 4 * 3;
+            }
+            return len;
+        };
+
+        for (const auto& node : encoded_list._buffers) {
+            const char *p = node.c_str();
+            const char *end = p + node.length();
+            const char *run_end = p;    // the chars before the next '\n'
+            while (p < end && r >= 0 && !done) {
+                if (ncarry || (p < run_end && run_end - p < 4)) {
+                    // '\n' inside a quad is invalid as spec_unarmor does
+                    carry[ncarry++] = *p++;
+                    if (ncarry == 4) {
+                        r = decode(carry, 4);
+                        ncarry = 0;
+                    }
+                    continue;
+                }
+                if (*p == '\n') {
+                    ++p;
+                    continue;
+                }
+                if (p >= run_end) {
+                    auto nl = (const char*)memchr(p, '\n', end - p);
+                    run_end = nl ? nl : end;
+                    continue;
+                }
+                uint64_t n = std::min<uint64_t>((run_end - p) / 4 * 4, chunk);
+                r = decode(p, n);
+                p += n;
+            }
+        }
+        if (r >= 0 && !done && ncarry) {
+            r = -EINVAL;
+        }
+    }
+
+    if (r < 0) {
         std::ostringstream oss;
         oss << "decode_base64: decoding failed:\n";
         hexdump(oss);
         throw malformed_input(oss.str().c_str());
     }
-    spec_assert(len <= (int64_t)bptr.length());
-    bptr.set_length(len);
-    push_back(std::move(bptr));
+    claim_append(decoded);
 }
 
 void list::write_stream(std::ostream &out) const {
@@ -1047,42 +1259,138 @@ void list::write_stream(std::ostream &out) const {
         }
     }
 }
+static const char hex_digits[] = "0123456789abcdef";
+
+// "%08lx", return the end of the output
+static char* hexdump_offset(char *p, uint64_t off) {
+    int width = 8;
+    while (width < 16 && (off >> (4 * width))) {
+        width++;
+    }
+    for (int i = width - 1; i >= 0; --i) {
+        p[i] = hex_digits[off & 15];
+        off >>= 4;
+    }
+    return p + width;
+}
+
+// " xx xx xx xx xx xx xx xx  xx xx xx xx xx xx xx xx  |................|"
+static char* hexdump_row(char *p, const unsigned char *row, uint64_t n) {
+    char hex[32];
+    char text[16];
+    uint64_t i;
+
+#ifdef __SSE2__
+    if (n == 16) {
+        // nibble to '0'..'9' or 'a'..'f', the printable chars are 0x20..0x7e
+        __m128i v = _mm_loadu_si128((const __m128i*)row);
+        __m128i mask = _mm_set1_epi8(0x0f);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        __m128i nine = _mm_set1_epi8(9);
+        __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, _mm_set1_epi8('0')),
+                          _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, _mm_set1_epi8('0')),
+                          _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+        _mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+        _mm_storeu_si128((__m128i*)text,
+                         _mm_or_si128(_mm_and_si128(printable, v),
+                                      _mm_andnot_si128(printable, _mm_set1_epi8('.'))));
+    } else
+#endif
+    {
+        for (i = 0; i < n; i++) {
+            hex[2 * i] = hex_digits[row[i] >> 4];
+            hex[2 * i + 1] = hex_digits[row[i] & 15];
+            text[i] = (row[i] >= 0x20 && row[i] < 0x7f) ? row[i] : '.';
+        }
+    }
+
+    for (i = 0; i < 16; i++) {
+        if (i == 8) {
+            *p++ = ' ';
+        }
+        *p++ = ' ';
+        if (i < n) {
+            *p++ = hex[2 * i];
+            *p++ = hex[2 * i + 1];
+        } else {
+            *p++ = ' ';
+            *p++ = ' ';
+        }
+    }
+    *p++ = ' ';
+    *p++ = ' ';
+    *p++ = '|';
+    memcpy(p, text, n);
+    p += n;
+    *p++ = '|';
+    return p;
+}
+
+// Formatted into a local buffer row by row and written out in large chunks,
+// the rows are gathered from the segments without operator[].
+// A row is replaced by "*" if it and the row before it are filled with the
+// same byte, the last row is always shown.
 void list::hexdump(std::ostream &out, bool trailing_newline) const {
     if (!length()) {
         return;
     }
 
-    std::ios_base::fmtflags original_flags = out.flags();
-    out.setf(std::ios::right);
-    out.fill('0');
-
-    uint64_t per = 16;
+    const uint64_t per = 16;
+    const uint64_t total = length();
+    char buf[16 * 1024];
+    char *p = buf;
+    unsigned char row_buf[per];
     char last_row_char = '\0';
     bool was_same = false, did_star = false;
-    for (uint64_t off = 0; off < length(); off += per) {
-        if (off == 0) {
-            last_row_char = (*this)[off];
-        }
-
-        if (off + per < length()) {
-            bool row_is_same = true;
-            for (uint64_t i = 0; i < per && off + i < length(); i++) {
-                char current_char = (*this)[off + i];
-                if (current_char != last_row_char) {
-                    if (i == 0) {
-                        last_row_char = current_char;
-                        was_same = false;
-                        did_star = false;
-                    } else {
-                        row_is_same = false;
-                    }
+
+    auto seg = _buffers.begin();
+    uint64_t seg_off = 0;
+    for (uint64_t off = 0; off < total; off += per) {
+        uint64_t n = std::min(per, total - off);
+        const unsigned char *row;
+        if (seg->length() - seg_off >= n) {
+            row = (const unsigned char*)seg->c_str() + seg_off;
+            seg_off += n;
+        } else {
+            for (uint64_t got = 0; got < n; ) {
+                if (seg_off == seg->length()) {
+                    ++seg;
+                    seg_off = 0;
+                    continue;
                 }
+                uint64_t len = std::min(n - got, (uint64_t)seg->length() - seg_off);
+                memcpy(row_buf + got, seg->c_str() + seg_off, len);
+                got += len;
+                seg_off += len;
             }
+            row = row_buf;
+        }
+        if (seg_off == seg->length() && off + n < total) {
+            ++seg;
+            seg_off = 0;
+        }
 
-            if (row_is_same) {
+        if (off == 0) {
+            last_row_char = row[0];
+        }
+        if (off + per < total) {
+            if ((char)row[0] != last_row_char) {
+                last_row_char = row[0];
+                was_same = false;
+                did_star = false;
+            }
+            if (!memcmp(row, row + 1, per - 1)) {
                 if (was_same) {
                     if (!did_star) {
-                        out << "\n*";
+                        *p++ = '\n';
+                        *p++ = '*';
                         did_star = true;
                     }
                     continue;
@@ -1095,43 +1403,24 @@ void list::hexdump(std::ostream &out, bool trailing_newline) const {
         }
 
         if (off) {
-            out << "\n";
+            *p++ = '\n';
         }
-        out << std::hex << std::setw(8) << off << " ";
-
-        uint64_t i = 0;
-        for (i = 0; i < per && off + i < length(); i++) {
-            if (i == 8) {
-                out << ' ';
-            }
-            out << " " << std::setw(2)
-                << ((unsigned)(*this)[off + i] & 0xff);
-        }
-        for (; i < per; i++) {
-            if (i == 8) {
-                out << ' ';
-            }
-            out << "   ";
-        }
-
-        out << "  |";
-        for (i = 0; i < per && off + i < length(); i++) {
-            char c = (*this)[off + i];
-            if (isupper(c) || islower(c) || isdigit(c) ||
-                c == ' ' || ispunct(c)) {
-                out << c;
-            } else {
-                out << '.';
-            }
+        p = hexdump_offset(p, off);
+        *p++ = ' ';
+        p = hexdump_row(p, row, n);
+        if (p > buf + sizeof(buf) - 128) {
+            out.write(buf, p - buf);
+            p = buf;
         }
-        out << '|' << std::dec;
     }
     if (trailing_newline) {
-        out << "\n" << std::hex << std::setw(8) << length();
-        out << "\n";
+        *p++ = '\n';
+        p = hexdump_offset(p, total);
+        *p++ = '\n';
     }
-    out.flags(original_flags);
+    out.write(buf, p - buf);
 }
+
 ssize_t list::pread_file(const char* fn, uint64_t off,
                    uint64_t len, std::string *error) {
     int fd = TEMP_FAILURE_RETRY(::open(fn, O_RDONLY | O_CLOEXEC));
@@ -1324,7 +1613,7 @@ static int do_writev(int fd, struct iovec *vec,
         ssize_t r = 0;
         r = ::pwritev(fd, vec, veclen, offset);
         if (r < 0) {
-            if (errno = EINTR) {
+            if (errno == EINTR) {
                 continue;
             }
             return -errno;
@@ -1351,34 +1640,84 @@ static int do_writev(int fd, struct iovec *vec,
     return 0;
 }
 
-int list::write_fd(int fd, uint64_t offset) const {
-    iovec iov[IOV_MAX];
-    auto bptr = std::cbegin(_buffers);
-
-    uint64_t left_pbrs = get_num_buffers();
-    while (left_pbrs) {
-        ssize_t bytes = 0;
-        uint64_t iovlen = 0;
-        uint64_t size = std::min<uint64_t>(left_pbrs, IOV_MAX);
-        left_pbrs -= size;
-        while (size > 0) {
-            iov[iovlen].iov_base = (void*)bptr->c_str();
-            iov[iovlen].iov_len = bptr->length();
-            iovlen++;
-            bytes += bptr->length();
-            ++bptr;
-            size--;
+// punch a hole, or write zeros if the fd doesn't support it
+static int write_zeros(int fd, uint64_t offset, uint64_t len) {
+    if (::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                    offset, len) == 0) {
+        // punching never extends the file
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            return -errno;
         }
+        if ((uint64_t)st.st_size < offset + len &&
+            ::ftruncate(fd, offset + len) < 0) {
+            return -errno;
+        }
+        return 0;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS && errno != ENODEV) {
+        return -errno;
+    }
 
-        int r = do_writev(fd, iov, offset, iovlen, bytes);
+    const ptr& zeros = zero_area();
+    while (len) {
+        uint64_t n = std::min<uint64_t>(len, zeros.length());
+        iovec iov = {(void*)zeros.c_str(), n};
+        int r = do_writev(fd, &iov, offset, 1, n);
         if (r < 0) {
             return r;
         }
-        offset += bytes;
+        offset += n;
+        len -= n;
     }
     return 0;
 }
 
+int list::write_fd(int fd, uint64_t offset) const {
+    iovec iov[IOV_MAX];
+    uint64_t iovlen = 0;
+    uint64_t bytes = 0;
+    auto flush = [&] {
+        int r = do_writev(fd, iov, offset, iovlen, bytes);
+        offset += bytes;
+        iovlen = bytes = 0;
+        return r;
+    };
+
+    auto bptr = std::cbegin(_buffers);
+    while (bptr != std::cend(_buffers)) {
+        if (is_zero_area(*bptr)) {
+            int r = flush();
+            if (r < 0) {
+                return r;
+            }
+            uint64_t len = 0;
+            for (; bptr != std::cend(_buffers) && is_zero_area(*bptr); ++bptr) {
+                len += bptr->length();
+            }
+            r = write_zeros(fd, offset, len);
+            if (r < 0) {
+                return r;
+            }
+            offset += len;
+            continue;
+        }
+
+        iov[iovlen].iov_base = (void*)bptr->c_str();
+        iov[iovlen].iov_len = bptr->length();
+        iovlen++;
+        bytes += bptr->length();
+        ++bptr;
+        if (iovlen == IOV_MAX) {
+            int r = flush();
+            if (r < 0) {
+                return r;
+            }
+        }
+    }
+    return flush();
+}
+
 uint32_t list::crc32c(uint32_t crc) const {
     int cache_misses = 0;
     int cache_hits = 0;
@@ -1405,8 +1744,8 @@ uint32_t list::crc32c(uint32_t crc) const {
                  * http://crcutil.googlecode.com/files/crc-doc.1.0.pdf
                  * note, u for our crc32c implementation is 0
                  */
-                crc = ccrc.second ^ spec_crc32c(ccrc.first ^ crc, NULL,
-                                                node.length());
+                crc = ccrc.second ^ crc32c_zeros(ccrc.first ^ crc,
+                                                 node.length());
                 cache_adjusts++;
             }
         } else {
@@ -1418,6 +1757,8 @@ uint32_t list::crc32c(uint32_t crc) const {
         }
     }
 
+    SPEC_TRACE("buffer.list.crc32c", "list {} len {} hits {} adjusts {} misses {}",
+               this, _len, cache_hits, cache_adjusts, cache_misses);
     if (buffer_track_crc) {
         if (cache_adjusts) {
             buffer_cached_crc_adjusted += cache_adjusts;
@@ -1431,6 +1772,120 @@ uint32_t list::crc32c(uint32_t crc) const {
     }
     return crc;
 }
+
+uint64_t list::checksum(int type, uint64_t seed) const {
+    if (type == SPEC_CSUM_CRC32C) {
+        return crc32c((uint32_t)seed);
+    }
+    if (type == SPEC_CSUM_XXH64) {
+        spec_xxh64_state st;
+        spec_xxh64_reset(&st, seed);
+        for (const auto& node : _buffers) {
+            spec_xxh64_update(&st, node.c_str(), node.length());
+        }
+        return spec_xxh64_digest(&st);
+    }
+
+    const spec_csum_kernel *kernel = spec_csum_get_kernel(type);
+    if (!kernel || !kernel->zeros) {
+        return 0;
+    }
+
+    // the same as crc32c(), but the cache slot is tagged with the type
+    int cache_misses = 0;
+    int cache_hits = 0;
+    int cache_adjusts = 0;
+    uint64_t csum = seed;
+    for (const auto& node : _buffers) {
+        if (node.length() == 0) {
+            continue;
+        }
+        raw *const pbraw = node.m_raw;
+        std::pair<uint64_t, uint64_t> ofs(node.offset(),
+                                          node.offset() + node.length());
+        std::pair<uint64_t, uint64_t> ccsum;
+        if (pbraw->get_csum(type, ofs, &ccsum)) {
+            if (ccsum.first == csum) {
+                csum = ccsum.second;
+                cache_hits++;
+            } else {
+                csum = ccsum.second ^ kernel->zeros(ccsum.first ^ csum,
+                                                    node.length());
+                cache_adjusts++;
+            }
+        } else {
+            cache_misses++;
+            uint64_t base = csum;
+            csum = kernel->calc(csum, (unsigned char*)node.c_str(),
+                                node.length());
+            pbraw->set_csum(type, ofs, std::make_pair(base, csum));
+        }
+    }
+
+    SPEC_TRACE("buffer.list.checksum",
+               "list {} type {} len {} hits {} adjusts {} misses {}",
+               this, type, _len, cache_hits, cache_adjusts, cache_misses);
+    if (buffer_track_crc) {
+        if (cache_adjusts) {
+            buffer_cached_crc_adjusted += cache_adjusts;
+        }
+        if (cache_hits) {
+            buffer_cached_crc += cache_hits;
+        }
+        if (cache_misses) {
+            buffer_missed_crc += cache_misses;
+        }
+    }
+    return csum;
+}
+
+void list::crc32c_per_block(uint64_t block_size, std::vector<uint32_t> *crcs,
+                            uint32_t crc) const {
+    spec_assert(block_size && block_size <= UINT_MAX);
+    crcs->assign((_len + block_size - 1) / block_size, crc);
+
+    // whole blocks in one node go to the batch, the others are chained
+    std::vector<const unsigned char*> bufs;
+    std::vector<unsigned> lens;
+    std::vector<uint64_t> index;
+    bufs.reserve(crcs->size());
+    lens.reserve(crcs->size());
+    index.reserve(crcs->size());
+
+    uint64_t block = 0;
+    uint64_t block_off = 0;
+    for (const auto& node : _buffers) {
+        auto p = (const unsigned char*)node.c_str();
+        uint64_t left = node.length();
+        while (left) {
+            if (block_off == 0 && left >= block_size) {
+                bufs.push_back(p);
+                lens.push_back(block_size);
+                index.push_back(block);
+                p += block_size;
+                left -= block_size;
+                ++block;
+                continue;
+            }
+            uint64_t len = std::min(left, block_size - block_off);
+            (*crcs)[block] = spec_crc32c((*crcs)[block], p, len);
+            p += len;
+            left -= len;
+            block_off += len;
+            if (block_off == block_size) {
+                block_off = 0;
+                ++block;
+            }
+        }
+    }
+
+    std::vector<uint32_t> batch(bufs.size(), crc);
+    crc32c_multi(bufs.data(), lens.data(), batch.data(), bufs.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        (*crcs)[index[i]] = batch[i];
+    }
+}
+
 void list::invalidate_crc() {
     for (const auto& node : _buffers) {
         if (node.m_raw) {
@@ -3,6 +3,7 @@
  * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
  */
 
+#include "arch/mem.h"
 #include "compiler/likely.h"
 #include "buffer/buffer_debug.h"
 #include "buffer/buffer_raw.h"
@@ -228,7 +229,7 @@ int ptr::cmp(const ptr& other) const {
     }
 }
 bool ptr::is_zero() const {
-    return mem_is_zero(c_str(), m_len);
+    return arch_mem_is_zero(c_str(), m_len);
 }
 
 uint64_t ptr::append(char c) {
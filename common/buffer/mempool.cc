@@ -3,8 +3,14 @@
  * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
  */
 
+#include <algorithm>
+
+#include "arch/cpu_topology.h"
 #include "mempool/mempool.h"
 
+size_t mempool::shard_mask =
+    std::min<size_t>(spec::cpu_topology::get().mempool_shards(), num_shards) - 1;
+
 //debug mempool
 bool mempool::debug_mode = false;
 
@@ -26,3 +32,47 @@ mempool::pool_type& mempool::get_pool(mempool::pool_type_id pool_index) {
     static mempool::pool_type table[num_pools];
     return table[pool_index];
 }
+
+mempool::pool_type_id mempool::pool_type::get_id() const {
+    return (mempool::pool_type_id)(this - &get_pool((mempool::pool_type_id)0));
+}
+
+thread_local mempool::pool_delta mempool::thread_pool_delta[num_pools];
+thread_local uint8_t mempool::thread_delta_state = thread_delta_unregistered;
+
+void mempool::flush_thread_pool_delta() {
+    for (int i = 0; i < num_pools; ++i) {
+        pool_delta& d = thread_pool_delta[i];
+        if (d.items || d.bytes) {
+            get_pool((pool_type_id)i).adjust_count(d.items, d.bytes);
+            d.items = 0;
+            d.bytes = 0;
+        }
+    }
+}
+
+namespace {
+
+// flush the deltas when the thread exits
+struct thread_delta_flusher {
+    ~thread_delta_flusher() {
+        mempool::flush_thread_pool_delta();
+        mempool::thread_delta_state = mempool::thread_delta_exited;
+    }
+};
+
+} //namespace: anonymous
+
+void mempool::add_thread_pool_delta_slow(pool_type_id pool_index,
+                                         ssize_t items, ssize_t bytes) {
+    if (thread_delta_state == thread_delta_unregistered) {
+        static thread_local thread_delta_flusher flusher;
+        (void)flusher;
+        thread_delta_state = thread_delta_registered;
+        add_thread_pool_delta(pool_index, items, bytes);
+        return;
+    }
+
+    // the thread is exiting, there's no more flushing
+    get_pool(pool_index).adjust_count(items, bytes);
+}
@@ -0,0 +1,308 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <execinfo.h>
+#include <math.h>
+
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "mempool/mempool_profiler.h"
+#include "spec_assert/BackTrace.h"
+
+namespace mempool::profiler {
+
+std::atomic<bool> sampling{false};
+
+namespace {
+
+constexpr int max_frames = 64;
+constexpr size_t num_live_shards = 16;
+
+using frames_t = std::vector<void*>;
+
+struct frames_hash {
+    size_t operator()(const frames_t& frames) const {
+        size_t h = frames.size();
+        for (auto f : frames) {
+            h ^= (size_t)f + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+};
+
+struct stack_stats {
+    size_t live_count{0};
+    size_t live_bytes{0};
+    size_t alloc_count{0};
+    size_t alloc_bytes{0};
+    double live_estimated{0};
+};
+
+using stack_table_t = std::unordered_map<frames_t, stack_stats, frames_hash>;
+
+struct sample {
+    stack_table_t::value_type *stack;
+    uint64_t epoch;             // stack is only valid in the same epoch
+    size_t bytes;
+    double estimated;
+};
+
+/* Frees are far more frequent than samples, so the live-sample table is
+ * sharded by address to keep record_free() from serializing all threads.
+ */
+struct live_shard {
+    std::mutex lock;
+    std::unordered_map<const void*, sample> samples;
+};
+
+struct profile_t {
+    std::mutex lock;            // protect stacks, serialize start() & stop()
+    /* Read by record_alloc() without the lock: start() stores the period
+     * before it bumps the epoch with release, so a thread seeing the new
+     * epoch sees its period too.
+     */
+    std::atomic<size_t> sample_period{0};
+    std::atomic<uint64_t> epoch{0};     // bumped on every start() & stop()
+    stack_table_t stacks;
+    live_shard live[num_live_shards];
+};
+
+// never destroyed: hooks may still run during static destruction
+profile_t& get_profile() {
+    static profile_t *profile = new profile_t;
+    return *profile;
+}
+
+live_shard& pick_live_shard(profile_t& profile, const void *addr) {
+    return profile.live[((size_t)addr >> 4) % num_live_shards];
+}
+
+struct thread_state {
+    int64_t bytes_until_sample{0};
+    uint64_t epoch{0};
+    uint64_t rnd{0};
+    bool busy{false};
+};
+
+thread_local thread_state tls;
+
+// exponentially distributed interval with mean sample_period
+int64_t next_sample_interval(thread_state& t, size_t sample_period) {
+    if (!t.rnd) {
+        t.rnd = (uint64_t)&t ^ 0x2545f4914f6cdd1dULL;
+    }
+    t.rnd ^= t.rnd << 13;
+    t.rnd ^= t.rnd >> 7;
+    t.rnd ^= t.rnd << 17;
+    double q = (double)((t.rnd >> 11) + 1) / (double)(1ULL << 53);
+    return (int64_t)(-log(q) * (double)sample_period) + 1;
+}
+
+void clear_samples(profile_t& profile) {
+    for (auto& shard : profile.live) {
+        std::lock_guard lk(shard.lock);
+        shard.samples.clear();
+    }
+    profile.stacks.clear();
+}
+
+} //namespace: anonymous
+
+void record_alloc(const void *addr, size_t bytes) {
+    thread_state& t = tls;
+    if (t.busy || !bytes) {
+        return;
+    }
+
+    profile_t& profile = get_profile();
+    uint64_t epoch = profile.epoch.load(std::memory_order_acquire);
+    size_t sample_period = profile.sample_period.load(std::memory_order_acquire);
+    if (t.epoch != epoch) {
+        t.epoch = epoch;
+        t.bytes_until_sample = next_sample_interval(t, sample_period);
+    }
+
+    t.bytes_until_sample -= bytes;
+    if (t.bytes_until_sample > 0) {
+        return;
+    }
+
+    t.busy = true;
+    t.bytes_until_sample = next_sample_interval(t, sample_period);
+
+    void *frames[max_frames];
+    int n = ::backtrace(frames, max_frames);
+
+    // skip the frame of record_alloc itself
+    frames_t key(frames + (n > 1 ? 1 : 0), frames + n);
+
+    // poisson sampling: each sample stands for bytes / P(sampled)
+    double estimated = (double)bytes /
+                       (1.0 - exp(-(double)bytes / (double)sample_period));
+
+    {
+        std::lock_guard lk(profile.lock);
+        if (!sampling.load(std::memory_order_relaxed)) {
+            t.busy = false;
+            return;
+        }
+        auto stack = &*profile.stacks.try_emplace(std::move(key)).first;
+        stack->second.live_count++;
+        stack->second.live_bytes += bytes;
+        stack->second.alloc_count++;
+        stack->second.alloc_bytes += bytes;
+        stack->second.live_estimated += estimated;
+
+        live_shard& shard = pick_live_shard(profile, addr);
+        std::lock_guard slk(shard.lock);
+        shard.samples[addr] = sample{stack, profile.epoch.load(std::memory_order_acquire),
+                                     bytes, estimated};
+    }
+    t.busy = false;
+}
+
+void record_free(const void *addr) {
+    profile_t& profile = get_profile();
+    live_shard& shard = pick_live_shard(profile, addr);
+
+    sample s;
+    {
+        std::lock_guard slk(shard.lock);
+        auto p = shard.samples.find(addr);
+        if (p == shard.samples.end()) {
+            return;
+        }
+        s = p->second;
+        shard.samples.erase(p);
+    }
+
+    std::lock_guard lk(profile.lock);
+    if (s.epoch != profile.epoch.load(std::memory_order_acquire)) {
+        // the stack table has been cleared by stop() or start()
+        return;
+    }
+    s.stack->second.live_count--;
+    s.stack->second.live_bytes -= s.bytes;
+    s.stack->second.live_estimated -= s.estimated;
+}
+
+void start(size_t sample_period) {
+    profile_t& profile = get_profile();
+    std::lock_guard lk(profile.lock);
+    clear_samples(profile);
+    profile.sample_period.store(sample_period ? sample_period : 1, std::memory_order_relaxed);
+    profile.epoch.fetch_add(1, std::memory_order_release);
+    sampling.store(true, std::memory_order_release);
+}
+
+void stop() {
+    profile_t& profile = get_profile();
+    std::lock_guard lk(profile.lock);
+    sampling.store(false, std::memory_order_release);
+    profile.epoch.fetch_add(1, std::memory_order_release);
+    clear_samples(profile);
+}
+
+size_t get_sample_period() {
+    profile_t& profile = get_profile();
+    std::lock_guard lk(profile.lock);
+    return profile.sample_period.load(std::memory_order_relaxed);
+}
+
+size_t get_live_samples() {
+    profile_t& profile = get_profile();
+    std::lock_guard lk(profile.lock);
+    size_t count = 0;
+    for (const auto& stack : profile.stacks) {
+        count += stack.second.live_count;
+    }
+    return count;
+}
+
+size_t get_live_estimated_bytes() {
+    profile_t& profile = get_profile();
+    std::lock_guard lk(profile.lock);
+    double bytes = 0;
+    for (const auto& stack : profile.stacks) {
+        bytes += stack.second.live_estimated;
+    }
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+void dump_folded(std::ostream& out) {
+    std::vector<std::pair<frames_t, size_t>> stacks;
+    {
+        profile_t& profile = get_profile();
+        std::lock_guard lk(profile.lock);
+        for (const auto& stack : profile.stacks) {
+            if (stack.second.live_count) {
+                stacks.emplace_back(stack.first,
+                                    (size_t)stack.second.live_estimated);
+            }
+        }
+    }
+
+    // symbolize out of the lock, it's slow
+    for (const auto& stack : stacks) {
+        spec::BackTrace bt(stack.first.data(), stack.first.size());
+        for (size_t i = bt.size; i-- > 0; ) {
+            std::string name = bt.function_name(i);
+            if (name.empty()) {
+                out << bt.array[i];
+            } else {
+                out << name;
+            }
+            if (i) {
+                out << ';';
+            }
+        }
+        out << ' ' << stack.second << '\n';
+    }
+}
+
+void dump_pprof(std::ostream& out) {
+    std::vector<std::pair<frames_t, stack_stats>> stacks;
+    size_t sample_period;
+    stack_stats total;
+    {
+        profile_t& profile = get_profile();
+        std::lock_guard lk(profile.lock);
+        sample_period = profile.sample_period.load(std::memory_order_relaxed);
+        for (const auto& stack : profile.stacks) {
+            stacks.emplace_back(stack.first, stack.second);
+            total.live_count += stack.second.live_count;
+            total.live_bytes += stack.second.live_bytes;
+            total.alloc_count += stack.second.alloc_count;
+            total.alloc_bytes += stack.second.alloc_bytes;
+        }
+    }
+
+    out << "heap profile: " << total.live_count << ": " << total.live_bytes
+        << " [" << total.alloc_count << ": " << total.alloc_bytes << "]"
+        << " @ heap_v2/" << sample_period << "\n";
+    for (const auto& stack : stacks) {
+        out << stack.second.live_count << ": " << stack.second.live_bytes
+            << " [" << stack.second.alloc_count << ": "
+            << stack.second.alloc_bytes << "] @";
+        for (auto frame : stack.first) {
+            out << " " << frame;
+        }
+        out << "\n";
+    }
+
+    // pprof uses the mapping to symbolize the addresses
+    out << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    if (maps.is_open()) {
+        out << maps.rdbuf();
+    }
+}
+
+} //namespace mempool::profiler
@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <cassert>
+#include <new>
+
+#include "context/combinators.h"
+
+namespace spec {
+
+C_Gather::C_Gather(Context *onfinish, uint32_t total, uint32_t quorum,
+                   gather_error policy, bool wait_all, sub_context *subs)
+    : m_onfinish(onfinish), m_total(total), m_quorum(quorum),
+      m_policy(policy), m_wait_all(wait_all), m_refs(total), m_subs(subs) {
+    for (uint32_t i = 0; i < total; ++i) {
+        new (&m_subs[i]) sub_context;
+        m_subs[i].m_gather = this;
+    }
+}
+
+C_Gather::~C_Gather() {
+    for (uint32_t i = 0; i < m_total; ++i) {
+        m_subs[i].~sub_context();
+    }
+}
+
+C_Gather* C_Gather::create(Context *onfinish, uint32_t total, uint32_t quorum,
+                           gather_error policy, bool wait_all) {
+    assert(total > 0 && quorum <= total);
+    if (!quorum) {
+        quorum = total;
+    }
+    // the gather then the subs, in one allocation
+    size_t head = (sizeof(C_Gather) + alignof(sub_context) - 1) &
+                  ~(alignof(sub_context) - 1);
+    char *p = static_cast<char*>(::operator new(head + total * sizeof(sub_context)));
+    auto subs = reinterpret_cast<sub_context*>(p + head);
+    return new (p) C_Gather(onfinish, total, quorum, policy, wait_all, subs);
+}
+
+void C_Gather::put() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~C_Gather();
+        ::operator delete(this);
+    }
+}
+
+void C_Gather::sub_done(int r) {
+    if (r < 0) {
+        int cur = 0;
+        if (!m_error.compare_exchange_strong(cur, r, std::memory_order_relaxed) &&
+            m_policy == gather_error::aggregate && cur != r && cur != -EIO) {
+            // the failed ops disagree
+            while (cur != -EIO &&
+                   !m_error.compare_exchange_weak(cur, -EIO, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    // release the error above to the one who completes onfinish
+    uint64_t inc = r < 0 ? 1ULL << 32 : 1;
+    uint64_t counts = m_counts.fetch_add(inc, std::memory_order_acq_rel) + inc;
+    uint32_t succ = counts & 0xffffffff;
+    uint32_t fail = counts >> 32;
+
+    // the counts only grow, exactly one sub sees the result decided
+    bool fire;
+    if (m_wait_all) {
+        fire = succ + fail == m_total;
+    } else if (r < 0) {
+        fire = fail == m_total - m_quorum + 1;
+    } else {
+        fire = succ == m_quorum;
+    }
+    if (fire) {
+        m_onfinish->complete(succ >= m_quorum ? 0 : m_error.load(std::memory_order_relaxed));
+    }
+    put();
+}
+
+} //namespace: spec
@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <atomic>
+#include <mutex>
+
+#include "compiler/likely.h"
+#include "context/completion.h"
+
+namespace spec {
+
+/* The completions come from 64-object slabs which are never freed. Every
+ * thread keeps its own freelist, a completion goes to the freelist of the
+ * thread releasing it. The global freelist balances the threads: a thread
+ * takes one batch from it when empty, and gives half back when it holds
+ * too many, e.g. it only completes the ops submitted by the others.
+ */
+namespace {
+
+struct free_node {
+    free_node *next;
+};
+
+constexpr size_t slab_objs = 64;
+constexpr size_t batch_objs = 64;
+constexpr size_t local_max = 1024;
+
+struct global_pool {
+    std::mutex lock;
+    free_node *head = nullptr;
+    size_t count = 0;
+    std::atomic<uint64_t> slabs{0};
+
+    void put(free_node *first, free_node *last, size_t n) {
+        std::lock_guard lk(lock);
+        last->next = head;
+        head = first;
+        count += n;
+    }
+
+    // return the number of nodes moved into *out
+    size_t get(free_node **out) {
+        std::lock_guard lk(lock);
+        size_t n = 0;
+        free_node *last = nullptr;
+        for (free_node *p = head; p && n < batch_objs; p = p->next) {
+            last = p;
+            ++n;
+        }
+        if (n) {
+            *out = head;
+            head = last->next;
+            last->next = nullptr;
+            count -= n;
+        }
+        return n;
+    }
+};
+
+global_pool& gpool() {
+    // never destroyed: the thread caches are flushed at thread exit
+    static global_pool *p = new global_pool;
+    return *p;
+}
+
+/* Set once the cache of the thread is destroyed, so the thread_local
+ * destructors run after it free to the global pool. It's not a member:
+ * the stores to a dying object may be dropped by the compiler.
+ */
+thread_local bool tl_cache_gone = false;
+
+struct local_cache {
+    free_node *head = nullptr;
+    size_t count = 0;
+
+    ~local_cache() {
+        flush();
+        tl_cache_gone = true;
+    }
+
+    void flush() {
+        if (head) {
+            free_node *last = head;
+            while (last->next) {
+                last = last->next;
+            }
+            gpool().put(head, last, count);
+            head = nullptr;
+            count = 0;
+        }
+    }
+
+    void refill() {
+        count = gpool().get(&head);
+        if (count) {
+            return;
+        }
+        auto slab = static_cast<char*>(
+            ::operator new(slab_objs * sizeof(completion),
+                           std::align_val_t(alignof(completion) > 64 ?
+                                            alignof(completion) : 64)));
+        for (size_t i = 0; i < slab_objs; ++i) {
+            auto n = reinterpret_cast<free_node*>(slab + i * sizeof(completion));
+            n->next = head;
+            head = n;
+        }
+        count = slab_objs;
+        gpool().slabs++;
+    }
+
+    void trim() {
+        // keep the recently freed half, it's hot in the cache
+        free_node *last = head;
+        for (size_t i = 1; i < count / 2; ++i) {
+            last = last->next;
+        }
+        free_node *rest = last->next;
+        last->next = nullptr;
+        size_t n = count - count / 2;
+        count /= 2;
+
+        free_node *tail = rest;
+        while (tail->next) {
+            tail = tail->next;
+        }
+        gpool().put(rest, tail, n);
+    }
+};
+
+thread_local local_cache tl_cache;
+
+} //namespace
+
+void* completion::alloc() {
+    if (unlikely(tl_cache_gone)) {
+        // a batch for this one only, the rest goes back at once
+        local_cache tmp;
+        tmp.refill();
+        free_node *n = tmp.head;
+        tmp.head = n->next;
+        tmp.count--;
+        return n;
+    }
+    local_cache& cache = tl_cache;
+    if (!cache.head) {
+        cache.refill();
+    }
+    free_node *n = cache.head;
+    cache.head = n->next;
+    cache.count--;
+    return n;
+}
+
+void completion::free(void *p) {
+    auto n = static_cast<free_node*>(p);
+    if (unlikely(tl_cache_gone)) {
+        gpool().put(n, n, 1);
+        return;
+    }
+    local_cache& cache = tl_cache;
+    n->next = cache.head;
+    cache.head = n;
+    if (++cache.count > local_max) {
+        cache.trim();
+    }
+}
+
+completion::pool_stats completion::get_pool_stats() {
+    global_pool& g = gpool();
+    std::lock_guard lk(g.lock);
+    return {g.slabs.load(), g.count};
+}
+
+} //namespace: spec
@@ -0,0 +1,322 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include <boost/context/fiber.hpp>
+#include <boost/context/pooled_fixedsize_stack.hpp>
+
+#include "context/coroutine.h"
+#include "context/file_io.h"
+#include "context/timer_wheel.h"
+#include "safe_io.h"
+
+namespace spec {
+
+namespace bctx = boost::context;
+
+namespace {
+
+// task::state, see await()
+enum {
+    RUNNING,
+    WAITING,
+    NOTIFIED,
+};
+
+// why the coroutine switched back to the core
+enum class switch_reason {
+    yield,
+    wait,
+    done,
+};
+
+} //namespace
+
+struct co_scheduler::task {
+    std::function<void()> fn;
+    core *home;
+    bctx::fiber fiber;          // the suspended coroutine
+    bctx::fiber sched;          // the core loop, while the coroutine runs
+    std::atomic<int> state{RUNNING};
+    switch_reason why = switch_reason::yield;
+    bool started = false;
+    task *next = nullptr;
+
+    task(std::function<void()>&& f, core *c) : fn(std::move(f)), home(c) {}
+};
+
+struct co_scheduler::core {
+    co_scheduler *owner;
+    unsigned id;
+    bctx::pooled_fixedsize_stack stacks;
+
+    // local FIFO, by the core thread only
+    task *head = nullptr;
+    task *tail = nullptr;
+
+    // pushed by the other threads
+    alignas(64) std::atomic<task*> inbox{nullptr};
+
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::mutex lock;
+    std::condition_variable cond;
+    std::thread thread;
+
+    core(co_scheduler *s, unsigned i, size_t stack_size)
+        : owner(s), id(i), stacks(stack_size) {}
+
+    void append(task *t) {
+        t->next = nullptr;
+        if (tail) {
+            tail->next = t;
+        } else {
+            head = t;
+        }
+        tail = t;
+    }
+
+    task* pop() {
+        task *t = head;
+        if (t) {
+            head = t->next;
+            if (!head) {
+                tail = nullptr;
+            }
+        }
+        return t;
+    }
+};
+
+static thread_local co_scheduler::core *tl_core = nullptr;
+static thread_local co_scheduler::task *tl_task = nullptr;
+
+co_scheduler::co_scheduler(const options& opts)
+    : m_opts(opts),
+      m_io(std::make_unique<file_io>(opts.io_threads)),
+      m_timer(std::make_unique<timer_wheel>()) {
+    unsigned n = m_opts.cores;
+    if (!n) {
+        n = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        m_cores.emplace_back(std::make_unique<core>(this, i, m_opts.stack_size));
+    }
+    for (auto& c : m_cores) {
+        c->thread = std::thread(&co_scheduler::entry, this, std::ref(*c));
+    }
+    m_timer->start();
+}
+
+co_scheduler::~co_scheduler() {
+    wait_for_empty();
+    m_stopping.store(true);
+    for (auto& c : m_cores) {
+        std::lock_guard lk(c->lock);
+        c->cond.notify_one();
+    }
+    for (auto& c : m_cores) {
+        c->thread.join();
+    }
+    m_timer->stop();
+}
+
+void co_scheduler::spawn(std::function<void()> fn) {
+    uint64_t i = m_next_core.fetch_add(1, std::memory_order_relaxed);
+    spawn_on(i % m_cores.size(), std::move(fn));
+}
+
+void co_scheduler::spawn_on(unsigned core, std::function<void()> fn) {
+    assert(!m_stopping.load(std::memory_order_relaxed));
+    m_live.fetch_add(1, std::memory_order_relaxed);
+    push(new task(std::move(fn), m_cores[core % m_cores.size()].get()));
+}
+
+void co_scheduler::task_done() {
+    if (m_live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard lk(m_lock);
+        m_cond.notify_all();
+    }
+}
+
+void co_scheduler::wait_for_empty() {
+    std::unique_lock lk(m_lock);
+    m_cond.wait(lk, [this] { return m_live.load(std::memory_order_acquire) == 0; });
+}
+
+void co_scheduler::push(task *t) {
+    core& c = *t->home;
+    if (tl_core == &c) {
+        c.append(t);
+        return;
+    }
+    task *head = c.inbox.load(std::memory_order_relaxed);
+    do {
+        t->next = head;
+    } while (!c.inbox.compare_exchange_weak(head, t, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed));
+    if (c.sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard lk(c.lock);
+        c.cond.notify_one();
+    }
+}
+
+void co_scheduler::entry(core& c) {
+    tl_core = &c;
+    if (m_opts.pin_cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(c.id % std::max(1u, std::thread::hardware_concurrency()), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    std::string name = "co_core-" + std::to_string(c.id);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+    while (true) {
+        task *t = c.pop();
+        if (!t && c.inbox.load(std::memory_order_relaxed)) {
+            // newest first, reverse it into the FIFO
+            task *list = c.inbox.exchange(nullptr, std::memory_order_acquire);
+            task *rev = nullptr;
+            while (list) {
+                task *next = list->next;
+                list->next = rev;
+                rev = list;
+                list = next;
+            }
+            while (rev) {
+                task *next = rev->next;
+                c.append(rev);
+                rev = next;
+            }
+            t = c.pop();
+        }
+        if (t) {
+            run(c, t);
+            continue;
+        }
+        if (m_stopping.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        std::unique_lock lk(c.lock);
+        c.sleeping.store(true, std::memory_order_seq_cst);
+        if (!c.inbox.load(std::memory_order_seq_cst) &&
+            !m_stopping.load(std::memory_order_seq_cst)) {
+            c.cond.wait(lk);
+        }
+        c.sleeping.store(false, std::memory_order_relaxed);
+    }
+    tl_core = nullptr;
+}
+
+void co_scheduler::run(core& c, task *t) {
+    if (!t->started) {
+        t->started = true;
+        t->fiber = bctx::fiber(std::allocator_arg, c.stacks,
+            [t](bctx::fiber&& sched) {
+                t->sched = std::move(sched);
+                t->fn();
+                t->why = switch_reason::done;
+                return std::move(t->sched);
+            });
+    }
+
+    tl_task = t;
+    t->fiber = std::move(t->fiber).resume();
+    tl_task = nullptr;
+
+    switch (t->why) {
+    case switch_reason::yield:
+        c.append(t);
+        break;
+    case switch_reason::wait: {
+        // park it, unless it's already woken up
+        int expected = RUNNING;
+        if (!t->state.compare_exchange_strong(expected, WAITING,
+                                              std::memory_order_acq_rel)) {
+            c.append(t);
+        }
+        break;
+    }
+    case switch_reason::done:
+        delete t;
+        task_done();
+        break;
+    }
+}
+
+co_scheduler::task* co_scheduler::current() {
+    return tl_task;
+}
+
+co_scheduler* co_scheduler::scheduler() {
+    return tl_core ? tl_core->owner : nullptr;
+}
+
+static void suspend(co_scheduler::task *t) {
+    t->sched = std::move(t->sched).resume();
+}
+
+void co_scheduler::yield() {
+    task *t = current();
+    assert(t);
+    t->why = switch_reason::yield;
+    suspend(t);
+}
+
+void co_scheduler::prepare_wait(task *t) {
+    t->state.store(RUNNING, std::memory_order_relaxed);
+}
+
+void co_scheduler::wait(task *t) {
+    // completed inline, no switch
+    if (t->state.load(std::memory_order_acquire) == NOTIFIED) {
+        return;
+    }
+    t->why = switch_reason::wait;
+    suspend(t);
+}
+
+void co_scheduler::wake(task *t) {
+    if (t->state.exchange(NOTIFIED, std::memory_order_acq_rel) == WAITING) {
+        push(t);
+    }
+}
+
+void co_scheduler::sleep_for(uint64_t ns) {
+    await([ns](Context *c) { scheduler()->timer().add_after(ns, c); });
+}
+
+ssize_t co_scheduler::pread(int fd, void *buf, size_t len, off_t off) {
+    if (!in_coroutine()) {
+        return safe_pread(fd, buf, len, off);
+    }
+    return await([&](Context *c) { scheduler()->io().pread(fd, buf, len, off, c); });
+}
+
+ssize_t co_scheduler::pwrite(int fd, const void *buf, size_t len, off_t off) {
+    if (!in_coroutine()) {
+        ssize_t r = safe_pwrite(fd, buf, len, off);
+        return r < 0 ? r : len;
+    }
+    return await([&](Context *c) { scheduler()->io().pwrite(fd, buf, len, off, c); });
+}
+
+int co_scheduler::fsync(int fd) {
+    if (!in_coroutine()) {
+        return ::fsync(fd) < 0 ? -errno : 0;
+    }
+    return await([&](Context *c) { scheduler()->io().fsync(fd, c); });
+}
+
+} //namespace: spec
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "context/file_io.h"
+#include "safe_io.h"
+
+namespace spec {
+
+static finisher_options io_options(unsigned threads) {
+    finisher_options opts(threads);
+    opts.name = "file_io";
+    return opts;
+}
+
+file_io::file_io(unsigned threads) : m_workers(io_options(threads)) {
+}
+
+void file_io::pread(int fd, void *buf, size_t len, off_t off, Context *onfinish) {
+    m_workers.queue([=](int) {
+        onfinish->complete(safe_pread(fd, buf, len, off));
+    });
+}
+
+void file_io::pwrite(int fd, const void *buf, size_t len, off_t off, Context *onfinish) {
+    m_workers.queue([=](int) {
+        ssize_t r = safe_pwrite(fd, buf, len, off);
+        // safe_pwrite() returns 0 once it's all written
+        onfinish->complete(r < 0 ? r : len);
+    });
+}
+
+void file_io::fsync(int fd, Context *onfinish) {
+    m_workers.queue([=](int) {
+        onfinish->complete(::fsync(fd) < 0 ? -errno : 0);
+    });
+}
+
+} //namespace: spec
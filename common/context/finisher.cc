@@ -0,0 +1,374 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "context/finisher.h"
+
+namespace spec {
+
+namespace {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// enqueue time in 16ns ticks, it wraps after ~68s
+inline uint32_t now_ticks() {
+    auto ns = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ns).count() >> 4;
+}
+
+/* Chase-Lev deque(the C11 version by Le, Pop, Cohen & Zappa Nardelli).
+ * The owner pushes and pops the bottom, the thieves steal the top. It
+ * doesn't grow, push() fails when it's full.
+ */
+class work_deque {
+private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    const int64_t m_mask;
+    std::unique_ptr<std::atomic<completion*>[]> m_buf;
+
+public:
+    explicit work_deque(size_t size)
+        : m_mask(size - 1), m_buf(new std::atomic<completion*>[size]) {
+        assert(size && (size & (size - 1)) == 0);
+    }
+
+    bool push(completion *c) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t > m_mask) {
+            return false;
+        }
+        m_buf[b & m_mask].store(c, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    completion* pop() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        if (t > b) {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        completion *c = m_buf[b & m_mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // the last one, race with the thieves
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed)) {
+                c = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return c;
+    }
+
+    // return nullptr if it's empty or another thief wins
+    completion* steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        completion *c = m_buf[t & m_mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return c;
+    }
+
+    bool empty() const {
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return m_bottom.load(std::memory_order_relaxed) <= t;
+    }
+};
+
+} //namespace
+
+struct finisher::worker {
+    finisher *owner;
+    unsigned id;
+    work_deque deque;
+
+    // written by the producers
+    alignas(64) std::atomic<completion*> inbox{nullptr};
+    std::atomic<uint64_t> queued{0};
+
+    // written by the worker only
+    alignas(64) std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> stolen{0};
+    std::atomic<uint64_t> latency_count{0};
+    std::atomic<uint64_t> latency_sum{0};
+    std::atomic<uint64_t> latency_max{0};
+
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::mutex lock;
+    std::condition_variable cond;
+    std::thread thread;
+
+    worker(finisher *f, unsigned i, size_t deque_size)
+        : owner(f), id(i), deque(deque_size) {}
+};
+
+thread_local finisher::worker *finisher::tl_worker = nullptr;
+
+finisher::finisher(const options& opts) : m_opts(opts) {
+    unsigned n = m_opts.threads;
+    if (!n) {
+        n = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        m_workers.emplace_back(std::make_unique<worker>(this, i, m_opts.deque_size));
+    }
+    for (auto& w : m_workers) {
+        w->thread = std::thread(&finisher::entry, this, std::ref(*w));
+    }
+}
+
+finisher::~finisher() {
+    stop();
+}
+
+void finisher::stop() {
+    if (m_stopped) {
+        return;
+    }
+    m_stopping.store(true);
+    for (auto& w : m_workers) {
+        wake(*w);
+    }
+    for (auto& w : m_workers) {
+        w->thread.join();
+    }
+    m_stopped = true;
+}
+
+void finisher::queue(completion *c, int r) {
+    c->set_result(r);
+    if (m_opts.track_latency) {
+        c->set_tag(now_ticks());
+    }
+    push(c);
+}
+
+void finisher::push(completion *c) {
+    worker *self = tl_worker;
+    if (self && self->owner == this) {
+        self->queued.fetch_add(1, std::memory_order_relaxed);
+        if (!self->deque.push(c)) {
+            // full, run it now
+            run(*self, c);
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            wake_idle();
+        }
+        return;
+    }
+
+    assert(!m_stopping.load(std::memory_order_relaxed));
+    uint64_t i = m_next_worker.fetch_add(1, std::memory_order_relaxed);
+    worker& w = *m_workers[i % m_workers.size()];
+    w.queued.fetch_add(1, std::memory_order_relaxed);
+    completion *head = w.inbox.load(std::memory_order_relaxed);
+    do {
+        c->set_next(head);
+    } while (!w.inbox.compare_exchange_weak(head, c, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed));
+    if (w.sleeping.load(std::memory_order_seq_cst)) {
+        wake(w);
+    } else if (m_sleeping.load(std::memory_order_seq_cst)) {
+        // w is busy, let an idle one steal it
+        wake_idle();
+    }
+}
+
+void finisher::entry(worker& w) {
+    tl_worker = &w;
+    if (m_opts.pin_cpus) {
+        int cpu;
+        if (m_opts.cpus.empty()) {
+            cpu = w.id % std::max(1u, std::thread::hardware_concurrency());
+        } else {
+            cpu = m_opts.cpus[w.id % m_opts.cpus.size()];
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    std::string name = m_opts.name.substr(0, 10) + "-" + std::to_string(w.id);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+    while (true) {
+        if (run_batch(w)) {
+            continue;
+        }
+        if (m_stopping.load(std::memory_order_acquire) && !has_work()) {
+            break;
+        }
+        idle(w);
+    }
+    tl_worker = nullptr;
+}
+
+void finisher::run(worker& w, completion *c) {
+    if (m_opts.track_latency) {
+        uint64_t ns = (uint64_t)(uint32_t)(now_ticks() - c->tag()) << 4;
+        w.latency_count.store(w.latency_count.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_relaxed);
+        w.latency_sum.store(w.latency_sum.load(std::memory_order_relaxed) + ns,
+                            std::memory_order_relaxed);
+        if (ns > w.latency_max.load(std::memory_order_relaxed)) {
+            w.latency_max.store(ns, std::memory_order_relaxed);
+        }
+    }
+    c->complete();
+    w.completed.store(w.completed.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+}
+
+bool finisher::take_inbox(worker& w, worker& from) {
+    if (!from.inbox.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    completion *c = from.inbox.exchange(nullptr, std::memory_order_acquire);
+    if (!c) {
+        return false;
+    }
+    // newest first, so the bottom of the deque is the oldest one
+    while (c) {
+        completion *next = c->next();
+        c->set_next(nullptr);
+        if (!w.deque.push(c)) {
+            run(w, c);
+        }
+        c = next;
+    }
+    return true;
+}
+
+bool finisher::run_batch(worker& w) {
+    take_inbox(w, w);
+
+    size_t n = 0;
+    completion *c;
+    while (n < m_opts.batch && (c = w.deque.pop())) {
+        run(w, c);
+        ++n;
+    }
+    if (n) {
+        return true;
+    }
+
+    // steal from the others, starting from the next one
+    size_t num = m_workers.size();
+    for (size_t i = 1; i < num; ++i) {
+        worker& v = *m_workers[(w.id + i) % num];
+        while (n < m_opts.batch / 2 + 1 && (c = v.deque.steal())) {
+            w.stolen.store(w.stolen.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+            run(w, c);
+            ++n;
+        }
+        if (n) {
+            return true;
+        }
+        if (take_inbox(w, v)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool finisher::has_work() const {
+    for (auto& w : m_workers) {
+        if (!w->deque.empty() || w->inbox.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void finisher::idle(worker& w) {
+    for (int i = 0; i < 128; ++i) {
+        cpu_relax();
+        if (has_work()) {
+            return;
+        }
+    }
+
+    std::unique_lock lk(w.lock);
+    w.sleeping.store(true, std::memory_order_seq_cst);
+    m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+    // pairs with the fence after pushing: either we see the item, or the
+    // producer sees us sleeping and wakes us under the lock
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_work() && !m_stopping.load(std::memory_order_seq_cst)) {
+        w.cond.wait(lk);
+    }
+    m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+    w.sleeping.store(false, std::memory_order_relaxed);
+}
+
+void finisher::wake(worker& w) {
+    std::lock_guard lk(w.lock);
+    w.cond.notify_one();
+}
+
+void finisher::wake_idle() {
+    for (auto& w : m_workers) {
+        if (w->sleeping.load(std::memory_order_relaxed)) {
+            wake(*w);
+            return;
+        }
+    }
+}
+
+void finisher::wait_for_empty() {
+    for (int i = 0; get_perf().queue_depth; ++i) {
+        if (i < 100) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+finisher::perf_counters finisher::get_perf() const {
+    perf_counters perf;
+    // completed first, everything it counts is already counted by queued
+    for (auto& w : m_workers) {
+        perf.completed += w->completed.load(std::memory_order_acquire);
+        perf.stolen += w->stolen.load(std::memory_order_relaxed);
+        perf.latency_count += w->latency_count.load(std::memory_order_relaxed);
+        perf.latency_sum_ns += w->latency_sum.load(std::memory_order_relaxed);
+        perf.latency_max_ns = std::max(perf.latency_max_ns,
+                                       w->latency_max.load(std::memory_order_relaxed));
+    }
+    for (auto& w : m_workers) {
+        perf.queued += w->queued.load(std::memory_order_acquire);
+    }
+    perf.sync_completed = m_sync_completed.load(std::memory_order_relaxed);
+    perf.queue_depth = perf.queued - perf.completed;
+    return perf;
+}
+
+} //namespace: spec
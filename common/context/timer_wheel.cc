@@ -0,0 +1,356 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "clock/spec_clock.h"
+#include "context/finisher.h"
+#include "context/timer_wheel.h"
+
+namespace spec {
+
+static constexpr uint64_t level_mask = timer_wheel::level_slots - 1;
+
+static inline unsigned level_shift(unsigned level) {
+    return level * timer_wheel::level_bits;
+}
+
+timer_wheel::timer_wheel(uint64_t tick_ns, finisher *fin)
+    : m_tick_ns(tick_ns), m_finisher(fin) {
+    assert(tick_ns > 0);
+    m_tick = clock_ns() / m_tick_ns;
+    std::fill(std::begin(m_heads), std::end(m_heads), nil);
+    std::fill(std::begin(m_bitmap), std::end(m_bitmap), 0);
+}
+
+timer_wheel::~timer_wheel() {
+    stop();
+    cancel_all();
+}
+
+uint64_t timer_wheel::clock_ns() {
+    return spec_mono_now().to_nsec();
+}
+
+uint32_t timer_wheel::alloc_node() {
+    if (m_free != nil) {
+        uint32_t i = m_free;
+        m_free = at(i).next;
+        return i;
+    }
+    if ((m_num_nodes >> chunk_bits) == m_chunks.size()) {
+        std::unique_ptr<node[]> chunk(new node[1U << chunk_bits]);
+        for (uint32_t i = 0; i < (1U << chunk_bits); ++i) {
+            chunk[i].gen = 1;
+            chunk[i].ctx = nullptr;
+        }
+        m_chunks.push_back(std::move(chunk));
+    }
+    return m_num_nodes++;
+}
+
+void timer_wheel::free_node(uint32_t i) {
+    node& n = at(i);
+    n.ctx = nullptr;
+    // the stale ids never match, 0 is never a valid id
+    if (++n.gen == 0) {
+        n.gen = 1;
+    }
+    n.next = m_free;
+    m_free = i;
+}
+
+void timer_wheel::link(uint32_t i) {
+    node& n = at(i);
+    if (n.expires < m_tick) {
+        n.slot = overdue;
+        n.prev = nil;
+        n.next = m_heads[overdue];
+        if (n.next != nil) {
+            at(n.next).prev = i;
+        }
+        m_heads[overdue] = i;
+        return;
+    }
+    uint64_t expires = n.expires;
+    uint64_t delta = expires - m_tick;
+
+    unsigned level = 0;
+    while (level + 1 < levels && delta >> level_shift(level + 1)) {
+        ++level;
+    }
+    if (delta >> level_shift(levels)) {
+        // out of range, wait in the last slot before the current one
+        expires = m_tick + (1ULL << level_shift(levels)) - 1;
+    }
+
+    unsigned slot = level * level_slots + ((expires >> level_shift(level)) & level_mask);
+    n.slot = slot;
+    n.prev = nil;
+    n.next = m_heads[slot];
+    if (n.next != nil) {
+        at(n.next).prev = i;
+    }
+    m_heads[slot] = i;
+    m_bitmap[level] |= 1ULL << (slot & level_mask);
+}
+
+void timer_wheel::unlink(uint32_t i) {
+    node& n = at(i);
+    if (n.prev != nil) {
+        at(n.prev).next = n.next;
+    } else {
+        m_heads[n.slot] = n.next;
+        if (n.next == nil && n.slot != overdue) {
+            m_bitmap[n.slot / level_slots] &= ~(1ULL << (n.slot & level_mask));
+        }
+    }
+    if (n.next != nil) {
+        at(n.next).prev = n.prev;
+    }
+}
+
+void timer_wheel::cascade(unsigned level, unsigned index) {
+    unsigned slot = level * level_slots + index;
+    uint32_t i = m_heads[slot];
+    m_heads[slot] = nil;
+    m_bitmap[level] &= ~(1ULL << index);
+    while (i != nil) {
+        uint32_t next = at(i).next;
+        link(i);
+        i = next;
+    }
+}
+
+void timer_wheel::expire(uint32_t slot, std::vector<Context*>& fired) {
+    uint32_t i = m_heads[slot];
+    m_heads[slot] = nil;
+    if (slot != overdue) {
+        m_bitmap[slot / level_slots] &= ~(1ULL << (slot & level_mask));
+    }
+    while (i != nil) {
+        node& n = at(i);
+        uint32_t next = n.next;
+        fired.push_back(n.ctx);
+        free_node(i);
+        --m_size;
+        i = next;
+    }
+}
+
+void timer_wheel::advance_locked(uint64_t now_ns, std::vector<Context*>& fired) {
+    expire(overdue, fired);
+
+    uint64_t target = now_ns / m_tick_ns;
+    while (m_tick <= target) {
+        unsigned index = m_tick & level_mask;
+        if (index == 0) {
+            // move the timers of the reached slots one level down
+            for (unsigned level = 1; level < levels; ++level) {
+                unsigned idx = (m_tick >> level_shift(level)) & level_mask;
+                cascade(level, idx);
+                if (idx) {
+                    break;
+                }
+            }
+        }
+
+        if (m_bitmap[0] & (1ULL << index)) {
+            expire(index, fired);
+        }
+
+        // jump to the next tick where something fires or cascades
+        m_tick++;
+        m_tick = std::min(std::max(next_tick(), m_tick), target + 1);
+    }
+}
+
+uint64_t timer_wheel::next_tick() const {
+    if (m_heads[overdue] != nil) {
+        return m_tick - 1;
+    }
+    uint64_t best = UINT64_MAX;
+    for (unsigned level = 0; level < levels; ++level) {
+        uint64_t bits = m_bitmap[level];
+        if (!bits) {
+            continue;
+        }
+        unsigned shift = level_shift(level);
+        unsigned cur = (m_tick >> shift) & level_mask;
+        /* The first busy slot from the current one, wrapping around. Once
+         * m_tick is past the boundary of the current slot of an upper level,
+         * that slot is cascaded and only holds the timers one round ahead.
+         * On the boundary it's not cascaded yet and due at m_tick.
+         */
+        unsigned from = (m_tick & ((1ULL << shift) - 1)) ? cur + 1 : cur;
+        uint64_t ahead = from < level_slots ? bits >> from << from : 0;
+        unsigned dist;
+        if (ahead) {
+            dist = __builtin_ctzll(ahead) - cur;
+        } else {
+            dist = __builtin_ctzll(bits) + level_slots - cur;
+        }
+        uint64_t tick = ((m_tick >> shift) + dist) << shift;
+        best = std::min(best, std::max(tick, m_tick));
+    }
+    return best;
+}
+
+void timer_wheel::fire(std::vector<Context*>& fired) {
+    for (Context *ctx : fired) {
+        if (m_finisher) {
+            m_finisher->queue(ctx, 0);
+        } else {
+            ctx->complete(0);
+        }
+    }
+    fired.clear();
+}
+
+timer_wheel::timer_id timer_wheel::add_at_ns(uint64_t when_ns, Context *ctx) {
+    uint64_t expires = (when_ns + m_tick_ns - 1) / m_tick_ns;
+    std::lock_guard lk(m_lock);
+    uint32_t i = alloc_node();
+    node& n = at(i);
+    n.expires = expires;
+    n.ctx = ctx;
+    link(i);
+    ++m_size;
+    if (expires < m_wake_tick && m_thread.joinable()) {
+        m_cond.notify_one();
+    }
+    return (uint64_t)n.gen << 32 | i;
+}
+
+timer_wheel::timer_id timer_wheel::add_at(utime_t when, Context *ctx) {
+    utime_t now = spec_clock_now();
+    uint64_t delay = when > now ? (when - now).to_nsec() : 0;
+    return add_after(delay, ctx);
+}
+
+bool timer_wheel::cancel(timer_id id) {
+    uint32_t i = id & 0xffffffff;
+    Context *ctx;
+    {
+        std::lock_guard lk(m_lock);
+        if (i >= m_num_nodes) {
+            return false;
+        }
+        node& n = at(i);
+        if (n.gen != id >> 32 || !n.ctx) {
+            return false;
+        }
+        ctx = n.ctx;
+        unlink(i);
+        free_node(i);
+        --m_size;
+    }
+    delete ctx;
+    return true;
+}
+
+void timer_wheel::cancel_all() {
+    std::vector<Context*> canceled;
+    {
+        std::lock_guard lk(m_lock);
+        for (unsigned slot = 0; slot <= overdue; ++slot) {
+            for (uint32_t i = m_heads[slot]; i != nil; ) {
+                uint32_t next = at(i).next;
+                canceled.push_back(at(i).ctx);
+                free_node(i);
+                i = next;
+            }
+            m_heads[slot] = nil;
+        }
+        std::fill(std::begin(m_bitmap), std::end(m_bitmap), 0);
+        m_size = 0;
+    }
+    for (Context *ctx : canceled) {
+        delete ctx;
+    }
+}
+
+size_t timer_wheel::advance_to(uint64_t now_ns) {
+    std::vector<Context*> fired;
+    {
+        std::lock_guard lk(m_lock);
+        advance_locked(now_ns, fired);
+    }
+    size_t n = fired.size();
+    fire(fired);
+    return n;
+}
+
+uint64_t timer_wheel::next_expiry_ns() const {
+    std::lock_guard lk(m_lock);
+    uint64_t tick = next_tick();
+    return tick == UINT64_MAX ? UINT64_MAX : tick * m_tick_ns;
+}
+
+int timer_wheel::next_timeout_ms() const {
+    uint64_t when = next_expiry_ns();
+    if (when == UINT64_MAX) {
+        return -1;
+    }
+    uint64_t now = clock_ns();
+    if (when <= now) {
+        return 0;
+    }
+    return std::min<uint64_t>((when - now + 999999) / 1000000, INT32_MAX);
+}
+
+size_t timer_wheel::size() const {
+    std::lock_guard lk(m_lock);
+    return m_size;
+}
+
+void timer_wheel::entry() {
+    std::vector<Context*> fired;
+    std::unique_lock lk(m_lock);
+    while (!m_stopping) {
+        uint64_t now = clock_ns();
+        uint64_t next = next_tick();
+        if (next > now / m_tick_ns) {
+            m_wake_tick = next;
+            if (next == UINT64_MAX) {
+                m_cond.wait(lk);
+            } else {
+                std::chrono::steady_clock::time_point tp(
+                    std::chrono::nanoseconds(next * m_tick_ns));
+                m_cond.wait_until(lk, tp);
+            }
+            m_wake_tick = UINT64_MAX;
+            continue;
+        }
+        advance_locked(now, fired);
+        lk.unlock();
+        fire(fired);
+        lk.lock();
+    }
+}
+
+void timer_wheel::start() {
+    std::lock_guard lk(m_lock);
+    if (!m_thread.joinable()) {
+        m_stopping = false;
+        m_thread = std::thread(&timer_wheel::entry, this);
+    }
+}
+
+void timer_wheel::stop() {
+    {
+        std::lock_guard lk(m_lock);
+        if (!m_thread.joinable()) {
+            return;
+        }
+        m_stopping = true;
+        m_cond.notify_one();
+    }
+    m_thread.join();
+}
+
+} //namespace: spec
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <string.h>
+
+#include "crc32/checksum.h"
+#include "crc32/crc32c.h"
+#include "crc32/crc64.h"
+#include "crc32/xxhash64.h"
+
+static uint64_t csum_none(uint64_t, unsigned char const *, unsigned) {
+    return 0;
+}
+
+static uint64_t csum_crc32c(uint64_t seed, unsigned char const *data,
+                            unsigned length) {
+    return spec_crc32c((uint32_t)seed, data, length);
+}
+
+static uint64_t csum_crc32c_zeros(uint64_t seed, uint64_t length) {
+    uint32_t crc = (uint32_t)seed;
+    while (length > UINT32_MAX) {
+        crc = crc32c_zeros(crc, 1U << 31);
+        length -= 1U << 31;
+    }
+    return crc32c_zeros(crc, (unsigned)length);
+}
+
+static uint64_t csum_crc64(uint64_t seed, unsigned char const *data,
+                           unsigned length) {
+    return spec_crc64(seed, data, length);
+}
+
+static uint64_t csum_xxh64(uint64_t seed, unsigned char const *data,
+                           unsigned length) {
+    // zero-filled like the crc
+    if (!data) {
+        static const unsigned char zero[4096] = {0};
+        struct spec_xxh64_state st;
+        spec_xxh64_reset(&st, seed);
+        while (length) {
+            unsigned n = length < sizeof(zero) ? length : sizeof(zero);
+            spec_xxh64_update(&st, zero, n);
+            length -= n;
+        }
+        return spec_xxh64_digest(&st);
+    }
+    return spec_xxh64(seed, data, length);
+}
+
+static const struct spec_csum_kernel csum_kernels[SPEC_CSUM_MAX] = {
+    {"none", 0, csum_none, nullptr},
+    {"crc32c", 4, csum_crc32c, csum_crc32c_zeros},
+    {"crc64", 8, csum_crc64, crc64_zeros},
+    {"xxh64", 8, csum_xxh64, nullptr},
+};
+
+const struct spec_csum_kernel *spec_csum_get_kernel(int type) {
+    if (type < 0 || type >= SPEC_CSUM_MAX) {
+        return nullptr;
+    }
+    return &csum_kernels[type];
+}
+
+int spec_csum_from_name(const char *name) {
+    for (int i = 0; i < SPEC_CSUM_MAX; ++i) {
+        if (!strcmp(csum_kernels[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,107 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32/crc32c.h"
+#include "crc32c_intel_multi.h"
+
+#ifdef __x86_64__
+
+#include <nmmintrin.h>
+
+#define CRC32C_MULTI_WAYS 4
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, unsigned char const *p,
+                             unsigned len) {
+    uint64_t c = crc;
+    uint64_t v;
+
+    while (len >= 8) {
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+/*
+ * The crc32 instruction has 3 cycles latency but 1 cycle throughput, one
+ * stream can only use 1/3 of the port since every step depends on the
+ * previous one. Running 4 independent streams in turn keeps the port busy.
+ */
+__attribute__((target("sse4.2")))
+void crc32c_multi_intel(unsigned char const *const *bufs,
+                        unsigned const *lens,
+                        uint32_t *crcs,
+                        unsigned n) {
+    unsigned i = 0;
+
+    for (; i + CRC32C_MULTI_WAYS <= n; i += CRC32C_MULTI_WAYS) {
+        unsigned char const *p0 = bufs[i];
+        unsigned char const *p1 = bufs[i + 1];
+        unsigned char const *p2 = bufs[i + 2];
+        unsigned char const *p3 = bufs[i + 3];
+
+        // zero buffers go to crc32c_zeros
+        if (!p0 || !p1 || !p2 || !p3) {
+            unsigned k;
+            for (k = i; k < i + CRC32C_MULTI_WAYS; ++k) {
+                crcs[k] = spec_crc32c(crcs[k], bufs[k], lens[k]);
+            }
+            continue;
+        }
+
+        unsigned common = lens[i];
+        unsigned k;
+        for (k = 1; k < CRC32C_MULTI_WAYS; ++k) {
+            if (lens[i + k] < common) {
+                common = lens[i + k];
+            }
+        }
+        common &= ~7U;
+
+        uint64_t c0 = crcs[i];
+        uint64_t c1 = crcs[i + 1];
+        uint64_t c2 = crcs[i + 2];
+        uint64_t c3 = crcs[i + 3];
+        uint64_t v0, v1, v2, v3;
+        unsigned off;
+        for (off = 0; off < common; off += 8) {
+            memcpy(&v0, p0 + off, 8);
+            memcpy(&v1, p1 + off, 8);
+            memcpy(&v2, p2 + off, 8);
+            memcpy(&v3, p3 + off, 8);
+            c0 = _mm_crc32_u64(c0, v0);
+            c1 = _mm_crc32_u64(c1, v1);
+            c2 = _mm_crc32_u64(c2, v2);
+            c3 = _mm_crc32_u64(c3, v3);
+        }
+
+        // the tails of different length
+        crcs[i] = crc32c_sse42((uint32_t)c0, p0 + common, lens[i] - common);
+        crcs[i + 1] = crc32c_sse42((uint32_t)c1, p1 + common, lens[i + 1] - common);
+        crcs[i + 2] = crc32c_sse42((uint32_t)c2, p2 + common, lens[i + 2] - common);
+        crcs[i + 3] = crc32c_sse42((uint32_t)c3, p3 + common, lens[i + 3] - common);
+    }
+
+    for (; i < n; ++i) {
+        if (bufs[i]) {
+            crcs[i] = crc32c_sse42(crcs[i], bufs[i], lens[i]);
+        } else {
+            crcs[i] = spec_crc32c(crcs[i], NULL, lens[i]);
+        }
+    }
+}
+
+#endif
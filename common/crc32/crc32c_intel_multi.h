@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef COMMON_CRC32C_INTEL_MULTI_H
+#define COMMON_CRC32C_INTEL_MULTI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifdef __x86_64__
+
+/* interleave 4 independent streams with sse4.2 crc32 instruction */
+extern void crc32c_multi_intel(unsigned char const *const *bufs,
+                               unsigned const *lens,
+                               uint32_t *crcs,
+                               unsigned n);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdint.h>
+
+#include "crc32c_intel_zeros.h"
+
+#ifdef __x86_64__
+
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+/*
+ * crc32(0, v) of the 64 bits v is v * x^32 mod P, and the carry-less
+ * product of 2 reflected 32 bits values is a * b * x in reflected 64 bits,
+ * so one clmul and one crc32 give a * b * x^33 mod P.
+ */
+__attribute__((target("sse4.2,pclmul")))
+uint32_t crc32c_zeros_intel(uint32_t crc, unsigned len) {
+    unsigned i;
+    for (i = 0; i < (len & 7); ++i) {
+        crc = _mm_crc32_u8(crc, 0);
+    }
+
+    // one multiply per bit set in the length
+    for (len >>= 3; len && crc; len &= len - 1) {
+        uint32_t k = crc32c_zeros_k[3 + __builtin_ctz(len)];
+        __m128i p = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc),
+                                         _mm_cvtsi32_si128((int)k), 0x00);
+        crc = (uint32_t)_mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(p));
+    }
+    return crc;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef COMMON_CRC32C_INTEL_ZEROS_H
+#define COMMON_CRC32C_INTEL_ZEROS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* x^(8 * 2^k - 33) mod P in reflected form for k >= 3, computed at compile
+ * time. Multiplying the crc by it and reducing the 64 bits product with
+ * crc32c moves the crc over 2^k zero bytes.
+ */
+extern const uint32_t crc32c_zeros_k[32];
+
+#ifdef __x86_64__
+
+/* carry-less multiply with pclmul, reduce with sse4.2 crc32 */
+extern uint32_t crc32c_zeros_intel(uint32_t crc, unsigned length);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <string.h>
+
+#include <initializer_list>
+
+#include "crc32/crc64.h"
+#include "arch/dispatch.h"
+
+#include "crc64_intel_pclmul.h"
+
+#define CRC64_POLY 0xc96c5795d7870f42ULL
+
+static uint64_t crc64_tab[8][256];
+
+/* x^(2^n) mod P, used to skip zeros */
+static uint64_t crc64_x2n[64];
+
+/* In the reflected form the bit 63 is x^0 and the bit 0 is x^63, so
+ * multiplying by x is a right shift.
+ */
+static inline uint64_t crc64_mulx(uint64_t a) {
+    return (a >> 1) ^ ((a & 1) ? CRC64_POLY : 0);
+}
+
+static uint64_t crc64_mulmod(uint64_t a, uint64_t b) {
+    uint64_t m = 1ULL << 63;
+    uint64_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = crc64_mulx(b);
+    }
+    return p;
+}
+
+// x^n mod P
+static uint64_t crc64_xpow(uint64_t n) {
+    uint64_t p = 1ULL << 63;
+    for (int k = 0; n; n >>= 1, ++k) {
+        if (n & 1) {
+            p = crc64_mulmod(crc64_x2n[k & 63], p);
+        }
+    }
+    return p;
+}
+
+static void crc64_init(void) {
+    for (unsigned i = 0; i < 256; ++i) {
+        uint64_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = crc64_mulx(c);
+        }
+        crc64_tab[0][i] = c;
+    }
+    for (unsigned i = 0; i < 256; ++i) {
+        uint64_t c = crc64_tab[0][i];
+        for (int t = 1; t < 8; ++t) {
+            c = crc64_tab[0][c & 0xff] ^ (c >> 8);
+            crc64_tab[t][i] = c;
+        }
+    }
+
+    crc64_x2n[0] = 1ULL << 62;
+    for (int k = 1; k < 64; ++k) {
+        crc64_x2n[k] = crc64_mulmod(crc64_x2n[k - 1], crc64_x2n[k - 1]);
+    }
+
+#if defined(__x86_64__)
+    crc64_intel_fold_k[0] = crc64_xpow(512 + 63);
+    crc64_intel_fold_k[1] = crc64_xpow(512 - 1);
+    crc64_intel_fold_k[2] = crc64_xpow(128 + 63);
+    crc64_intel_fold_k[3] = crc64_xpow(128 - 1);
+#endif
+}
+
+uint64_t crc64_table(uint64_t crc, unsigned char const *p, unsigned len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc ^= v;
+        crc = crc64_tab[7][crc & 0xff] ^
+              crc64_tab[6][(crc >> 8) & 0xff] ^
+              crc64_tab[5][(crc >> 16) & 0xff] ^
+              crc64_tab[4][(crc >> 24) & 0xff] ^
+              crc64_tab[3][(crc >> 32) & 0xff] ^
+              crc64_tab[2][(crc >> 40) & 0xff] ^
+              crc64_tab[1][(crc >> 48) & 0xff] ^
+              crc64_tab[0][crc >> 56];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len--) {
+        crc = crc64_tab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint64_t crc64_zeros(uint64_t crc, uint64_t len) {
+    if (!crc) {
+        return 0;
+    }
+    return crc64_mulmod(crc64_xpow(len << 3), crc);
+}
+
+static int crc64_self_test(arch_fn_t ref, arch_fn_t fn) {
+    auto f0 = (crc64_func_t)ref;
+    auto f1 = (crc64_func_t)fn;
+    unsigned char buf[4096 + 16];
+    uint32_t x = 0x12345678;
+    for (auto& c : buf) {
+        x = x * 1103515245 + 12345;
+        c = x >> 16;
+    }
+    for (unsigned off = 0; off < 16; off += 5) {
+        for (unsigned len : {0, 1, 15, 16, 63, 64, 65, 127, 128, 200, 1000, 4096}) {
+            if (f0(~0ULL * len, buf + off, len) != f1(~0ULL * len, buf + off, len)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static const arch_kernel_variant crc64_variants[] = {
+    {ARCH_LEVEL_SCALAR, "table", (arch_fn_t)crc64_table, nullptr},
+#if defined(__x86_64__)
+    {ARCH_LEVEL_SSE42, "pclmul", (arch_fn_t)crc64_intel_pclmul, arch_has_pclmul},
+#endif
+};
+
+static arch_kernel crc64_kernel = {
+    "crc64", (arch_fn_t*)&crc64_func, crc64_variants,
+    ARCH_ARRAY_SIZE(crc64_variants), crc64_self_test, nullptr, nullptr,
+};
+
+/* choose best implementation based on the CPU architecture. */
+crc64_func_t choose_crc64(void) {
+    // the tables are needed by every implementation
+    static bool initialized = false;
+    if (!initialized) {
+        crc64_init();
+        initialized = true;
+    }
+
+    return (crc64_func_t)arch_kernel_register(&crc64_kernel);
+}
+
+crc64_func_t crc64_func = choose_crc64();
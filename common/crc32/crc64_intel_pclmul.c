@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdint.h>
+
+#include "crc32/crc64.h"
+#include "crc64_intel_pclmul.h"
+
+#ifdef __x86_64__
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+uint64_t crc64_intel_fold_k[4];
+
+/*
+ * A 16 bytes block B is H * x^64 + L, H is the first 8 bytes. Moving B
+ * forward by n bits keeps the crc of the message:
+ *     B * x^n = H * x^(n+64) + L * x^n    (mod P)
+ * The carry-less product of two reflected 64 bits values is one bit short
+ * of the reflected 128 bits form, so the constants are x^(n+63), x^(n-1).
+ */
+__attribute__((target("pclmul,sse2")))
+static inline __m128i fold(__m128i x, __m128i k) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                         _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+__attribute__((target("pclmul,sse2")))
+uint64_t crc64_intel_pclmul(uint64_t crc, unsigned char const *p,
+                            unsigned len) {
+    if (len < 64) {
+        return crc64_table(crc, p, len);
+    }
+
+    __m128i k64 = _mm_set_epi64x((long long)crc64_intel_fold_k[1],
+                                 (long long)crc64_intel_fold_k[0]);
+    __m128i k16 = _mm_set_epi64x((long long)crc64_intel_fold_k[3],
+                                 (long long)crc64_intel_fold_k[2]);
+
+    // the initial crc is the same as xor-ing it into the first 8 bytes
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((__m128i const *)p),
+                               _mm_cvtsi64_si128((long long)crc));
+    __m128i x1 = _mm_loadu_si128((__m128i const *)(p + 16));
+    __m128i x2 = _mm_loadu_si128((__m128i const *)(p + 32));
+    __m128i x3 = _mm_loadu_si128((__m128i const *)(p + 48));
+    p += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x0 = _mm_xor_si128(fold(x0, k64), _mm_loadu_si128((__m128i const *)p));
+        x1 = _mm_xor_si128(fold(x1, k64), _mm_loadu_si128((__m128i const *)(p + 16)));
+        x2 = _mm_xor_si128(fold(x2, k64), _mm_loadu_si128((__m128i const *)(p + 32)));
+        x3 = _mm_xor_si128(fold(x3, k64), _mm_loadu_si128((__m128i const *)(p + 48)));
+        p += 64;
+        len -= 64;
+    }
+
+    x0 = _mm_xor_si128(fold(x0, k16), x1);
+    x0 = _mm_xor_si128(fold(x0, k16), x2);
+    x0 = _mm_xor_si128(fold(x0, k16), x3);
+    while (len >= 16) {
+        x0 = _mm_xor_si128(fold(x0, k16), _mm_loadu_si128((__m128i const *)p));
+        p += 16;
+        len -= 16;
+    }
+
+    // the last 16 bytes block and the tail go to the table
+    unsigned char last[16];
+    _mm_storeu_si128((__m128i *)last, x0);
+    crc = crc64_table(0, last, sizeof(last));
+    return crc64_table(crc, p, len);
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef COMMON_CRC64_INTEL_PCLMUL_H
+#define COMMON_CRC64_INTEL_PCLMUL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifdef __x86_64__
+
+/* folding constants, filled by choose_crc64() before the kernel is used:
+ *   [0] x^(512+63) mod P    [1] x^(512-1) mod P    fold 64 bytes forward
+ *   [2] x^(128+63) mod P    [3] x^(128-1) mod P    fold 16 bytes forward
+ * all in reflected form
+ */
+extern uint64_t crc64_intel_fold_k[4];
+
+/* fold 16 bytes per carry-less multiply, 4 streams in parallel */
+extern uint64_t crc64_intel_pclmul(uint64_t crc,
+                                   unsigned char const *data,
+                                   unsigned length);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
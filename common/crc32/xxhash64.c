@@ -0,0 +1,189 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <string.h>
+
+#include "crc32/xxhash64.h"
+
+#define XXH_PRIME64_1 0x9e3779b185ebca87ULL
+#define XXH_PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define XXH_PRIME64_3 0x165667b19e3779f9ULL
+#define XXH_PRIME64_4 0x85ebca77c2b2ae63ULL
+#define XXH_PRIME64_5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(unsigned char const *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t read32(unsigned char const *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* The 4 lanes are independent multiply chains: the compiler keeps them in
+ * 4 registers and the multiplier pipeline overlaps them. There's no 64x64
+ * multiply below avx512dq, so a vector version doesn't pay on sse/avx2.
+ */
+static unsigned char const *xxh64_stripes(uint64_t v[4],
+                                          unsigned char const *p,
+                                          size_t length) {
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+    unsigned char const *const limit = p + length - 32;
+
+    do {
+        v1 = xxh64_round(v1, read64(p));
+        v2 = xxh64_round(v2, read64(p + 8));
+        v3 = xxh64_round(v3, read64(p + 16));
+        v4 = xxh64_round(v4, read64(p + 24));
+        p += 32;
+    } while (p <= limit);
+
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    v[3] = v4;
+    return p;
+}
+
+static uint64_t xxh64_finalize(uint64_t h, unsigned char const *p,
+                               size_t length) {
+    while (length >= 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+        length -= 8;
+    }
+    if (length >= 4) {
+        h ^= (uint64_t)read32(p) * XXH_PRIME64_1;
+        h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+        length -= 4;
+    }
+    while (length > 0) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+        length--;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t xxh64_converge(uint64_t const v[4]) {
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) +
+                 rotl64(v[2], 12) + rotl64(v[3], 18);
+    h = xxh64_merge_round(h, v[0]);
+    h = xxh64_merge_round(h, v[1]);
+    h = xxh64_merge_round(h, v[2]);
+    h = xxh64_merge_round(h, v[3]);
+    return h;
+}
+
+static void xxh64_init_lanes(uint64_t v[4], uint64_t seed) {
+    v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    v[1] = seed + XXH_PRIME64_2;
+    v[2] = seed;
+    v[3] = seed - XXH_PRIME64_1;
+}
+
+uint64_t spec_xxh64(uint64_t seed, void const *data, size_t length) {
+    unsigned char const *p = (unsigned char const *)data;
+    size_t left = length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v[4];
+        xxh64_init_lanes(v, seed);
+        unsigned char const *end = xxh64_stripes(v, p, length);
+        left = length - (size_t)(end - p);
+        p = end;
+        h = xxh64_converge(v);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+    h += (uint64_t)length;
+    return xxh64_finalize(h, p, left);
+}
+
+void spec_xxh64_reset(struct spec_xxh64_state *st, uint64_t seed) {
+    memset(st, 0, sizeof(*st));
+    st->seed = seed;
+    xxh64_init_lanes(st->v, seed);
+}
+
+void spec_xxh64_update(struct spec_xxh64_state *st,
+                       void const *data, size_t length) {
+    unsigned char const *p = (unsigned char const *)data;
+
+    st->total_len += length;
+
+    if (st->memsize + length < 32) {
+        memcpy(st->mem + st->memsize, p, length);
+        st->memsize += (unsigned)length;
+        return;
+    }
+
+    // complete the stripe left by the previous update
+    if (st->memsize) {
+        unsigned fill = 32 - st->memsize;
+        memcpy(st->mem + st->memsize, p, fill);
+        xxh64_stripes(st->v, st->mem, 32);
+        p += fill;
+        length -= fill;
+        st->memsize = 0;
+    }
+
+    if (length >= 32) {
+        unsigned char const *end = xxh64_stripes(st->v, p, length);
+        length -= (size_t)(end - p);
+        p = end;
+    }
+
+    if (length) {
+        memcpy(st->mem, p, length);
+        st->memsize = (unsigned)length;
+    }
+}
+
+uint64_t spec_xxh64_digest(struct spec_xxh64_state const *st) {
+    uint64_t h;
+
+    if (st->total_len >= 32) {
+        h = xxh64_converge(st->v);
+    } else {
+        h = st->seed + XXH_PRIME64_5;
+    }
+    h += st->total_len;
+    return xxh64_finalize(h, st->mem, st->memsize);
+}
@@ -9,15 +9,41 @@
 #include <sys/errno.h>
 #endif
 
+#include <stdint.h>
+#include <string.h>
+
+#include "arch/dispatch.h"
 #include "encode/armor.h"
+#include "armor_kernel.h"
 
-static int encode_bits(int c) {
 /*
  * base64 encode/decode.
  */
-    static const char *pem_key = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                 "abcdefghijklmnopqrstuvwxyz"
-                                 "0123456789+/";
+static const char pem_key[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                              "abcdefghijklmnopqrstuvwxyz"
+                              "0123456789+/";
+
+/* decode_bits of the bulk kernels: -1 for '=' and the invalid chars */
+static const signed char pem_val[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, 62, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static int encode_bits(int c) {
 	return pem_key[c];
 }
 
@@ -56,6 +82,147 @@ static int set_str_val(char **dst, const char *dst_end, char c)
 	return 0;
 }
 
+size_t armor_encode_generic(char *dst, size_t dst_len,
+                            const unsigned char *src, size_t src_len) {
+	size_t n = src_len / 3;
+	size_t i;
+
+	if (n > dst_len / 4) {
+		n = dst_len / 4;
+	}
+	for (i = 0; i < n; i++, src += 3, dst += 4) {
+		uint32_t v = (uint32_t)src[0] << 16 | (uint32_t)src[1] << 8 | src[2];
+		dst[0] = pem_key[v >> 18];
+		dst[1] = pem_key[(v >> 12) & 63];
+		dst[2] = pem_key[(v >> 6) & 63];
+		dst[3] = pem_key[v & 63];
+	}
+	return n * 3;
+}
+
+size_t armor_decode_generic(char *dst, size_t dst_len,
+                            const char *src, size_t src_len) {
+	size_t n = src_len / 4;
+	size_t i;
+
+	if (n > dst_len / 3) {
+		n = dst_len / 3;
+	}
+	for (i = 0; i < n; i++, src += 4, dst += 3) {
+		int a = pem_val[(unsigned char)src[0]];
+		int b = pem_val[(unsigned char)src[1]];
+		int c = pem_val[(unsigned char)src[2]];
+		int d = pem_val[(unsigned char)src[3]];
+		if ((a | b | c | d) < 0) {
+			break;
+		}
+		uint32_t v = a << 18 | b << 12 | c << 6 | d;
+		dst[0] = v >> 16;
+		dst[1] = v >> 8;
+		dst[2] = v;
+	}
+	return i * 4;
+}
+
+static int armor_encode_self_test(arch_fn_t ref, arch_fn_t fn) {
+	armor_encode_func_t f0 = (armor_encode_func_t)ref;
+	armor_encode_func_t f1 = (armor_encode_func_t)fn;
+	unsigned char src[300];
+	char out0[420], out1[420];
+	size_t i, len, room;
+	uint32_t seed = 1;
+
+	for (i = 0; i < sizeof(src); i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = seed >> 16;
+	}
+	for (len = 0; len <= sizeof(src); len += (len < 100 ? 1 : 23)) {
+		for (room = len * 4 / 3 + 4; room > 0; room = room > 37 ? room - 37 : 0) {
+			memset(out0, 0, sizeof(out0));
+			memset(out1, 0, sizeof(out1));
+			if (f0(out0, room, src, len) != f1(out1, room, src, len) ||
+			    memcmp(out0, out1, sizeof(out0))) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int armor_decode_self_test(arch_fn_t ref, arch_fn_t fn) {
+	armor_decode_func_t f0 = (armor_decode_func_t)ref;
+	armor_decode_func_t f1 = (armor_decode_func_t)fn;
+	static const char bad[] = {'=', '\n', '*', (char)0x80, '.', '`', '{', 0};
+	unsigned char raw[240];
+	char src[320], out0[240], out1[240];
+	size_t i, len, pos, room;
+	uint32_t seed = 7;
+
+	for (i = 0; i < sizeof(raw); i++) {
+		seed = seed * 1103515245 + 12345;
+		raw[i] = seed >> 16;
+	}
+	len = armor_encode_generic(src, sizeof(src), raw, sizeof(raw)) / 3 * 4;
+	// the url-safe chars
+	src[5] = '-';
+	src[70] = '_';
+	for (pos = 0; pos <= len; pos += 3) {
+		char saved = src[pos];
+		if (pos < len) {
+			src[pos] = bad[pos % sizeof(bad)];
+		}
+		for (room = sizeof(out0); room > 0; room = room > 53 ? room - 53 : 0) {
+			memset(out0, 0, sizeof(out0));
+			memset(out1, 0, sizeof(out1));
+			if (f0(out0, room, src, len) != f1(out1, room, src, len) ||
+			    memcmp(out0, out1, sizeof(out0))) {
+				src[pos] = saved;
+				return -1;
+			}
+		}
+		if (pos < len) {
+			src[pos] = saved;
+		}
+	}
+	return 0;
+}
+
+static const struct arch_kernel_variant armor_encode_variants[] = {
+	{ARCH_LEVEL_SCALAR, "generic", (arch_fn_t)armor_encode_generic, NULL},
+#ifdef __x86_64__
+	{ARCH_LEVEL_SSE42, "ssse3", (arch_fn_t)armor_encode_ssse3, arch_has_ssse3},
+	{ARCH_LEVEL_AVX2, "avx2", (arch_fn_t)armor_encode_avx2, NULL},
+#endif
+};
+
+static const struct arch_kernel_variant armor_decode_variants[] = {
+	{ARCH_LEVEL_SCALAR, "generic", (arch_fn_t)armor_decode_generic, NULL},
+#ifdef __x86_64__
+	{ARCH_LEVEL_SSE42, "ssse3", (arch_fn_t)armor_decode_ssse3, arch_has_ssse3},
+	{ARCH_LEVEL_AVX2, "avx2", (arch_fn_t)armor_decode_avx2, NULL},
+#endif
+};
+
+// usable before the constructor runs
+static armor_encode_func_t armor_encode_func = armor_encode_generic;
+static armor_decode_func_t armor_decode_func = armor_decode_generic;
+
+static struct arch_kernel armor_encode_kernel = {
+	"armor_encode", (arch_fn_t *)&armor_encode_func, armor_encode_variants,
+	ARCH_ARRAY_SIZE(armor_encode_variants), armor_encode_self_test, NULL, NULL,
+};
+
+static struct arch_kernel armor_decode_kernel = {
+	"armor_decode", (arch_fn_t *)&armor_decode_func, armor_decode_variants,
+	ARCH_ARRAY_SIZE(armor_decode_variants), armor_decode_self_test, NULL, NULL,
+};
+
+__attribute__((constructor))
+static void armor_kernels_init(void) {
+	arch_kernel_register(&armor_encode_kernel);
+	arch_kernel_register(&armor_decode_kernel);
+}
+
 uint64_t spec_armor_line_break(char *dst, const char *dst_end,
                                const char *src, const char *src_end,
                                int line_width) {
@@ -69,6 +236,29 @@ uint64_t spec_armor_line_break(char *dst, const char *dst_end,
 
 	while (src < src_end) {
 		unsigned char a;
+		size_t n = src_end - src;
+
+		// the bulk kernel stops at the line end, if there's any
+		if (line_width > 0 && (line_width & 3) == 0) {
+			size_t line_left = (line_width - track_line) / 4 * 3;
+			if (n > line_left) {
+				n = line_left;
+			}
+		}
+		n = armor_encode_func(dst, dst < dst_end ? dst_end - dst : 0,
+		                      (const unsigned char *)src, n);
+		if (n) {
+			src += n;
+			dst += n / 3 * 4;
+			out_len += n / 3 * 4;
+			track_line += n / 3 * 4;
+			if (line_width && track_line == line_width) {
+				track_line = 0;
+				SET_DST('\n');
+				out_len++;
+			}
+			continue;
+		}
 
 		a = *src++;
 		SET_DST(encode_bits(a >> 2));
@@ -113,6 +303,18 @@ int64_t spec_unarmor(char *dst, const char *dst_end,
 
 	while (src < src_end) {
 		int a, b, c, d;
+		size_t n;
+
+		n = armor_decode_func(dst, dst < dst_end ? dst_end - dst : 0,
+		                      src, src_end - src);
+		if (n) {
+			src += n;
+			dst += n / 4 * 3;
+			out_len += n / 4 * 3;
+			if (src == src_end) {
+				break;
+			}
+		}
 
 		if (src[0] == '\n') {
 			src++;
@@ -0,0 +1,219 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifdef __x86_64__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "armor_kernel.h"
+
+/*
+ * base64 with pshufb, see Wojciech Mula and Daniel Lemire,
+ * "Faster Base64 Encoding and Decoding using AVX2 Instructions".
+ *
+ * encode: 3 bytes are spread into 4 bytes of 6 bits by one shuffle and two
+ * 16-bit multiplies, the 6-bit value is mapped to ascii by adding an offset
+ * looked up by its range.
+ * decode: the char is valid if lut_lo[low nibble] & lut_hi[high nibble] != 0,
+ * its value is char + offset where the offset is looked up by the high
+ * nibble, '+', '-', '/' share the high nibble 2 and '_' is the only one in
+ * 'P'..'_' which isn't a letter, they are fixed afterwards.
+ */
+
+#define ARMOR_LUT_ENC_SHUF \
+    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+#define ARMOR_LUT_ENC_SHIFT \
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+#define ARMOR_LUT_DEC_LO \
+    0x2a, 0x3e, 0x3e, 0x3e, 0x3e, 0x3e, 0x3e, 0x3e, \
+    0x3e, 0x3e, 0x3c, 0x15, 0x14, 0x15, 0x14, 0x1d
+#define ARMOR_LUT_DEC_HI \
+    0, 0, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0, 0, 0, 0, 0, 0, 0, 0
+#define ARMOR_LUT_DEC_OFF_HI \
+    0, 0, 0, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+#define ARMOR_LUT_DEC_OFF_SYM \
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 19, 0, 17, 0, 16
+#define ARMOR_LUT_DEC_PACK \
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+__attribute__((target("ssse3")))
+static inline __m128i armor_enc_ssse3(__m128i in) {
+    // [b1 b0 b2 b1] for each 3 bytes
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(ARMOR_LUT_ENC_SHUF));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                                 _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                                 _mm_set1_epi32(0x01000010));
+    __m128i idx = _mm_or_si128(t0, t1);
+
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+    r = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+    r = _mm_shuffle_epi8(_mm_setr_epi8(ARMOR_LUT_ENC_SHIFT), r);
+    return _mm_add_epi8(r, idx);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i armor_enc_avx2(__m256i in) {
+    in = _mm256_shuffle_epi8(in,
+            _mm256_broadcastsi128_si256(_mm_set_epi8(ARMOR_LUT_ENC_SHUF)));
+    __m256i t0 = _mm256_mulhi_epu16(
+            _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+            _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(
+            _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+            _mm256_set1_epi32(0x01000010));
+    __m256i idx = _mm256_or_si256(t0, t1);
+
+    __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+    r = _mm256_or_si256(r, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    r = _mm256_shuffle_epi8(
+            _mm256_broadcastsi128_si256(_mm_setr_epi8(ARMOR_LUT_ENC_SHIFT)), r);
+    return _mm256_add_epi8(r, idx);
+}
+
+// return 0 if any char isn't in the alphabet
+__attribute__((target("ssse3")))
+static inline int armor_dec_ssse3(__m128i in, __m128i *out) {
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+    __m128i lo = _mm_and_si128(in, mask);
+
+    __m128i valid = _mm_and_si128(
+            _mm_shuffle_epi8(_mm_setr_epi8(ARMOR_LUT_DEC_LO), lo),
+            _mm_shuffle_epi8(_mm_setr_epi8(ARMOR_LUT_DEC_HI), hi));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128()))) {
+        return 0;
+    }
+
+    __m128i off = _mm_shuffle_epi8(_mm_setr_epi8(ARMOR_LUT_DEC_OFF_HI), hi);
+    __m128i sym = _mm_cmpeq_epi8(hi, _mm_set1_epi8(2));
+    off = _mm_or_si128(off, _mm_and_si128(sym,
+            _mm_shuffle_epi8(_mm_setr_epi8(ARMOR_LUT_DEC_OFF_SYM), lo)));
+    __m128i us = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+    off = _mm_or_si128(_mm_andnot_si128(us, off),
+                       _mm_and_si128(us, _mm_set1_epi8(-32)));
+    __m128i v = _mm_add_epi8(in, off);
+
+    // [a b c d] -> a << 18 | b << 12 | c << 6 | d, then 3 bytes big-endian
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    *out = _mm_shuffle_epi8(v, _mm_setr_epi8(ARMOR_LUT_DEC_PACK));
+    return 1;
+}
+
+__attribute__((target("avx2")))
+static inline int armor_dec_avx2(__m256i in, __m256i *out) {
+    __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask);
+    __m256i lo = _mm256_and_si256(in, mask);
+
+    __m256i valid = _mm256_and_si256(
+            _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+                    _mm_setr_epi8(ARMOR_LUT_DEC_LO)), lo),
+            _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+                    _mm_setr_epi8(ARMOR_LUT_DEC_HI)), hi));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256()))) {
+        return 0;
+    }
+
+    __m256i off = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+            _mm_setr_epi8(ARMOR_LUT_DEC_OFF_HI)), hi);
+    __m256i sym = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(2));
+    off = _mm256_or_si256(off, _mm256_and_si256(sym,
+            _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+                    _mm_setr_epi8(ARMOR_LUT_DEC_OFF_SYM)), lo)));
+    off = _mm256_blendv_epi8(off, _mm256_set1_epi8(-32),
+                             _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_')));
+    __m256i v = _mm256_add_epi8(in, off);
+
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+    v = _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(ARMOR_LUT_DEC_PACK)));
+    // 12 bytes of each lane into the low 24 bytes
+    *out = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    return 1;
+}
+
+__attribute__((target("ssse3")))
+size_t armor_encode_ssse3(char *dst, size_t dst_len,
+                          const unsigned char *src, size_t src_len) {
+    size_t in = 0, out = 0;
+
+    // 12 bytes to 16 chars, the load reads 16 bytes
+    while (src_len - in >= 16 && dst_len - out >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + in));
+        _mm_storeu_si128((__m128i *)(dst + out), armor_enc_ssse3(v));
+        in += 12;
+        out += 16;
+    }
+    return in + armor_encode_generic(dst + out, dst_len - out,
+                                     src + in, src_len - in);
+}
+
+__attribute__((target("avx2")))
+size_t armor_encode_avx2(char *dst, size_t dst_len,
+                         const unsigned char *src, size_t src_len) {
+    size_t in = 0, out = 0;
+
+    // 24 bytes to 32 chars, the 2nd load reads src[12, 28)
+    while (src_len - in >= 28 && dst_len - out >= 32) {
+        __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + in))),
+                _mm_loadu_si128((const __m128i *)(src + in + 12)), 1);
+        _mm256_storeu_si256((__m256i *)(dst + out), armor_enc_avx2(v));
+        in += 24;
+        out += 32;
+    }
+    return in + armor_encode_ssse3(dst + out, dst_len - out,
+                                   src + in, src_len - in);
+}
+
+__attribute__((target("ssse3")))
+size_t armor_decode_ssse3(char *dst, size_t dst_len,
+                          const char *src, size_t src_len) {
+    size_t in = 0, out = 0;
+    __m128i v;
+
+    // 16 chars to 12 bytes, never write beyond them
+    while (src_len - in >= 16 && dst_len - out >= 12 &&
+           armor_dec_ssse3(_mm_loadu_si128((const __m128i *)(src + in)), &v)) {
+        uint32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        _mm_storel_epi64((__m128i *)(dst + out), v);
+        memcpy(dst + out + 8, &tail, 4);
+        in += 16;
+        out += 12;
+    }
+    return in + armor_decode_generic(dst + out, dst_len - out,
+                                     src + in, src_len - in);
+}
+
+__attribute__((target("avx2")))
+size_t armor_decode_avx2(char *dst, size_t dst_len,
+                         const char *src, size_t src_len) {
+    size_t in = 0, out = 0;
+    __m256i v;
+
+    // 32 chars to 24 bytes
+    while (src_len - in >= 32 && dst_len - out >= 24 &&
+           armor_dec_avx2(_mm256_loadu_si256((const __m256i *)(src + in)), &v)) {
+        _mm_storeu_si128((__m128i *)(dst + out), _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i *)(dst + out + 16),
+                         _mm256_extracti128_si256(v, 1));
+        in += 32;
+        out += 24;
+    }
+    return in + armor_decode_ssse3(dst + out, dst_len - out,
+                                   src + in, src_len - in);
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_ARMOR_KERNEL_H
+#define SPEC_ARMOR_KERNEL_H
+
+#include <stddef.h>
+
+/* Bulk kernels of spec_armor/spec_unarmor, spec_armor* only handles the
+ * line breaks, the padding and the errors after them.
+ *
+ * encode: encode the whole 3-byte groups of src as long as dst has room
+ *         for them, return the number of consumed source bytes.
+ * decode: decode the leading 4-char groups which only have the alphabet
+ *         chars('+', '-', '/', '_' included), as long as dst has room for
+ *         them. Stop at the first group with '=', '\n' or an invalid char.
+ *         return the number of consumed source chars.
+ * All the variants consume the same bytes and write the same output.
+ */
+typedef size_t (*armor_encode_func_t)(char *dst, size_t dst_len,
+                                      const unsigned char *src, size_t src_len);
+typedef size_t (*armor_decode_func_t)(char *dst, size_t dst_len,
+                                      const char *src, size_t src_len);
+
+extern size_t armor_encode_generic(char *dst, size_t dst_len,
+                                   const unsigned char *src, size_t src_len);
+extern size_t armor_decode_generic(char *dst, size_t dst_len,
+                                   const char *src, size_t src_len);
+
+#ifdef __x86_64__
+extern size_t armor_encode_ssse3(char *dst, size_t dst_len,
+                                 const unsigned char *src, size_t src_len);
+extern size_t armor_decode_ssse3(char *dst, size_t dst_len,
+                                 const char *src, size_t src_len);
+extern size_t armor_encode_avx2(char *dst, size_t dst_len,
+                                const unsigned char *src, size_t src_len);
+extern size_t armor_decode_avx2(char *dst, size_t dst_len,
+                                const char *src, size_t src_len);
+#endif
+
+#endif //SPEC_ARMOR_KERNEL_H
@@ -64,4 +64,31 @@ void BackTrace::print(std::ostream& os) const {
     }
 }
 
+std::string BackTrace::function_name(size_t i) const {
+    if (i >= size || !strings) {
+        return std::string();
+    }
+
+    const char *begin = strrchr(strings[i], '(');
+    const char *end = begin ? strchr(begin, '+') : nullptr;
+    if (!begin || !end || end == begin + 1) {
+        // no symbol in this frame e.g. "./a.out() [0x401a2b]"
+        return std::string();
+    }
+
+    std::string mangled(begin + 1, end - begin - 1);
+    if (mangled[0] != '_' || mangled[1] != 'Z') {
+        return mangled;
+    }
+
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (!demangled) {
+        return mangled;
+    }
+    std::string name(demangled);
+    free(demangled);
+    return name;
+}
+
 } //namespace: spec
@@ -0,0 +1,183 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include "error_info/errno.h"
+#include "safe_io.h"
+#include "stats/admin_socket.h"
+
+namespace spec {
+
+namespace stats {
+
+// the time a client has to send its command, and to take the reply
+static constexpr int client_timeout_ms = 5000;
+
+int admin_socket::start(const std::string& path) {
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return -ENAMETOOLONG;
+    }
+    if (m_listen_fd >= 0) {
+        return -EBUSY;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // remove the stale socket left by the dead process
+    ::unlink(path.c_str());
+    if (::bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        ::listen(fd, 16) < 0) {
+        int r = -errno;
+        ::close(fd);
+        return r;
+    }
+
+    if (::pipe2(m_shutdown_fd, O_CLOEXEC) < 0) {
+        int r = -errno;
+        ::close(fd);
+        ::unlink(path.c_str());
+        return r;
+    }
+
+    m_listen_fd = fd;
+    m_path = path;
+    m_thread = std::thread(&admin_socket::entry, this);
+    return 0;
+}
+
+void admin_socket::stop() {
+    if (m_listen_fd < 0) {
+        return;
+    }
+
+    char c = 0;
+    int r = safe_write(m_shutdown_fd[1], &c, 1);
+    if (r < 0) {
+        std::cerr << "admin_socket::stop(" << m_path << "): "
+                  << "failed to wake up the thread: " << cpp_strerror(r)
+                  << std::endl;
+    }
+    // the thread sees the pipe hung up even if the write failed
+    ::close(m_shutdown_fd[1]);
+    m_thread.join();
+
+    ::close(m_shutdown_fd[0]);
+    ::close(m_listen_fd);
+    ::unlink(m_path.c_str());
+    m_shutdown_fd[0] = m_shutdown_fd[1] = -1;
+    m_listen_fd = -1;
+}
+
+void admin_socket::entry() {
+    for (;;) {
+        struct pollfd fds[2] = {
+            {m_listen_fd, POLLIN, 0},
+            {m_shutdown_fd[0], POLLIN, 0},
+        };
+        int r = ::poll(fds, 2, -1);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                handle(fd);
+                ::close(fd);
+            }
+        }
+    }
+}
+
+void admin_socket::handle(int fd) {
+    /* One command line, stop reading at '\n', EOF, the timeout or stop().
+     * The only thread serves one client at a time, so a silent client
+     * mustn't hold it.
+     */
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(client_timeout_ms);
+    std::string cmd;
+    while (cmd.size() < 256) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            return;
+        }
+        struct pollfd fds[2] = {
+            {fd, POLLIN, 0},
+            {m_shutdown_fd[0], POLLIN, 0},
+        };
+        int r = ::poll(fds, 2, left);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0 || fds[1].revents) {
+            return;
+        }
+        char buf[256];
+        ssize_t n = ::read(fd, buf, sizeof(buf) - cmd.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        // the rest after the '\n' is dropped with the connection
+        char *nl = (char*)memchr(buf, '\n', n);
+        cmd.append(buf, nl ? nl - buf : n);
+        if (nl) {
+            break;
+        }
+    }
+    while (!cmd.empty() && (cmd.back() == '\r' || cmd.back() == ' ')) {
+        cmd.pop_back();
+    }
+
+    std::string reply;
+    if (cmd == "stats json") {
+        std::ostringstream ss;
+        m_registry.dump_json(ss);
+        reply = ss.str();
+    } else if (cmd == "stats binary") {
+        m_registry.dump_binary(reply);
+    } else {
+        reply = "unknown command \"" + cmd + "\", "
+                "supported: \"stats json\", \"stats binary\"\n";
+    }
+
+    // give up the client which doesn't read, nothing to do if it's gone
+    struct timeval tv = {client_timeout_ms / 1000, (client_timeout_ms % 1000) * 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    ssize_t r = safe_write(fd, reply.data(), reply.size());
+    (void)r;
+}
+
+} //namespace: stats
+
+} //namespace: spec
@@ -0,0 +1,242 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <math.h>
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+#include "clock/spec_clock.h"
+#include "stats/histogram.h"
+#include "stats/stats_registry.h"
+
+namespace spec {
+
+namespace stats {
+
+void histogram_snapshot::add(uint64_t v, uint64_t n) {
+    if (!n) {
+        return;
+    }
+    buckets[bucket_of(v)] += n;
+    count += n;
+    sum += v * n;
+    min = std::min(min, v);
+    max = std::max(max, v);
+}
+
+void histogram_snapshot::merge(const histogram_snapshot& other) {
+    for (unsigned b = 0; b < num_buckets; ++b) {
+        buckets[b] += other.buckets[b];
+    }
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+uint64_t histogram_snapshot::percentile(double p) const {
+    if (!count) {
+        return 0;
+    }
+    p = std::min(std::max(p, 0.0), 100.0);
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)ceil(p / 100.0 * count));
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < num_buckets; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return std::min(bucket_high(b), max);
+        }
+    }
+    return max;
+}
+
+/* Only the owner thread writes a shard, so record() loads and stores the
+ * counters without RMW. They are atomic to be read by the snapshots.
+ */
+struct alignas(64) histogram::shard {
+    shard *next = nullptr;      // set before the shard is published
+    std::atomic<bool> in_use{true};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> min{UINT64_MAX};
+    std::atomic<uint64_t> max{0};
+    std::atomic<uint64_t> buckets[histogram_snapshot::num_buckets] = {};
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t v) {
+        bump(buckets[histogram_snapshot::bucket_of(v)], 1);
+        bump(sum, v);
+        if (v < min.load(std::memory_order_relaxed)) {
+            min.store(v, std::memory_order_relaxed);
+        }
+        if (v > max.load(std::memory_order_relaxed)) {
+            max.store(v, std::memory_order_relaxed);
+        }
+    }
+
+    void merge_into(histogram_snapshot& snap) const {
+        uint64_t n = 0;
+        for (unsigned b = 0; b < histogram_snapshot::num_buckets; ++b) {
+            uint64_t c = buckets[b].load(std::memory_order_relaxed);
+            snap.buckets[b] += c;
+            n += c;
+        }
+        snap.count += n;
+        snap.sum += sum.load(std::memory_order_relaxed);
+        snap.min = std::min(snap.min, min.load(std::memory_order_relaxed));
+        snap.max = std::max(snap.max, max.load(std::memory_order_relaxed));
+    }
+
+    void reset() {
+        for (auto& b : buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        sum.store(0, std::memory_order_relaxed);
+        min.store(UINT64_MAX, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+};
+
+namespace {
+
+// the live histograms, so an exiting thread only touches the live shards
+std::mutex live_lock;
+std::set<uint64_t> live_ids;
+std::atomic<uint64_t> next_id{0};
+
+struct thread_cache {
+    std::vector<std::pair<uint64_t, histogram::shard*>> shards;
+
+    ~thread_cache() {
+        std::lock_guard lk(live_lock);
+        for (auto& s : shards) {
+            if (live_ids.count(s.first)) {
+                s.second->in_use.store(false, std::memory_order_release);
+            }
+        }
+    }
+};
+
+thread_local thread_cache tl_cache;
+
+// calibrate the TSC at load time, not in the first latency_timer
+const spec_tsc_calibration& tsc_calibration = spec_tsc_calibration::get();
+
+} //namespace
+
+histogram::histogram() : histogram(std::string()) {
+}
+
+histogram::histogram(const std::string& name)
+    : m_id(next_id.fetch_add(1, std::memory_order_relaxed)), m_name(name) {
+    {
+        std::lock_guard lk(live_lock);
+        live_ids.insert(m_id);
+    }
+    if (m_name.empty()) {
+        return;
+    }
+    auto& r = registry::instance();
+    m_gauges.push_back(r.add_gauge(m_name + ".count", [this] {
+        return snapshot().count;
+    }));
+    m_gauges.push_back(r.add_gauge(m_name + ".p50", [this] {
+        return snapshot().percentile(50);
+    }));
+    m_gauges.push_back(r.add_gauge(m_name + ".p99", [this] {
+        return snapshot().percentile(99);
+    }));
+    m_gauges.push_back(r.add_gauge(m_name + ".p999", [this] {
+        return snapshot().percentile(99.9);
+    }));
+    m_gauges.push_back(r.add_gauge(m_name + ".max", [this] {
+        return snapshot().max;
+    }));
+}
+
+histogram::~histogram() {
+    for (uint64_t id : m_gauges) {
+        registry::instance().remove_gauge(id);
+    }
+    {
+        std::lock_guard lk(live_lock);
+        live_ids.erase(m_id);
+    }
+    shard *s = m_shards.load(std::memory_order_acquire);
+    while (s) {
+        shard *next = s->next;
+        delete s;
+        s = next;
+    }
+}
+
+histogram::shard* histogram::attach() {
+    // reuse the shard of an exited thread, or push a new one
+    shard *s = m_shards.load(std::memory_order_acquire);
+    for (; s; s = s->next) {
+        bool expected = false;
+        if (s->in_use.compare_exchange_strong(expected, true,
+                                              std::memory_order_acquire)) {
+            break;
+        }
+    }
+    if (!s) {
+        s = new shard;
+        s->next = m_shards.load(std::memory_order_relaxed);
+        while (!m_shards.compare_exchange_weak(s->next, s,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+    // drop the shards of the destroyed histograms
+    auto& cache = tl_cache.shards;
+    {
+        std::lock_guard lk(live_lock);
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [](const auto& c) {
+            return !live_ids.count(c.first);
+        }), cache.end());
+    }
+    cache.emplace_back(m_id, s);
+    return s;
+}
+
+histogram::shard* histogram::local_shard() {
+    for (auto& s : tl_cache.shards) {
+        if (s.first == m_id) {
+            return s.second;
+        }
+    }
+    return attach();
+}
+
+void histogram::record(uint64_t v) {
+    local_shard()->record(v);
+}
+
+void histogram::merge_into(histogram_snapshot& snap) const {
+    for (shard *s = m_shards.load(std::memory_order_acquire); s; s = s->next) {
+        s->merge_into(snap);
+    }
+}
+
+histogram_snapshot histogram::snapshot() const {
+    histogram_snapshot snap;
+    merge_into(snap);
+    return snap;
+}
+
+void histogram::reset() {
+    for (shard *s = m_shards.load(std::memory_order_acquire); s; s = s->next) {
+        s->reset();
+    }
+}
+
+} //namespace: stats
+
+} //namespace: spec
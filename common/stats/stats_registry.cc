@@ -0,0 +1,177 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <string.h>
+
+#include <ostream>
+
+#include "buffer/buffer_audit.h"
+#include "clock/spec_clock.h"
+#include "demangle.h"
+#include "mempool/mempool.h"
+#include "stats/stats_registry.h"
+
+namespace spec {
+
+namespace stats {
+
+static const char stats_magic[8] = {'S', 'P', 'E', 'C', 'S', 'T', 'A', 'T'};
+static const uint32_t stats_version = 1;
+
+registry& registry::instance() {
+    // never destroyed: gauges may be removed during static destruction
+    static registry *r = new registry;
+    return *r;
+}
+
+uint64_t registry::add_gauge(const std::string& name, gauge_fn fn) {
+    std::lock_guard lk(lock);
+    uint64_t id = next_id++;
+    gauges.emplace(id, std::make_pair(name, std::move(fn)));
+    return id;
+}
+
+void registry::remove_gauge(uint64_t id) {
+    std::lock_guard lk(lock);
+    gauges.erase(id);
+}
+
+stat_list_t registry::snapshot() const {
+    stat_list_t stats;
+
+    for (int i = 0; i < mempool::num_pools; ++i) {
+        auto id = (mempool::pool_type_id)i;
+        auto& pool = mempool::get_pool(id);
+        std::string prefix = std::string("mempool.") + mempool::get_pool_name(id);
+        stats.emplace_back(prefix + ".bytes", pool.allocated_bytes());
+        stats.emplace_back(prefix + ".items", pool.allocated_items());
+
+        std::vector<std::pair<const char*, ssize_t>> types;
+        pool.get_type_items(types);
+        for (const auto& t : types) {
+            stats.emplace_back(prefix + ".type." + spec_demangle(t.first) + ".items",
+                               t.second > 0 ? t.second : 0);
+        }
+    }
+
+    stats.emplace_back("buffer.crc.cached", buffer::get_cached_crc());
+    stats.emplace_back("buffer.crc.cached_adjusted",
+                       buffer::get_cached_crc_adjusted());
+    stats.emplace_back("buffer.crc.missed", buffer::get_missed_crc());
+
+    std::lock_guard lk(lock);
+    for (const auto& g : gauges) {
+        stats.emplace_back(g.second.first, g.second.second());
+    }
+    return stats;
+}
+
+static void json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void registry::dump_json(std::ostream& out) const {
+    uint64_t timestamp = spec_clock_now().to_nsec();
+    stat_list_t stats = snapshot();
+
+    out << "{\"version\": " << stats_version
+        << ", \"timestamp\": " << timestamp
+        << ", \"stats\": {";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (i) {
+            out << ", ";
+        }
+        json_string(out, stats[i].first);
+        out << ": " << stats[i].second;
+    }
+    out << "}}\n";
+}
+
+void registry::dump_binary(std::string& out) const {
+    encode_binary(snapshot(), spec_clock_now().to_nsec(), out);
+}
+
+template <typename T>
+static void put_le(std::string& out, T v) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back((char)(v >> (8 * i)));
+    }
+}
+
+template <typename T>
+static bool get_le(const std::string& in, size_t& pos, T& v) {
+    if (in.size() - pos < sizeof(T)) {
+        return false;
+    }
+    v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        v |= (T)(unsigned char)in[pos + i] << (8 * i);
+    }
+    pos += sizeof(T);
+    return true;
+}
+
+void encode_binary(const stat_list_t& stats, uint64_t timestamp,
+                   std::string& out) {
+    out.clear();
+    out.append(stats_magic, sizeof(stats_magic));
+    put_le<uint32_t>(out, stats_version);
+    put_le<uint32_t>(out, stats.size());
+    put_le<uint64_t>(out, timestamp);
+    for (const auto& s : stats) {
+        uint16_t len = s.first.size() > UINT16_MAX ? UINT16_MAX : s.first.size();
+        put_le<uint16_t>(out, len);
+        out.append(s.first, 0, len);
+        put_le<uint64_t>(out, s.second);
+    }
+}
+
+bool decode_binary(const std::string& in, stat_list_t& stats,
+                   uint64_t *timestamp) {
+    size_t pos = sizeof(stats_magic);
+    if (in.size() < pos || memcmp(in.data(), stats_magic, pos)) {
+        return false;
+    }
+
+    uint32_t version, count;
+    uint64_t ts;
+    if (!get_le(in, pos, version) || version != stats_version ||
+        !get_le(in, pos, count) || !get_le(in, pos, ts)) {
+        return false;
+    }
+
+    stats.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint16_t len;
+        uint64_t value;
+        if (!get_le(in, pos, len) || in.size() - pos < len) {
+            return false;
+        }
+        std::string name = in.substr(pos, len);
+        pos += len;
+        if (!get_le(in, pos, value)) {
+            return false;
+        }
+        stats.emplace_back(std::move(name), value);
+    }
+    if (timestamp) {
+        *timestamp = ts;
+    }
+    return true;
+}
+
+} //namespace: stats
+
+} //namespace: spec
@@ -0,0 +1,400 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "safe_io.h"
+#include "trace/trace.h"
+
+namespace spec {
+
+namespace trace {
+
+static const char trace_magic[8] = {'S', 'P', 'E', 'C', 'T', 'R', 'C', '1'};
+
+std::atomic<bool> tracer::s_on{false};
+
+ring::ring(uint64_t size, uint32_t t)
+    : m_buf(new char[size]), m_mask(size - 1), tid(t) {
+}
+
+void ring::drain(uint64_t head, std::string& out) {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t len = head - tail;
+    uint64_t off = tail & m_mask;
+    uint64_t first = std::min(len, size() - off);
+    out.append(m_buf.get() + off, first);
+    out.append(m_buf.get(), len - first);
+    m_tail.store(head, std::memory_order_release);
+}
+
+namespace {
+
+// hands the ring over to the tracer thread when the thread exits
+struct ring_holder {
+    std::shared_ptr<ring> r;
+
+    ~ring_holder() {
+        if (r) {
+            r->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ring_holder tl_ring;
+
+// calibrate the TSC at load time, not in the first emit()
+const spec_tsc_calibration& tsc_calibration = spec_tsc_calibration::get();
+
+template <typename T>
+void put(std::string& out, const T& v) {
+    out.append((const char*)&v, sizeof(v));
+}
+
+void put_record(std::string& out, uint32_t type, const std::string& payload) {
+    put(out, type);
+    put(out, (uint32_t)payload.size());
+    out.append(payload);
+}
+
+template <typename T>
+bool get(const std::string& in, size_t& pos, T *v) {
+    if (in.size() - pos < sizeof(T)) {
+        return false;
+    }
+    memcpy(v, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+} //namespace
+
+void push_record(const void *rec, uint64_t len) {
+    ring *r = tl_ring.r.get();
+    if (unlikely(!r)) {
+        tl_ring.r = tracer::instance().new_ring();
+        r = tl_ring.r.get();
+    }
+    r->push(rec, len);
+}
+
+tracer& tracer::instance() {
+    // never destroyed: the threads may trace during static destruction
+    static tracer *t = new tracer;
+    return *t;
+}
+
+uint16_t tracer::register_event(const char *name, const char *fmt, const char *sig) {
+    std::lock_guard lk(m_lock);
+    m_events.push_back(event_def{name, fmt, sig});
+    return m_events.size() - 1;
+}
+
+std::shared_ptr<ring> tracer::new_ring() {
+    std::lock_guard lk(m_lock);
+    auto r = std::make_shared<ring>(m_ring_size, (uint32_t)syscall(SYS_gettid));
+    m_rings.push_back(r);
+    return r;
+}
+
+int tracer::start(const std::string& path, uint64_t ring_size, uint64_t interval_ms) {
+    if (!ring_size || (ring_size & (ring_size - 1))) {
+        return -EINVAL;
+    }
+    std::unique_lock lk(m_lock);
+    if (m_fd >= 0) {
+        return -EBUSY;
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    const spec_tsc_calibration& cal = spec_tsc_calibration::get();
+    std::string hdr(trace_magic, sizeof(trace_magic));
+    if (cal.invariant) {
+        put(hdr, cal.mult);
+        put(hdr, cal.base_cycles);
+        put(hdr, cal.base_ns);
+    } else {
+        // the cycles are ns
+        put(hdr, (uint64_t)1 << 32);
+        put(hdr, (uint64_t)0);
+        put(hdr, (uint64_t)0);
+    }
+    int r = safe_write(fd, hdr.data(), hdr.size());
+    if (r < 0) {
+        ::close(fd);
+        return r;
+    }
+
+    m_fd = fd;
+    m_ring_size = ring_size;
+    m_interval_ms = interval_ms;
+    m_events_written = 0;
+    m_stopping = false;
+    // the leftovers of the last run
+    for (auto& ring : m_rings) {
+        ring->discard(ring->head());
+        ring->reported_dropped = ring->dropped();
+    }
+    m_thread = std::thread(&tracer::entry, this);
+    s_on.store(true, std::memory_order_release);
+    return 0;
+}
+
+void tracer::stop() {
+    {
+        std::lock_guard lk(m_lock);
+        if (m_fd < 0) {
+            return;
+        }
+        s_on.store(false, std::memory_order_release);
+        m_stopping = true;
+        m_cond.notify_all();
+    }
+    m_thread.join();
+
+    std::lock_guard lk(m_lock);
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+uint64_t tracer::dropped() {
+    std::lock_guard lk(m_lock);
+    uint64_t n = m_dropped_exited;
+    for (auto& r : m_rings) {
+        n += r->dropped();
+    }
+    return n;
+}
+
+std::vector<event_def> tracer::events() {
+    std::lock_guard lk(m_lock);
+    return m_events;
+}
+
+void tracer::drain(std::unique_lock<std::mutex>& lk) {
+    /* The heads first: a record is pushed after its event is registered,
+     * so every event of the records up to the heads is defined below.
+     */
+    std::vector<uint64_t> heads;
+    for (auto& r : m_rings) {
+        heads.push_back(r->head());
+    }
+
+    std::string out;
+    for (; m_events_written < m_events.size(); ++m_events_written) {
+        const event_def& e = m_events[m_events_written];
+        std::string payload;
+        put(payload, (uint16_t)m_events_written);
+        put(payload, (uint16_t)e.sig.size());
+        put(payload, (uint16_t)e.name.size());
+        put(payload, (uint16_t)e.fmt.size());
+        payload.append(e.name);
+        payload.append(e.fmt);
+        payload.append(e.sig);
+        put_record(out, RECORD_EVENT_DEF, payload);
+    }
+
+    for (size_t i = 0; i < heads.size(); ++i) {
+        ring& r = *m_rings[i];
+        std::string payload;
+        put(payload, r.tid);
+        put(payload, (uint32_t)0);
+        size_t before = payload.size();
+        r.drain(heads[i], payload);
+        if (payload.size() > before) {
+            put_record(out, RECORD_EVENTS, payload);
+        }
+        uint64_t dropped = r.dropped();
+        if (dropped != r.reported_dropped) {
+            std::string d;
+            put(d, r.tid);
+            put(d, (uint32_t)0);
+            put(d, dropped - r.reported_dropped);
+            put_record(out, RECORD_DROPPED, d);
+            r.reported_dropped = dropped;
+        }
+    }
+
+    // the exited threads won't push anymore, once they are drained
+    size_t kept = 0;
+    for (size_t i = 0; i < m_rings.size(); ++i) {
+        ring& r = *m_rings[i];
+        if (r.exited.load(std::memory_order_acquire) && r.head() == heads[i]) {
+            m_dropped_exited += r.dropped();
+            continue;
+        }
+        m_rings[kept++] = std::move(m_rings[i]);
+    }
+    m_rings.resize(kept);
+
+    if (out.empty()) {
+        return;
+    }
+    int fd = m_fd;
+    lk.unlock();
+    int r = safe_write(fd, out.data(), out.size());
+    (void)r;
+    lk.lock();
+}
+
+void tracer::entry() {
+    pthread_setname_np(pthread_self(), "tracer");
+    std::unique_lock lk(m_lock);
+    while (!m_stopping) {
+        drain(lk);
+        m_cond.wait_for(lk, std::chrono::milliseconds(m_interval_ms));
+    }
+    drain(lk);
+}
+
+bool decode(const std::string& in, trace_file& out) {
+    if (in.size() < sizeof(trace_magic) ||
+        memcmp(in.data(), trace_magic, sizeof(trace_magic))) {
+        return false;
+    }
+    size_t pos = sizeof(trace_magic);
+    uint64_t mult, base_cycles, base_ns;
+    if (!get(in, pos, &mult) || !get(in, pos, &base_cycles) || !get(in, pos, &base_ns)) {
+        return false;
+    }
+    auto to_ns = [&](uint64_t cycles) {
+        if (cycles >= base_cycles) {
+            return base_ns + (uint64_t)(((unsigned __int128)(cycles - base_cycles) * mult) >> 32);
+        }
+        return base_ns - (uint64_t)(((unsigned __int128)(base_cycles - cycles) * mult) >> 32);
+    };
+
+    out = trace_file();
+    while (pos < in.size()) {
+        uint32_t type, len;
+        if (!get(in, pos, &type) || !get(in, pos, &len) || in.size() - pos < len) {
+            return false;
+        }
+        std::string payload = in.substr(pos, len);
+        pos += len;
+        size_t p = 0;
+
+        switch (type) {
+        case RECORD_EVENT_DEF: {
+            uint16_t id, nargs, name_len, fmt_len;
+            if (!get(payload, p, &id) || !get(payload, p, &nargs) ||
+                !get(payload, p, &name_len) || !get(payload, p, &fmt_len) ||
+                payload.size() - p != (size_t)name_len + fmt_len + nargs) {
+                return false;
+            }
+            if (out.defs.size() <= id) {
+                out.defs.resize(id + 1);
+            }
+            event_def& d = out.defs[id];
+            d.name = payload.substr(p, name_len);
+            d.fmt = payload.substr(p + name_len, fmt_len);
+            d.sig = payload.substr(p + name_len + fmt_len, nargs);
+            break;
+        }
+        case RECORD_EVENTS: {
+            uint32_t tid, pad;
+            if (!get(payload, p, &tid) || !get(payload, p, &pad)) {
+                return false;
+            }
+            while (p < payload.size()) {
+                record_header hdr;
+                if (!get(payload, p, &hdr) || hdr.nargs > max_args ||
+                    payload.size() - p < hdr.nargs * sizeof(uint64_t)) {
+                    return false;
+                }
+                event e;
+                e.ns = to_ns(hdr.cycles);
+                e.tid = tid;
+                e.id = hdr.id;
+                e.args.resize(hdr.nargs);
+                memcpy(e.args.data(), payload.data() + p, hdr.nargs * sizeof(uint64_t));
+                p += hdr.nargs * sizeof(uint64_t);
+                out.events.push_back(std::move(e));
+            }
+            break;
+        }
+        case RECORD_DROPPED: {
+            uint32_t tid, pad;
+            uint64_t n;
+            if (!get(payload, p, &tid) || !get(payload, p, &pad) || !get(payload, p, &n)) {
+                return false;
+            }
+            out.dropped += n;
+            break;
+        }
+        default:
+            // a newer record type, skip it
+            break;
+        }
+    }
+    std::stable_sort(out.events.begin(), out.events.end(),
+                     [](const event& a, const event& b) { return a.ns < b.ns; });
+    return true;
+}
+
+static void format_arg(std::string& out, char type, uint64_t v) {
+    char buf[32];
+    switch (type) {
+    case 'i':
+        snprintf(buf, sizeof(buf), "%lld", (long long)(int64_t)v);
+        break;
+    case 'p':
+        snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)v);
+        break;
+    case 'b':
+        snprintf(buf, sizeof(buf), "%s", v ? "true" : "false");
+        break;
+    case 'f': {
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        snprintf(buf, sizeof(buf), "%g", d);
+        break;
+    }
+    default:
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+        break;
+    }
+    out.append(buf);
+}
+
+std::string format(const trace_file& t, const event& e) {
+    if (e.id >= t.defs.size()) {
+        return "unknown event " + std::to_string(e.id);
+    }
+    const event_def& d = t.defs[e.id];
+    std::string out = d.name + ":";
+    size_t i = 0;
+    if (!d.fmt.empty()) {
+        out += " ";
+        for (size_t p = 0; p < d.fmt.size(); ++p) {
+            if (d.fmt.compare(p, 2, "{}") == 0 && i < e.args.size()) {
+                format_arg(out, i < d.sig.size() ? d.sig[i] : 'u', e.args[i]);
+                ++i;
+                ++p;
+            } else {
+                out += d.fmt[p];
+            }
+        }
+    }
+    // the ones without a "{}"
+    for (; i < e.args.size(); ++i) {
+        out += " ";
+        format_arg(out, i < d.sig.size() ? d.sig[i] : 'u', e.args[i]);
+    }
+    return out;
+}
+
+} //namespace: trace
+
+} //namespace: spec
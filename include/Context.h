@@ -59,6 +59,15 @@ public:
         return false;
     }
 
+    // drop it without finishing, the same ownership as complete()
+    void release() {
+        if (m_self_reference != nullptr) {
+            m_self_reference = nullptr;
+        } else {
+            delete this;
+        }
+    }
+
 public:
     template <typename T, typename... Args>
     static std::shared_ptr<T> create(Args&&... args) {
@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef ARCH_CPU_TOPOLOGY_H
+#define ARCH_CPU_TOPOLOGY_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+/* CPU caches, cores and NUMA nodes of the running host.
+ *
+ * The caches come from cpuid leaf 4(Intel) or 0x8000001D(AMD), and from
+ * /sys/devices/system/cpu/cpu0/cache on the other architectures. The cpus,
+ * cores, sockets and nodes come from sysfs. Any missing piece keeps the
+ * default value, so it's always safe to size things by it.
+ *
+ *         ||  const auto& topo = spec::cpu_topology::get();
+ *         ||  size_t unit = topo.buffer_append_unit();
+ */
+
+namespace spec {
+
+struct cpu_cache_info {
+    unsigned level = 0;
+    char type = 'U';            // 'D'ata, 'I'nstruction or 'U'nified
+    size_t size = 0;            // in bytes
+    unsigned line_size = 0;
+    unsigned ways = 0;
+    unsigned shared_cpus = 1;   // logical cpus sharing this cache
+};
+
+struct cpu_topology {
+    std::vector<cpu_cache_info> caches;
+    unsigned cache_line_size = 64;
+    size_t l1d_size = 32 * 1024;
+    size_t l2_size = 256 * 1024;
+    size_t l3_size = 0;         // 0 if there's no L3
+
+    unsigned num_cpus = 1;      // online logical cpus
+    unsigned num_cores = 1;     // physical cores
+    unsigned num_sockets = 1;
+    unsigned threads_per_core = 1;
+    unsigned num_nodes = 1;
+
+    // indexed by cpu id, -1 for the offline ones
+    std::vector<int> cpu_core;  // unique core index across sockets
+    std::vector<int> cpu_socket;
+    std::vector<int> cpu_node;
+
+    // probed once, the first call is not cheap
+    static const cpu_topology& get();
+
+    // cpuid on x86, then sysfs under root, e.g. "/sys/devices/system"
+    void probe(const std::string& sysfs_root);
+
+    // return 0 if the cache info is found
+    int probe_cpuid();
+    int probe_sysfs_cache(const std::string& sysfs_root);
+
+    void probe_sysfs_topology(const std::string& sysfs_root);
+
+    // return -1 if unknown
+    int node_of_cpu(unsigned cpu) const;
+
+    /* Derived sizes */
+
+    // size of the buffer::list append buffer, power of 2 in [4K, 16K]:
+    // 1/8 of L1d, the buffer being filled stays in L1
+    size_t buffer_append_unit() const;
+
+    // mempool stat shards: power of 2 covering the cpus
+    unsigned mempool_shards() const;
+
+    // copies above it should bypass the cache: 3/4 of the L3 share of
+    // one core, or of L2 if there's no L3
+    size_t nt_store_threshold() const;
+};
+
+} //namespace: spec
+
+#endif //ARCH_CPU_TOPOLOGY_H
@@ -0,0 +1,114 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef ARCH_DISPATCH_H
+#define ARCH_DISPATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ISA levels, every level includes the lower ones.
+ *   scalar  portable C, the reference of every kernel
+ *   sse42   sse4.2
+ *   avx2    avx + avx2
+ *   avx512  avx512 f/vl/bw/dq
+ * A variant which needs a feature out of its level, e.g. pclmul, checks
+ * it in its available(), so the others of the level aren't held back
+ * by the cpus without it.
+ *
+ * The environment variable SPEC_ARCH_LEVEL=<name> caps the level, e.g.
+ * SPEC_ARCH_LEVEL=scalar runs every kernel with its reference version.
+ * It can't raise the level above the cpu features.
+ */
+enum arch_level {
+    ARCH_LEVEL_SCALAR = 0,
+    ARCH_LEVEL_SSE42,
+    ARCH_LEVEL_AVX2,
+    ARCH_LEVEL_AVX512,
+    ARCH_LEVEL_MAX,
+};
+
+extern int arch_level_detected(void);
+
+/* the detected level capped by SPEC_ARCH_LEVEL */
+extern int arch_level(void);
+
+extern const char *arch_level_name(int level);
+
+/* return -1 if the name is unknown */
+extern int arch_level_from_name(const char *name);
+
+/* the features checked by available(), besides the levels */
+extern int arch_has_pclmul(void);
+extern int arch_has_ssse3(void);
+extern int arch_has_sse41(void);
+
+typedef void (*arch_fn_t)(void);
+
+struct arch_kernel_variant {
+    int level;              // the minimal level to run it
+    const char *name;
+    arch_fn_t fn;
+    int (*available)(void); // NULL: compiled in and always usable
+};
+
+/* A dispatched kernel. The caller calls through the function pointer
+ * "slot", registering the kernel stores the best variant into it:
+ *         ||  static const struct arch_kernel_variant foo_variants[] = {
+ *         ||      {ARCH_LEVEL_SCALAR, "generic", (arch_fn_t)foo_generic, NULL},
+ *         ||      {ARCH_LEVEL_AVX2, "avx2", (arch_fn_t)foo_avx2, NULL},
+ *         ||  };
+ *         ||  static struct arch_kernel foo_kernel = {
+ *         ||      "foo", (arch_fn_t*)&foo_func, foo_variants,
+ *         ||      ARCH_ARRAY_SIZE(foo_variants), foo_self_test};
+ *         ||  foo_func_t foo_func = (foo_func_t)arch_kernel_register(&foo_kernel);
+ *
+ * variants[0] is the scalar reference, the others are in ascending level,
+ * the last usable one wins.
+ *
+ * self_test: run the variant and the reference on the same inputs,
+ *            return 0 if they agree
+ */
+struct arch_kernel {
+    const char *name;
+    arch_fn_t *slot;
+    const struct arch_kernel_variant *variants;
+    unsigned num_variants;
+    int (*self_test)(arch_fn_t ref, arch_fn_t fn);
+
+    // filled by arch_kernel_register
+    const struct arch_kernel_variant *chosen;
+    struct arch_kernel *next;
+};
+
+#define ARCH_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* select the variant for arch_level(), store it into the slot and
+ * return it. Registering the same kernel again only selects again.
+ */
+extern arch_fn_t arch_kernel_register(struct arch_kernel *k);
+
+/* return NULL if no such kernel */
+extern const struct arch_kernel *arch_kernel_find(const char *name);
+
+/* run every usable variant of every kernel against its reference,
+ * report is called for each of them if not NULL.
+ * return the number of failed variants
+ */
+extern int arch_kernel_self_test(void (*report)(const char *kernel,
+                                                const char *variant,
+                                                int ok));
+
+/* read SPEC_ARCH_LEVEL again and select all the kernels again, only for
+ * testing: the slots are updated without any synchronization.
+ */
+extern void arch_kernel_reselect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
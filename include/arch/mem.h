@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef ARCH_MEM_H
+#define ARCH_MEM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int (*arch_mem_is_zero_func_t)(const void *data, size_t len);
+
+/* dispatched by the kernel registry, see arch/dispatch.h */
+extern arch_mem_is_zero_func_t arch_mem_is_zero_func;
+
+/* return non-zero if all the len bytes are 0 */
+static inline int arch_mem_is_zero(const void *data, size_t len) {
+    return arch_mem_is_zero_func(data, len);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
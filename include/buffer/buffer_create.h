@@ -12,6 +12,8 @@
 
 #define SPEC_BUFFER_ALLOC_UNIT (4096U)
 #define SPEC_BUFFER_APPEND_SIZE (SPEC_BUFFER_ALLOC_UNIT - sizeof(raw_combined))
+// size of the shared zero area, see list::sparsify
+#define SPEC_BUFFER_ZERO_AREA_SIZE (4U << 20)
 
 namespace spec {
 
@@ -66,6 +68,11 @@ create_static(uint64_t len, char *buf);
 extern unique_leakable_ptr<raw>
 claim_buffer(uint64_t len, char *buf, deleter del);
 
+/* size of a new append buffer(raw_combined included), a multiple of
+ * SPEC_BUFFER_ALLOC_UNIT sized by the L1d cache, see cpu_topology.h
+ */
+extern uint64_t get_append_alloc_unit();
+
 } //namespace: buffer
 
 } //namespace: spec
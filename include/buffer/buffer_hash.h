@@ -6,26 +6,91 @@
 #ifndef SPEC_BUFFERLIST_HASH_H
 #define SPEC_BUFFERLIST_HASH_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
 #include "buffer_list.h"
 
 namespace spec {
 
 namespace buffer {
 
-// efficent hash for one or more bufferlists
+/* efficent hash for one or more bufferlists
+ *
+ * The digest is the crc of all the absorbed bytes in order, so it's
+ * incremental, and two hashes are concatenated by the crc combine math
+ * (crc(a + b) = crc_zeros(crc(a), len(b)) ^ crc(b) from 0), e.g. the lists
+ * are hashed by several threads then combined in order:
+ *         ||  buffer_hash h0, h1;
+ *         ||  h0.update(a);               // thread 0
+ *         ||  h1.update(b);               // thread 1
+ *         ||  h0.combine(h1);             // == update(a) then update(b)
+ *
+ * width:
+ *     bits32   crc32c, the same value as chaining blist.crc32c(crc)
+ *     bits64   crc64, see crc32/crc64.h
+ *     bits128  crc64 and crc32c, digest128() = {crc64, crc32c}
+ */
 class hash {
+public:
+    enum class width {
+        bits32 = 32,
+        bits64 = 64,
+        bits128 = 128,
+    };
+
 private:
+    width _width;
     uint32_t _crc;
+    uint64_t _crc64;
+    uint32_t _init;
+    uint64_t _init64;
+    uint64_t _len;
 
 public:
-    hash(uint32_t init = 0): _crc(init) {}
+    hash(uint32_t init = 0)
+        : _width(width::bits32), _crc(init), _crc64(0),
+          _init(init), _init64(0), _len(0) {}
+
+    explicit hash(width w, uint64_t init = 0)
+        : _width(w), _crc(init), _crc64(init),
+          _init(init), _init64(init), _len(0) {}
+
+    void update(const buffer_list& blist);
 
-    void update(const buffer_list& blist) {
-        _crc = blist.crc32c(_crc);
+    void update(const char *data, uint64_t len);
+
+    /* absorb the n lists in order, equal to updating them one by one.
+     * The segments of all the lists are hashed from 0 as independent
+     * streams by crc32c_multi then combined, the cached crc of the raw
+     * buffers isn't used. bits64 hashes the lists one by one.
+     */
+    void update(const buffer_list *const *blists, size_t n);
+
+    /* absorb everything absorbed by other after this one,
+     * both must have the same width
+     */
+    void combine(const hash& other);
+
+    uint64_t length() const {
+        return _len;
     }
 
+    // bits32/bits128: crc32c, bits64: low 32 bits of crc64
     uint32_t digest() const {
-        return _crc;
+        return _width == width::bits64 ? (uint32_t)_crc64 : _crc;
+    }
+
+    // bits32: crc32c, bits64/bits128: crc64
+    uint64_t digest64() const {
+        return _width == width::bits32 ? _crc : _crc64;
+    }
+
+    // {crc64, crc32c}, the length isn't in it, compare length() as well
+    std::pair<uint64_t, uint64_t> digest128() const {
+        return std::make_pair(_crc64, (uint64_t)_crc);
     }
 };
 
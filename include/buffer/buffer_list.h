@@ -6,6 +6,7 @@
 #include <limits.h>
 #include <cstring>
 #include <type_traits>
+#include <vector>
 #include "buffer_create.h"
 #include "buffer_ptr.h"
 #include "buffer_fwd.h"
@@ -671,6 +672,20 @@ public:
 
     bool is_zero() const;
 
+    /* bit i of the returned bitmap(64 blocks per word) is set if the
+     * block [i * block_size, (i + 1) * block_size) is all zeros, the last
+     * block may be shorter.
+     */
+    std::vector<uint64_t> scan_zero_blocks(uint64_t block_size) const;
+
+    /* replace the zero blocks by segments of the shared zero area, a
+     * read-only raw_static mapped from the zero page: they cost no memory
+     * and write_fd(fd, offset) punches holes for them. A raw is released
+     * once no data block refers to it. Writing into the zero segments
+     * faults like any raw_static, list::zero() skips them.
+     */
+    void sparsify(uint64_t block_size);
+
     void clear() noexcept {
         _tail_pnode_cache = &always_empty_bptr;
         _buffers.clear_and_dispose();
@@ -740,6 +755,12 @@ public:
                                          uint64_t max_buffers = 0);
     bool rebuild_page_aligned();
 
+    /* Copy the data held in the arena out to the heap, so the list can
+     * outlive its request scope without pinning the arena pages.
+     * Return true if the list is rebuilt.
+     */
+    bool unshare_arena();
+
     void reserve(uint64_t pre_alloc_size);
 
     void claim_append(buffer_list& other_blist);
@@ -819,6 +840,7 @@ public:
     ssize_t read_fd(int fd, size_t len);
     int write_file(const char* fn, int mode=0644);
     int write_fd(int fd) const;
+    // the runs of the zero area segments(see sparsify) are holes punched
     int write_fd(int fd, uint64_t offset) const;
 
     template <typename VectorT>
@@ -834,6 +856,19 @@ public:
     }
 
     uint32_t crc32c(uint32_t crc) const;
+
+    /* crc32c of every block_size bytes, the last block may be shorter.
+     * Every block starts from the initial value crc. The whole blocks
+     * are calculated in one batch by crc32c_multi().
+     */
+    void crc32c_per_block(uint64_t block_size, std::vector<uint32_t> *crcs,
+                          uint32_t crc = 0) const;
+
+    /* checksum of the whole list with one of spec_csum_type. The crc
+     * checksums are cached per raw like crc32c(), xxh64 is streamed over
+     * the buffers and never cached. An unknown type returns 0.
+     */
+    uint64_t checksum(int type, uint64_t seed) const;
     void invalidate_crc();
 
     static buffer_list static_from_mem(char* c, size_t len);
@@ -11,6 +11,7 @@
 #include "buffer_fwd.h"
 #include "../unique_leakable_ptr.h"
 #include "../page.h"
+#include "../mempool/arena.h"
 #include "../spec_assert/spec_assert.h"
 
 namespace spec {
@@ -249,6 +250,28 @@ private:
 public:
     ~ptr_node() = default;
 
+    // ptr_node is taken from the current thread's arena if there's one
+    static void* operator new(size_t size) {
+        if (mempool::arena *a = mempool::arena::current()) {
+            if (void *p = a->allocate(size, alignof(ptr_node))) {
+                return p;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    static void* operator new(size_t, void *p) {
+        return p;
+    }
+
+    static void operator delete(void *p) {
+        if (mempool::arena::contains(p)) {
+            mempool::arena::release(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
     static ptr_node* copy_hypercombined(const ptr_node& copy_this);
 
     static std::unique_ptr<ptr_node, disposer>
@@ -9,10 +9,11 @@
 #include <utility>
 #include <type_traits>
 
+#include "../crc32/checksum.h"
 #include "../spec_atomic.h"
 #include "../inline_memory.h"
 #include "../mempool/mempool.h"
-#include "../spinlock/spinlock.h"
+#include "../spinlock/seqlock.h"
 
 #include "buffer_ptr.h"
 
@@ -30,13 +31,16 @@ public:
     spec::atomic<uint64_t> nref{0};
     int64_t mempool_type_id;
 
-    std::pair<size_t, size_t>
-        last_crc_offset{std::numeric_limits<size_t>::max(),
-                        std::numeric_limits<size_t>::max()};
-
-    std::pair<uint32_t, uint32_t> last_crc_val;
-
-    mutable spec::spinlock crc_spinlock;
+    // one slot shared by all the combinable checksums(crc32c, crc64)
+    struct csum_cache {
+        size_t from = std::numeric_limits<size_t>::max();
+        size_t to = std::numeric_limits<size_t>::max();
+        uint64_t base = 0;
+        uint64_t csum = 0;
+        int type = SPEC_CSUM_CRC32C;
+    };
+    // read on every crc of the buffer, written when it's computed
+    spec::seqlock<csum_cache> crc_cache;
 
     explicit
     raw(uint64_t len, int64_t mempool_type_index = mempool::mempool_buffer_anon)
@@ -47,8 +51,13 @@ public:
         int64_t mempool_type_index = mempool::mempool_buffer_anon)
         : m_data(data), m_len(len), nref(0), mempool_type_id(mempool_type_index) {
         mempool::get_pool(mempool::pool_type_id(mempool_type_id)).adjust_count(1, m_len);
+        /* keyed by &m_len: "this" may already be sampled by the
+         * mempool allocator of the derived class.
+         */
+        MEMPOOL_PROFILE_ALLOC(&m_len, m_len);
     }
     virtual ~raw() {
+        MEMPOOL_PROFILE_FREE(&m_len);
         mempool::get_pool(mempool::pool_type_id(mempool_type_id)).adjust_count(-1, -(int)m_len);
     }
 
@@ -97,25 +106,44 @@ public:
 
     bool get_crc(const std::pair<size_t, size_t> &fromto,
                  std::pair<uint32_t, uint32_t> *crc) const {
-        std::lock_guard lg(crc_spinlock);
-        if (last_crc_offset == fromto) {
-            *crc = last_crc_val;
-            return true;
+        std::pair<uint64_t, uint64_t> val;
+        if (!get_csum(SPEC_CSUM_CRC32C, fromto, &val)) {
+            return false;
         }
-        return false;
+        *crc = std::make_pair((uint32_t)val.first, (uint32_t)val.second);
+        return true;
     }
 
     void set_crc(const std::pair<size_t, size_t> &fromto,
                  const std::pair<uint32_t, uint32_t> &crc) {
-        std::lock_guard lg(crc_spinlock);
-        last_crc_offset = fromto;
-        last_crc_val = crc;
+        set_csum(SPEC_CSUM_CRC32C, fromto, crc);
+    }
+
+    bool get_csum(int type, const std::pair<size_t, size_t> &fromto,
+                  std::pair<uint64_t, uint64_t> *csum) const {
+        csum_cache c = crc_cache.load();
+        if (c.type == type && c.from == fromto.first && c.to == fromto.second) {
+            *csum = std::make_pair(c.base, c.csum);
+            return true;
+        }
+        return false;
+    }
+
+    void set_csum(int type, const std::pair<size_t, size_t> &fromto,
+                  const std::pair<uint64_t, uint64_t> &csum) {
+        csum_cache c;
+        c.from = fromto.first;
+        c.to = fromto.second;
+        c.base = csum.first;
+        c.csum = csum.second;
+        c.type = type;
+        crc_cache.store(c);
     }
 
     void invalidate_crc() {
-        std::lock_guard lg(crc_spinlock);
-        last_crc_offset.first = std::numeric_limits<size_t>::max();
-        last_crc_offset.second = std::numeric_limits<size_t>::max();
+        spec::seqlock<csum_cache>::write_guard c(crc_cache);
+        c->from = std::numeric_limits<size_t>::max();
+        c->to = std::numeric_limits<size_t>::max();
     }
 };
 
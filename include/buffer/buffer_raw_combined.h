@@ -41,16 +41,22 @@ public:
         uint64_t rawlen = round_up_to(sizeof(raw_combined), alignof(raw_combined));
         uint64_t datalen = round_up_to(len, alignof(raw_combined));
 
-        #ifdef DARWIN
-        char *ptr = (char *) valloc(rawlen + datalen);
-        #else
         char *ptr = nullptr;
-        int rst = ::posix_memalign((void**)(void*)&ptr, alignment,
-                                    rawlen + datalen);
-        if (rst) {
-            throw bad_alloc();
+        if (mempool::arena *a = mempool::arena::current()) {
+            ptr = (char *)a->allocate(rawlen + datalen, alignment);
+        }
+
+        if (!ptr) {
+            #ifdef DARWIN
+            ptr = (char *) valloc(rawlen + datalen);
+            #else
+            int rst = ::posix_memalign((void**)(void*)&ptr, alignment,
+                                        rawlen + datalen);
+            if (rst) {
+                throw bad_alloc();
+            }
+            #endif /* DARWIN */
         }
-        #endif /* DARWIN */
 
         if (!ptr) {
             throw bad_alloc();
@@ -68,7 +74,11 @@ public:
 
     static void operator delete(void *ptr) {
         raw_combined *raw = (raw_combined *)ptr;
-        ::free((void *)raw->m_data);
+        if (mempool::arena::contains(raw->m_data)) {
+            mempool::arena::release(raw->m_data);
+        } else {
+            ::free((void *)raw->m_data);
+        }
     }
 };
 
@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_LATENCY_H
+#define SPEC_LATENCY_H
+
+#include "../stats/histogram.h"
+#include "spec_clock.h"
+
+namespace spec {
+
+/* Records the ns from its construction to its destruction into a
+ * histogram. It stamps with the raw TSC, the conversion to ns is done
+ * once, in the destructor.
+ */
+class latency_timer {
+private:
+    stats::histogram& m_hist;
+    uint64_t m_start;
+
+public:
+    explicit latency_timer(stats::histogram& hist)
+        : m_hist(hist), m_start(spec_tsc_cycles()) {}
+
+    ~latency_timer() {
+        m_hist.record(spec_tsc_to_ns(spec_tsc_cycles() - m_start));
+    }
+
+    latency_timer(const latency_timer&) = delete;
+    latency_timer& operator=(const latency_timer&) = delete;
+};
+
+} //namespace: spec
+
+/* Time the rest of the enclosing scope into hist, a stats::histogram:
+ *         ||  static spec::stats::histogram flush_lat("bluefs.flush_ns");
+ *         ||  void flush() {
+ *         ||      SPEC_LATENCY_TIMER(flush_lat);
+ *         ||      ...
+ *         ||  }
+ * It's compiled out unless LATENCY_STATS is defined.
+ */
+#define SPEC_LATENCY_CAT2(a, b) a##b
+#define SPEC_LATENCY_CAT(a, b) SPEC_LATENCY_CAT2(a, b)
+
+#ifdef LATENCY_STATS
+#define SPEC_LATENCY_TIMER(hist) \
+    spec::latency_timer SPEC_LATENCY_CAT(latency_timer_, __LINE__)(hist)
+#else
+#define SPEC_LATENCY_TIMER(hist) do {} while (0)
+#endif
+
+#endif //SPEC_LATENCY_H
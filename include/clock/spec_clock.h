@@ -6,8 +6,35 @@
 #ifndef SPEC_CLOCK_H
 #define SPEC_CLOCK_H
 
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include "../time/nstime.h"
 #include "../time/utime.h"
 
+/* The clocks:
+ *
+ *     spec_clock_now()         wall clock, utime_t, it may jump
+ *     spec_mono_now()          CLOCK_MONOTONIC, the one for the timeouts
+ *     spec_mono_coarse_now()   CLOCK_MONOTONIC_COARSE, no syscall nor
+ *                              tsc read, but it only moves every tick
+ *     spec_tsc_now()           the invariant TSC scaled to ns, for the
+ *                              per-op latency stamps
+ *
+ * The monotonic ones return nstime_t, their epoch is the boot.
+ *
+ * spec_tsc_cycles() is the raw counter: stamp with it and convert the
+ * delta with spec_tsc_to_ns() later, off the hot path. The TSC is
+ * calibrated against CLOCK_MONOTONIC once(~5ms), by the static init of the
+ * trace and stats libraries, or else on the first use, and follows it
+ * within the calibration error. Without an invariant TSC, or
+ * off x86, it falls back to CLOCK_MONOTONIC.
+ */
+
 static inline utime_t spec_clock_now()
 {
     struct timespec tp;
@@ -16,4 +43,111 @@ static inline utime_t spec_clock_now()
     return n;
 }
 
+static inline nstime_t spec_mono_now()
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return nstime_t(tp);
+}
+
+static inline nstime_t spec_mono_coarse_now()
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &tp);
+    return nstime_t(tp);
+}
+
+struct spec_tsc_calibration {
+    bool invariant = false;
+    uint64_t base_cycles = 0;
+    uint64_t base_ns = 0;
+    uint64_t mult = 0;          // ns per cycle in 32.32 fixed point
+    double cycles_per_ns = 0;
+
+    static bool probe_invariant() {
+#if defined(__x86_64__)
+        uint32_t eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) {
+            return false;
+        }
+        __cpuid(0x80000007, eax, ebx, ecx, edx);
+        return edx & (1u << 8);
+#else
+        return false;
+#endif
+    }
+
+    spec_tsc_calibration() {
+#if defined(__x86_64__)
+        invariant = probe_invariant();
+        if (!invariant) {
+            return;
+        }
+        // the closest tsc to each clock read: the reads are ~20ns apart
+        auto sample = [](uint64_t *cycles, uint64_t *ns) {
+            uint64_t best = UINT64_MAX;
+            for (int i = 0; i < 5; ++i) {
+                uint64_t t0 = __rdtsc();
+                uint64_t n = spec_mono_now().to_nsec();
+                uint64_t t1 = __rdtsc();
+                if (t1 - t0 < best) {
+                    best = t1 - t0;
+                    *cycles = t0 + (t1 - t0) / 2;
+                    *ns = n;
+                }
+            }
+        };
+        uint64_t c0 = 0, n0 = 0, c1 = 0, n1 = 0;
+        sample(&c0, &n0);
+        do {
+            sample(&c1, &n1);
+        } while (n1 - n0 < 5000000);
+        cycles_per_ns = (double)(c1 - c0) / (n1 - n0);
+        mult = (uint64_t)((n1 - n0) * 4294967296.0 / (c1 - c0));
+        base_cycles = c1;
+        base_ns = n1;
+#endif
+    }
+
+    static const spec_tsc_calibration& get() {
+        static const spec_tsc_calibration cal;
+        return cal;
+    }
+};
+
+// in ns when there is no invariant TSC
+static inline uint64_t spec_tsc_cycles()
+{
+#if defined(__x86_64__)
+    if (spec_tsc_calibration::get().invariant) {
+        return __rdtsc();
+    }
+#endif
+    return spec_mono_now().to_nsec();
+}
+
+// a cycle delta to ns
+static inline uint64_t spec_tsc_to_ns(uint64_t cycles)
+{
+    const spec_tsc_calibration& cal = spec_tsc_calibration::get();
+    if (!cal.invariant) {
+        return cycles;
+    }
+    return (uint64_t)(((unsigned __int128)cycles * cal.mult) >> 32);
+}
+
+static inline nstime_t spec_tsc_now()
+{
+    const spec_tsc_calibration& cal = spec_tsc_calibration::get();
+    if (!cal.invariant) {
+        return spec_mono_now();
+    }
+    uint64_t c = spec_tsc_cycles();
+    // the cycles before the calibration, only by a racing cpu
+    if (c < cal.base_cycles) {
+        return nstime_t(cal.base_ns - spec_tsc_to_ns(cal.base_cycles - c));
+    }
+    return nstime_t(cal.base_ns + spec_tsc_to_ns(c - cal.base_cycles));
+}
+
 #endif //SPEC_CLOCK_H
@@ -0,0 +1,250 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_COMBINATORS_H
+#define SPEC_COMBINATORS_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "../Context.h"
+
+/* Combinators to build one completion out of several Contexts:
+ *     C_Gather    complete when quorum of the total sub ops finish
+ *     C_Chain     run the async steps one after another
+ *     C_OnError   run a callback when the result is an error
+ *     C_Timeout   complete with -ETIMEDOUT unless the op finishes first
+ * A negative result is an error, the other results are success.
+ */
+
+namespace spec {
+
+enum class gather_error {
+    first,      // the first error
+    aggregate,  // the error if all the failed ops agree, or -EIO
+};
+
+/* Fan-out with a quorum, e.g. 2 of 3 replica writes:
+ *         ||  auto g = C_Gather::create(onfinish, 3, 2);
+ *         ||  for (unsigned i = 0; i < 3; ++i) {
+ *         ||      send_write(replica[i], g->sub(i));
+ *         ||  }
+ *
+ * onfinish is completed once the result is known: with 0 as soon as quorum
+ * subs succeed, or with the error as soon as the quorum can't be reached.
+ * With wait_all, it waits for all the subs, the result is the same.
+ *
+ * The subs are preallocated with the gather in one allocation, so they're
+ * only completed, never deleted. Every sub must be completed exactly once,
+ * the gather frees itself after the last one. The counting is one atomic
+ * add per sub.
+ */
+class C_Gather {
+public:
+    class sub_context : public Context {
+    private:
+        C_Gather *m_gather = nullptr;
+        friend class C_Gather;
+
+    protected:
+        void finish(int r) override {}
+
+    public:
+        void complete(int r) override {
+            m_gather->sub_done(r);
+        }
+
+        bool sync_complete(int r) override {
+            return false;
+        }
+    };
+
+private:
+    Context *m_onfinish;
+    const uint32_t m_total;
+    const uint32_t m_quorum;
+    const gather_error m_policy;
+    const bool m_wait_all;
+    std::atomic<int> m_error{0};
+    // failures << 32 | successes
+    std::atomic<uint64_t> m_counts{0};
+    std::atomic<uint32_t> m_refs;
+    sub_context *m_subs;
+
+    C_Gather(Context *onfinish, uint32_t total, uint32_t quorum,
+             gather_error policy, bool wait_all, sub_context *subs);
+    ~C_Gather();
+
+    void sub_done(int r);
+    void put();
+
+public:
+    C_Gather(const C_Gather&) = delete;
+    C_Gather& operator=(const C_Gather&) = delete;
+
+    // quorum 0 means all of them
+    static C_Gather* create(Context *onfinish, uint32_t total, uint32_t quorum = 0,
+                            gather_error policy = gather_error::first,
+                            bool wait_all = false);
+
+    Context* sub(uint32_t i) {
+        return &m_subs[i];
+    }
+
+    uint32_t total() const {
+        return m_total;
+    }
+};
+
+/* Async steps one after another, the chain itself is the Context completed
+ * by the op of each step:
+ *         ||  auto chain = new C_Chain(onfinish);
+ *         ||  chain->then([](Context *next) { read_meta(next); })
+ *         ||       .then([](Context *next) { write_data(next); });
+ *         ||  chain->start();
+ * The first error stops the chain, onfinish gets it. Otherwise onfinish
+ * gets the result of the last step. An op completed inline runs the next
+ * step on the same stack.
+ */
+class C_Chain : public Context {
+public:
+    using step_fn = std::function<void(Context *next)>;
+
+private:
+    Context *m_onfinish;
+    std::vector<step_fn> m_steps;
+    size_t m_next = 0;
+
+protected:
+    void finish(int r) override {
+        m_onfinish->complete(r);
+    }
+
+public:
+    explicit C_Chain(Context *onfinish) : m_onfinish(onfinish) {}
+
+    C_Chain& then(step_fn step) {
+        m_steps.push_back(std::move(step));
+        return *this;
+    }
+
+    void start() {
+        complete(0);
+    }
+
+    void complete(int r) override {
+        if (r < 0 || m_next == m_steps.size()) {
+            Context::complete(r);
+            return;
+        }
+        m_steps[m_next++](this);
+    }
+};
+
+/* Run on_error(r) for an error before completing next, e.g. to count or
+ * log the failed ops. next may be nullptr.
+ *         ||  auto c = make_on_error(onfinish, [this](int r) { failed++; });
+ */
+template <typename F>
+class C_OnError : public Context {
+private:
+    Context *m_next;
+    F m_on_error;
+
+protected:
+    void finish(int r) override {
+        if (r < 0) {
+            m_on_error(r);
+        }
+        if (m_next) {
+            m_next->complete(r);
+        }
+    }
+
+public:
+    C_OnError(Context *next, F&& on_error)
+        : m_next(next), m_on_error(std::move(on_error)) {}
+};
+
+template <typename F>
+C_OnError<std::decay_t<F>>* make_on_error(Context *next, F&& on_error) {
+    return new C_OnError<std::decay_t<F>>(next, std::decay_t<F>(std::forward<F>(on_error)));
+}
+
+/* The op and a timer race to complete onfinish:
+ *         ||  auto to = new C_Timeout(onfinish);
+ *         ||  timer.add(deadline, to->expiry());
+ *         ||  submit(op, to);
+ * onfinish gets the op result, or -ETIMEDOUT if the expiry Context fires
+ * first; the late one is dropped. expiry() must be taken before the op is
+ * submitted. The timer may delete the expiry Context instead of completing
+ * it, e.g. the timer is canceled. C_Timeout frees itself after both.
+ */
+class C_Timeout : public Context {
+private:
+    class C_Expire : public Context {
+    private:
+        C_Timeout *m_parent;
+
+    protected:
+        void finish(int r) override {
+            m_parent->fire(-ETIMEDOUT);
+        }
+
+    public:
+        explicit C_Expire(C_Timeout *parent) : m_parent(parent) {}
+        ~C_Expire() override {
+            m_parent->put();
+        }
+    };
+
+    std::atomic<Context*> m_onfinish;
+    std::atomic<uint32_t> m_refs{1};
+
+    ~C_Timeout() override = default;
+
+    void fire(int r) {
+        Context *c = m_onfinish.exchange(nullptr, std::memory_order_acq_rel);
+        if (c) {
+            c->complete(r);
+        }
+    }
+
+    void put() {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+protected:
+    void finish(int r) override {}
+
+public:
+    explicit C_Timeout(Context *onfinish) : m_onfinish(onfinish) {}
+
+    Context* expiry() {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+        return new C_Expire(this);
+    }
+
+    void complete(int r) override {
+        fire(r);
+        put();
+    }
+
+    bool sync_complete(int r) override {
+        return false;
+    }
+};
+
+} //namespace: spec
+
+#endif //SPEC_COMBINATORS_H
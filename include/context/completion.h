@@ -0,0 +1,204 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_COMPLETION_H
+#define SPEC_COMPLETION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "../Context.h"
+
+namespace spec {
+
+/* Pooled completion of an async op, the lightweight Context.
+ *
+ * One completion is one cache line from the per-thread freelist: a
+ * pointer to a static vtable, an intrusive link and the result/tag for the
+ * queues, and 40 bytes to keep the captured callable, a bigger one is kept
+ * on the heap.
+ * There's no refcount, the owner runs it exactly once by complete(), or
+ * drops it by release():
+ *         ||  auto c = completion::create([this, op](int r) { op_done(op, r); });
+ *         ||  submit(op, c);
+ *         ||  ...
+ *         ||  c->complete(r);        // c is gone after it
+ *
+ * Context is bridged both ways:
+ *     completion::wrap(ctx)     completes the Context, or releases it
+ *     C_Completion(c)           a Context which completes c
+ */
+class completion {
+public:
+    static constexpr size_t inline_size = 40;
+
+    struct vtable {
+        void (*call)(void *storage, int r);
+        void (*destroy)(void *storage);
+    };
+
+private:
+    const vtable *m_vt;
+    completion *m_next = nullptr;
+    int m_result = 0;
+    uint32_t m_tag = 0;
+    alignas(8) unsigned char m_storage[inline_size];
+
+    template <typename F>
+    struct inline_impl {
+        static void call(void *s, int r) {
+            (*reinterpret_cast<F*>(s))(r);
+        }
+        static void destroy(void *s) {
+            reinterpret_cast<F*>(s)->~F();
+        }
+        static constexpr vtable vt = {call, destroy};
+    };
+
+    template <typename F>
+    struct heap_impl {
+        static void call(void *s, int r) {
+            (**reinterpret_cast<F**>(s))(r);
+        }
+        static void destroy(void *s) {
+            delete *reinterpret_cast<F**>(s);
+        }
+        static constexpr vtable vt = {call, destroy};
+    };
+
+    // the Context is gone after complete(), only released if never run
+    struct context_impl {
+        static void call(void *s, int r) {
+            std::exchange(*reinterpret_cast<Context**>(s), nullptr)->complete(r);
+        }
+        static void destroy(void *s) {
+            if (Context *ctx = *reinterpret_cast<Context**>(s)) {
+                ctx->release();
+            }
+        }
+        static constexpr vtable vt = {call, destroy};
+    };
+
+    completion() = default;
+    ~completion() = default;
+
+    // from the freelist of the calling thread
+    static void* alloc();
+    static void free(void *p);
+
+public:
+    completion(const completion&) = delete;
+    completion& operator=(const completion&) = delete;
+
+    template <typename F>
+    static completion* create(F&& f) {
+        using Fn = std::decay_t<F>;
+        completion *c = new (alloc()) completion;
+        if constexpr (sizeof(Fn) <= inline_size && alignof(Fn) <= 8) {
+            try {
+                new (c->m_storage) Fn(std::forward<F>(f));
+            } catch (...) {
+                free(c);
+                throw;
+            }
+            c->m_vt = &inline_impl<Fn>::vt;
+        } else {
+            try {
+                *reinterpret_cast<Fn**>(c->m_storage) = new Fn(std::forward<F>(f));
+            } catch (...) {
+                free(c);
+                throw;
+            }
+            c->m_vt = &heap_impl<Fn>::vt;
+        }
+        return c;
+    }
+
+    // complete the Context by the completion
+    static completion* wrap(Context *ctx) {
+        completion *c = new (alloc()) completion;
+        *reinterpret_cast<Context**>(c->m_storage) = ctx;
+        c->m_vt = &context_impl::vt;
+        return c;
+    }
+
+    // run it then release it
+    void complete(int r) {
+        m_vt->call(m_storage, r);
+        release();
+    }
+
+    // run it with the result kept by set_result()
+    void complete() {
+        complete(m_result);
+    }
+
+    // drop it without running
+    void release() {
+        m_vt->destroy(m_storage);
+        this->~completion();
+        free(this);
+    }
+
+    // the intrusive link, free to use by the current owner
+    completion* next() const {
+        return m_next;
+    }
+    void set_next(completion *c) {
+        m_next = c;
+    }
+
+    // the result to complete with, kept while it's queued
+    int result() const {
+        return m_result;
+    }
+    void set_result(int r) {
+        m_result = r;
+    }
+
+    // free to use by the current owner, e.g. the enqueue time
+    uint32_t tag() const {
+        return m_tag;
+    }
+    void set_tag(uint32_t t) {
+        m_tag = t;
+    }
+
+    struct pool_stats {
+        uint64_t slabs;         // allocated slabs, never freed
+        uint64_t global_free;   // completions in the global freelist
+    };
+    static pool_stats get_pool_stats();
+};
+
+static_assert(sizeof(completion) == 64, "completion is one cache line");
+
+// a Context which completes the completion, for the interfaces of Context
+class C_Completion : public Context {
+private:
+    completion *m_completion;
+
+protected:
+    void finish(int r) override {
+        std::exchange(m_completion, nullptr)->complete(r);
+    }
+
+public:
+    explicit C_Completion(completion *c) : m_completion(c) {}
+
+    ~C_Completion() override {
+        if (m_completion) {
+            m_completion->release();
+        }
+    }
+};
+
+} //namespace: spec
+
+#endif //SPEC_COMPLETION_H
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_COROUTINE_H
+#define SPEC_COROUTINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Context.h"
+
+namespace spec {
+
+class file_io;
+class timer_wheel;
+
+struct co_scheduler_options {
+    unsigned cores = 0;             // 0: one per cpu
+    size_t stack_size = 64 * 1024;
+    bool pin_cpus = false;
+    unsigned io_threads = 4;        // of the file_io backend
+
+    co_scheduler_options() = default;
+    co_scheduler_options(unsigned n) : cores(n) {}
+};
+
+/* Stackful coroutines(Boost.Context fibers) on per-core threads, to write
+ * the async flows as straight-line code:
+ *         ||  spec::co_scheduler sched;
+ *         ||  sched.spawn([&] {
+ *         ||      ssize_t r = co_scheduler::pread(fd, buf, len, off);
+ *         ||      int w = co_scheduler::await([&](Context *c) {
+ *         ||          replicate(buf, r, c);
+ *         ||      });
+ *         ||      ...
+ *         ||  });
+ *
+ * Every core owns one thread and one run queue, a coroutine always runs on
+ * the core it's spawned to. The other threads push to the lock-free inbox
+ * of the core, the core moves it to its local FIFO when it's empty.
+ *
+ * await(start) calls start(ctx) then suspends the coroutine until ctx is
+ * completed, from any thread, and returns the result. ctx lives on the
+ * coroutine stack: it must be completed exactly once and never deleted.
+ * An inline completion returns without switching.
+ *
+ * pread()/pwrite()/fsync() yield to the other coroutines while the op is
+ * on the file_io threads. Outside a coroutine they block. sleep_for()
+ * suspends on the timer wheel of the scheduler.
+ *
+ * A coroutine must not block the core thread, nor throw out of its body.
+ */
+class co_scheduler {
+public:
+    using options = co_scheduler_options;
+
+    struct core;
+    struct task;
+
+private:
+    // the Context to resume the waiting coroutine
+    class C_Resume : public Context {
+    private:
+        task *m_task;
+
+    protected:
+        void finish(int r) override {}
+
+    public:
+        int result = 0;
+
+        explicit C_Resume(task *t) : m_task(t) {}
+
+        void complete(int r) override {
+            result = r;
+            // the coroutine may be gone right after it
+            wake(m_task);
+        }
+
+        bool sync_complete(int r) override {
+            return false;
+        }
+    };
+
+    const options m_opts;
+    std::vector<std::unique_ptr<core>> m_cores;
+    std::atomic<uint64_t> m_next_core{0};
+    std::unique_ptr<file_io> m_io;
+    std::unique_ptr<timer_wheel> m_timer;
+
+    // notified when the last coroutine returns
+    std::mutex m_lock;
+    std::condition_variable m_cond;
+    std::atomic<uint64_t> m_live{0};
+    std::atomic<bool> m_stopping{false};
+
+    void entry(core& c);
+    void run(core& c, task *t);
+    void task_done();
+
+    static task* current();
+    static void prepare_wait(task *t);
+    static void wait(task *t);
+    static void wake(task *t);
+    static void push(task *t);
+
+public:
+    explicit co_scheduler(const options& opts = options());
+    ~co_scheduler();
+
+    co_scheduler(const co_scheduler&) = delete;
+    co_scheduler& operator=(const co_scheduler&) = delete;
+
+    void spawn(std::function<void()> fn);
+    void spawn_on(unsigned core, std::function<void()> fn);
+
+    // wait until all the coroutines return
+    void wait_for_empty();
+
+    unsigned num_cores() const {
+        return m_cores.size();
+    }
+
+    file_io& io() {
+        return *m_io;
+    }
+
+    timer_wheel& timer() {
+        return *m_timer;
+    }
+
+    /* In a coroutine */
+
+    static bool in_coroutine() {
+        return current() != nullptr;
+    }
+
+    // the scheduler of the calling coroutine
+    static co_scheduler* scheduler();
+
+    // let the other coroutines of the core run
+    static void yield();
+
+    template <typename F>
+    static int await(F&& start) {
+        task *t = current();
+        assert(t);
+        C_Resume ctx(t);
+        prepare_wait(t);
+        start(static_cast<Context*>(&ctx));
+        wait(t);
+        return ctx.result;
+    }
+
+    static void sleep_for(uint64_t ns);
+
+    static ssize_t pread(int fd, void *buf, size_t len, off_t off);
+    static ssize_t pwrite(int fd, const void *buf, size_t len, off_t off);
+    static int fsync(int fd);
+};
+
+} //namespace: spec
+
+#endif //SPEC_COROUTINE_H
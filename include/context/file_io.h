@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_FILE_IO_H
+#define SPEC_FILE_IO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../Context.h"
+#include "finisher.h"
+
+namespace spec {
+
+/* Async file I/O on a pool of I/O threads: the op runs the blocking
+ * safe_pread()/safe_pwrite()/fsync() on a finisher, then completes
+ * onfinish with the bytes done or -errno. It works on every fs and fd
+ * type, at the cost of one handoff per op.
+ *         ||  io.pread(fd, buf, len, off, new C_ReadDone(...));
+ */
+class file_io {
+private:
+    finisher m_workers;
+
+public:
+    explicit file_io(unsigned threads = 4);
+
+    void pread(int fd, void *buf, size_t len, off_t off, Context *onfinish);
+    void pwrite(int fd, const void *buf, size_t len, off_t off, Context *onfinish);
+    void fsync(int fd, Context *onfinish);
+
+    void wait_for_empty() {
+        m_workers.wait_for_empty();
+    }
+};
+
+} //namespace: spec
+
+#endif //SPEC_FILE_IO_H
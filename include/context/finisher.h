@@ -0,0 +1,139 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_FINISHER_H
+#define SPEC_FINISHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../Context.h"
+#include "completion.h"
+
+namespace spec {
+
+struct finisher_options {
+    unsigned threads = 0;       // 0: one per cpu
+    size_t batch = 32;          // items run before looking at the inbox
+    size_t deque_size = 4096;   // per worker, power of 2
+    bool pin_cpus = false;
+    std::vector<int> cpus;      // pin worker i to cpus[i % n], or cpu i % ncpus
+    bool track_latency = true;
+    std::string name = "finisher";
+
+    finisher_options() = default;
+    finisher_options(unsigned n) : threads(n) {}
+};
+
+/* Thread pool to complete the Contexts and the completions off the thread
+ * which finished the op, e.g. the I/O thread:
+ *         ||  spec::finisher fin({4});
+ *         ||  fin.queue(ctx, r);                       // Context*
+ *         ||  fin.queue([this](int r) { done(r); });   // lambda
+ *         ||  fin.wait_for_empty();
+ *
+ * Every worker owns one Chase-Lev deque and one inbox:
+ *     - queue() from a worker pushes to the bottom of its own deque, it pops
+ *       the bottom, the most recent one is still hot in the cache
+ *     - queue() from the others pushes to the inbox of the workers in turn,
+ *       a lock-free stack linked by completion::next()
+ *     - an idle worker steals from the top of the other deques, or takes
+ *       the whole inbox of a busy worker
+ * A worker takes its inbox, then runs up to "batch" items from its deque
+ * before looking at the inbox again. The workers spin a little, then sleep
+ * until an item is queued to them, or someone wakes an idle one to steal.
+ *
+ * There's no order between the queued items. A Context whose sync_complete()
+ * is true is completed by the caller without being queued.
+ */
+class finisher {
+public:
+    using options = finisher_options;
+
+    struct perf_counters {
+        uint64_t queued = 0;
+        uint64_t completed = 0;
+        uint64_t sync_completed = 0;    // by the sync_complete() fast path
+        uint64_t stolen = 0;
+        uint64_t queue_depth = 0;       // queued - completed
+        uint64_t latency_count = 0;     // from queue() to the start of the run
+        uint64_t latency_sum_ns = 0;
+        uint64_t latency_max_ns = 0;
+
+        uint64_t avg_latency_ns() const {
+            return latency_count ? latency_sum_ns / latency_count : 0;
+        }
+    };
+
+private:
+    struct worker;
+    static thread_local worker *tl_worker;
+
+    const options m_opts;
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::atomic<uint64_t> m_next_worker{0};
+    std::atomic<int> m_sleeping{0};
+    std::atomic<uint64_t> m_sync_completed{0};
+    std::atomic<bool> m_stopping{false};
+    bool m_stopped = false;
+
+    void push(completion *c);
+    void entry(worker& w);
+    bool run_batch(worker& w);
+    bool take_inbox(worker& w, worker& from);
+    void run(worker& w, completion *c);
+    bool has_work() const;
+    void idle(worker& w);
+    void wake(worker& w);
+    void wake_idle();
+
+public:
+    explicit finisher(const options& opts = options());
+    ~finisher();
+
+    finisher(const finisher&) = delete;
+    finisher& operator=(const finisher&) = delete;
+
+    void queue(completion *c, int r = 0);
+
+    void queue(Context *ctx, int r = 0) {
+        if (ctx->sync_complete(r)) {
+            m_sync_completed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue(completion::wrap(ctx), r);
+    }
+
+    template <typename F,
+              typename = std::enable_if_t<std::is_invocable_v<std::decay_t<F>&, int>>>
+    void queue(F&& f, int r = 0) {
+        queue(completion::create(std::forward<F>(f)), r);
+    }
+
+    // wait until everything queued before is completed
+    void wait_for_empty();
+
+    // complete everything queued, then join the workers
+    void stop();
+
+    unsigned num_workers() const {
+        return m_workers.size();
+    }
+
+    perf_counters get_perf() const;
+};
+
+} //namespace: spec
+
+#endif //SPEC_FINISHER_H
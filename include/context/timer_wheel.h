@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_TIMER_WHEEL_H
+#define SPEC_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Context.h"
+#include "../time/utime.h"
+
+namespace spec {
+
+class finisher;
+
+/* Hashed hierarchical timer wheel(Varghese & Lauck) firing Contexts.
+ *
+ * 6 levels of 64 slots, a slot of level n covers 64^n ticks, so the wheel
+ * spans 64^6 ticks(~2 years of 1ms ticks), a later timer is parked in the
+ * last level until it's in range. A timer goes to the level where its
+ * expiry falls, and moves down one level when the wheel reaches its slot.
+ * add() and cancel() are O(1): the timers are nodes of intrusive lists in
+ * chunked storage, the id is the node index with a generation. A bitmap
+ * per level lets the wheel jump over the ticks where nothing fires or
+ * cascades.
+ *
+ * A timer never fires early, and at most one tick late besides the delay
+ * of the driver. All the timers expired in one advance() are completed as
+ * one batch, with 0, outside the lock, inline or by the finisher. cancel()
+ * deletes the Context of a pending timer.
+ *
+ * Driven by its own thread:
+ *         ||  spec::timer_wheel wheel;
+ *         ||  wheel.start();
+ *         ||  auto id = wheel.add_after(500 * 1000000, ctx);   // 500ms
+ *         ||  wheel.cancel(id);
+ * or by an event loop:
+ *         ||  epoll_wait(ep, evs, n, wheel.next_timeout_ms());
+ *         ||  wheel.advance();
+ *
+ * The time is timer_wheel::clock_ns(), the monotonic clock in ns.
+ */
+class timer_wheel {
+public:
+    using timer_id = uint64_t;
+
+    static constexpr unsigned level_bits = 6;
+    static constexpr unsigned level_slots = 1U << level_bits;
+    static constexpr unsigned levels = 6;
+
+private:
+    static constexpr uint32_t nil = UINT32_MAX;
+    static constexpr unsigned chunk_bits = 12;
+
+    struct node {
+        uint64_t expires;       // in ticks
+        Context *ctx;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t gen;
+        uint32_t slot;          // level * level_slots + index, or overdue
+    };
+
+    // the list of the timers added after their tick is processed
+    static constexpr uint32_t overdue = levels * level_slots;
+
+    const uint64_t m_tick_ns;
+    finisher *const m_finisher;
+
+    mutable std::mutex m_lock;
+    uint64_t m_tick;            // the next tick to process
+    uint32_t m_heads[levels * level_slots + 1];
+    uint64_t m_bitmap[levels];
+    std::vector<std::unique_ptr<node[]>> m_chunks;
+    uint32_t m_num_nodes = 0;
+    uint32_t m_free = nil;
+    size_t m_size = 0;
+
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_stopping = false;
+    uint64_t m_wake_tick = UINT64_MAX;
+
+    node& at(uint32_t i) {
+        return m_chunks[i >> chunk_bits][i & ((1U << chunk_bits) - 1)];
+    }
+
+    uint32_t alloc_node();
+    void free_node(uint32_t i);
+    void link(uint32_t i);
+    void unlink(uint32_t i);
+    void cascade(unsigned level, unsigned index);
+    void expire(uint32_t slot, std::vector<Context*>& fired);
+    uint64_t next_tick() const;
+    void advance_locked(uint64_t now_ns, std::vector<Context*>& fired);
+    void fire(std::vector<Context*>& fired);
+    void entry();
+
+public:
+    explicit timer_wheel(uint64_t tick_ns = 1000000, finisher *fin = nullptr);
+    ~timer_wheel();
+
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel& operator=(const timer_wheel&) = delete;
+
+    static uint64_t clock_ns();
+
+    // ctx is completed when clock_ns() >= when_ns
+    timer_id add_at_ns(uint64_t when_ns, Context *ctx);
+
+    timer_id add_after(uint64_t delay_ns, Context *ctx) {
+        return add_at_ns(clock_ns() + delay_ns, ctx);
+    }
+
+    // the deadline in the realtime clock, see spec_clock_now()
+    timer_id add_at(utime_t when, Context *ctx);
+
+    // return false if it's already fired or canceled, else delete the Context
+    bool cancel(timer_id id);
+    void cancel_all();
+
+    // fire the expired timers, return the number of them
+    size_t advance() {
+        return advance_to(clock_ns());
+    }
+    size_t advance_to(uint64_t now_ns);
+
+    // the earliest time a timer may fire, UINT64_MAX if there's none
+    uint64_t next_expiry_ns() const;
+
+    // for poll/epoll: 0 if it's due, -1 if there's no timer
+    int next_timeout_ms() const;
+
+    size_t size() const;
+
+    // run advance() by a dedicated thread
+    void start();
+    void stop();
+};
+
+} //namespace: spec
+
+#endif //SPEC_TIMER_WHEEL_H
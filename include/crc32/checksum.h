@@ -0,0 +1,59 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* checksum algorithms, the value may be persisted: only append new ones */
+enum spec_csum_type {
+    SPEC_CSUM_NONE = 0,
+    SPEC_CSUM_CRC32C = 1,
+    SPEC_CSUM_CRC64 = 2,
+    SPEC_CSUM_XXH64 = 3,
+    SPEC_CSUM_MAX,
+};
+
+/* One entry of the kernel table. The crc kernels dispatch to the
+ * implementation chosen by probe_arch() at the time of the call.
+ *
+ * calc: checksum of one buffer with the given seed, it's the initial value
+ *       for crc and the hash seed for xxh64. "none" always returns 0.
+ * zeros: only for the combinable checksum(crc), calculate as if the buffer
+ *        is zero-filled. With it, the checksum of the concatenation is
+ *        chained by the seed and the cached value can be adjusted to a
+ *        different seed:
+ *            calc(v', buf) = calc(v, buf) ^ zeros(v ^ v', len(buf))
+ */
+struct spec_csum_kernel {
+    const char *name;
+    unsigned digest_size;   // in bytes
+    uint64_t (*calc)(uint64_t seed, unsigned char const *data, unsigned length);
+    uint64_t (*zeros)(uint64_t seed, uint64_t length);
+};
+
+/* return NULL if the type is unknown */
+extern const struct spec_csum_kernel *spec_csum_get_kernel(int type);
+
+/* return -1 if the name is unknown */
+extern int spec_csum_from_name(const char *name);
+
+static inline uint64_t spec_checksum(int type, uint64_t seed,
+                                     unsigned char const *data,
+                                     unsigned length) {
+    const struct spec_csum_kernel *k = spec_csum_get_kernel(type);
+    return k ? k->calc(seed, data, length) : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CHECKSUM_H
@@ -21,7 +21,29 @@ extern crc32c_func_t crc32c_func;
 
 extern crc32c_func_t choose_crc32(void);
 
-/* calculate crc32c for data that is entirely 0 (ZERO) */
+typedef void (*crc32c_multi_func_t)(unsigned char const *const *bufs,
+                                    unsigned const *lens,
+                                    uint32_t *crcs,
+                                    unsigned n);
+
+/* global static to choose batch crc32c implementation on the given architecture. */
+extern crc32c_multi_func_t crc32c_multi_func;
+
+extern crc32c_multi_func_t choose_crc32c_multi(void);
+
+typedef uint32_t (*crc32c_zeros_func_t)(uint32_t crc, unsigned length);
+
+/* global static to choose crc32c zeros implementation on the given architecture. */
+extern crc32c_zeros_func_t crc32c_zeros_func;
+
+extern crc32c_zeros_func_t choose_crc32c_zeros(void);
+
+/* byte-sliced table version, available on every architecture */
+extern uint32_t crc32c_zeros_generic(uint32_t initial_crc, unsigned length);
+
+/* calculate crc32c for data that is entirely 0 (ZERO), the cost is
+ * O(number of bits set in length): one multiply modulo P per bit.
+ */
 uint32_t crc32c_zeros(uint32_t initial_crc, unsigned length);
 
 /* if the data pointer is NULL, we calculate a crc value as if
@@ -35,7 +57,7 @@ static inline uint32_t spec_crc32c(uint32_t crc,
                                   unsigned char const *data,
                                   unsigned length) {
 #ifndef HAVE_POWER8
-    if (!data && length > 16) {
+    if (!data) {
         return crc32c_zeros(crc, length);
     }
 #endif /* !HAVE_POWER8 */
@@ -43,6 +65,21 @@ static inline uint32_t spec_crc32c(uint32_t crc,
     return crc32c_func(crc, data, length);
 }
 
+/* calculate crc32c of n independent buffers in one batch, the streams are
+ * interleaved to hide the latency of crc instruction for small buffers.
+ *
+ * bufs: buffers, NULL means zero-filled buffer as spec_crc32c
+ * lens: length of every buffer
+ * crcs: initial value of every buffer as input, crc32c value as output
+ *   crcs[i] = spec_crc32c(crcs[i], bufs[i], lens[i])
+ */
+static inline void crc32c_multi(unsigned char const *const *bufs,
+                                unsigned const *lens,
+                                uint32_t *crcs,
+                                unsigned n) {
+    crc32c_multi_func(bufs, lens, crcs, n);
+}
+
 #ifdef __cplusplus
 }
 #endif
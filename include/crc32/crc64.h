@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef CRC64_H
+#define CRC64_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* crc64 with the ECMA-182 polynomial in reflected form (0xc96c5795d7870f42),
+ * the same as xz. Like spec_crc32c, there's no pre/post inversion, the
+ * CRC-64/XZ value of the data is:
+ *     ~spec_crc64(~0ULL, data, length)
+ */
+typedef uint64_t (*crc64_func_t)(uint64_t crc,
+                                 unsigned char const *data,
+                                 unsigned length);
+
+/* global static to choose crc64 implementation on the given architecture. */
+extern crc64_func_t crc64_func;
+
+extern crc64_func_t choose_crc64(void);
+
+/* slicing-by-8 table version, available on every architecture */
+extern uint64_t crc64_table(uint64_t crc,
+                            unsigned char const *data,
+                            unsigned length);
+
+/* calculate crc64 for data that is entirely 0 (ZERO) */
+extern uint64_t crc64_zeros(uint64_t initial_crc, uint64_t length);
+
+/* if the data pointer is NULL, we calculate a crc value as if
+ * it were zero-filled.
+ */
+static inline uint64_t spec_crc64(uint64_t crc,
+                                  unsigned char const *data,
+                                  unsigned length) {
+    if (!data) {
+        return crc64_zeros(crc, length);
+    }
+    return crc64_func(crc, data, length);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CRC64_H
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* XXH64, bit-compatible with the reference implementation.
+ *
+ * It's not a crc: the digest of a concatenation can't be derived from the
+ * digests of the parts, so data split into pieces goes through the
+ * streaming state:
+ *         ||  struct spec_xxh64_state st;
+ *         ||  spec_xxh64_reset(&st, seed);
+ *         ||  spec_xxh64_update(&st, p1, len1);
+ *         ||  spec_xxh64_update(&st, p2, len2);
+ *         ||  hash = spec_xxh64_digest(&st);
+ */
+struct spec_xxh64_state {
+    uint64_t total_len;
+    uint64_t v[4];
+    unsigned char mem[32];
+    unsigned memsize;
+    uint64_t seed;
+};
+
+extern uint64_t spec_xxh64(uint64_t seed, void const *data, size_t length);
+
+extern void spec_xxh64_reset(struct spec_xxh64_state *st, uint64_t seed);
+extern void spec_xxh64_update(struct spec_xxh64_state *st,
+                              void const *data, size_t length);
+extern uint64_t spec_xxh64_digest(struct spec_xxh64_state const *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //XXHASH64_H
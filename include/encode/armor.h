@@ -15,9 +15,9 @@ extern "C" {
 uint64_t spec_armor(char *dst, const char *dst_end,
                     const char *src, const char *src_end);
 
-uint64_t spec_armor_linebreak(char *dst, const char *dst_end,
-                              const char *src, const char *src_end,
-                              int line_width);
+uint64_t spec_armor_line_break(char *dst, const char *dst_end,
+                               const char *src, const char *src_end,
+                               int line_width);
 int64_t spec_unarmor(char *dst, const char *dst_end,
                      const char *src, const char *src_end);
 #ifdef __cplusplus
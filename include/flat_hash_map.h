@@ -0,0 +1,549 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_FLAT_HASH_MAP_H
+#define SPEC_FLAT_HASH_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Open-addressing hash map with linear probing.
+ *
+ * All the elements are kept in one flat slot array, there's no per-element
+ * node allocation like std::unordered_map. Every slot has one control byte:
+ *     ctrl_empty: the slot is empty
+ *     0 ~ 127   : the slot is full, it's 7 bits of the element's hash
+ * A lookup loads 16 control bytes starting from the home slot and matches
+ * them with SSE2 at once, the key is only compared on the matched slots.
+ * The first 15 control bytes are cloned after the last one, so the 16
+ * bytes group never wraps.
+ *
+ * Deletion is tombstone-free: the following elements are shifted backward
+ * (backward-shift deletion), so there's no performance degradation after
+ * lots of erase().
+ *
+ * Difference from std::unordered_map:
+ *     1. insert/erase/rehash invalidates all iterators & references.
+ *     2. erase(iterator) returns nothing.
+ */
+
+namespace flat_hash_detail {
+
+typedef int8_t ctrl_t;
+constexpr ctrl_t ctrl_empty = -128;
+constexpr size_t group_width = 16;
+
+// bitmask of matched slots in a group of 16 control bytes
+struct group {
+#ifdef __SSE2__
+    __m128i ctrl;
+
+    explicit group(const ctrl_t *p)
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {
+    }
+
+    uint32_t match(ctrl_t h2) const {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+    }
+
+    // only ctrl_empty has the sign bit
+    uint32_t match_empty() const {
+        return _mm_movemask_epi8(ctrl);
+    }
+#else
+    const ctrl_t *ctrl;
+
+    explicit group(const ctrl_t *p) : ctrl(p) {
+    }
+
+    uint32_t match(ctrl_t h2) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < group_width; ++i) {
+            mask |= (uint32_t)(ctrl[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_empty() const {
+        return match(ctrl_empty);
+    }
+#endif
+};
+
+// std::hash of integer is identity, mix it before using the bits
+inline size_t mix(size_t h) {
+    unsigned __int128 m = (unsigned __int128)h * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(m >> 64) ^ (size_t)m;
+}
+
+} //namespace: flat_hash_detail
+
+template <typename Key, typename T,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Alloc = std::allocator<std::pair<const Key, T>>>
+class flat_hash_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Alloc;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+private:
+    using ctrl_t = flat_hash_detail::ctrl_t;
+    using slot_alloc_t = typename std::allocator_traits<Alloc>::
+                             template rebind_alloc<value_type>;
+    using ctrl_alloc_t = typename std::allocator_traits<Alloc>::
+                             template rebind_alloc<ctrl_t>;
+    using slot_traits = std::allocator_traits<slot_alloc_t>;
+    using ctrl_traits = std::allocator_traits<ctrl_alloc_t>;
+
+    static constexpr size_t group_width = flat_hash_detail::group_width;
+    static constexpr ctrl_t ctrl_empty = flat_hash_detail::ctrl_empty;
+
+    ctrl_t *m_ctrl = nullptr;       // m_capacity + group_width - 1 bytes
+    value_type *m_slots = nullptr;
+    size_t m_capacity = 0;          // 0 or power of 2 >= group_width
+    size_t m_size = 0;
+
+    hasher m_hash;
+    key_equal m_eq;
+    slot_alloc_t m_slot_alloc;
+    ctrl_alloc_t m_ctrl_alloc;
+
+    template <bool is_const>
+    class iterator_base {
+    private:
+        friend class flat_hash_map;
+        template <bool> friend class iterator_base;
+        using map_t = std::conditional_t<is_const, const flat_hash_map,
+                                         flat_hash_map>;
+
+        map_t *m_map = nullptr;
+        size_t m_idx = 0;
+
+        iterator_base(map_t *map, size_t idx) : m_map(map), m_idx(idx) {
+        }
+
+        void skip_empty() {
+            while (m_idx < m_map->m_capacity &&
+                   m_map->m_ctrl[m_idx] == ctrl_empty) {
+                ++m_idx;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = flat_hash_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const value_type*,
+                                           value_type*>;
+        using reference = std::conditional_t<is_const, const value_type&,
+                                             value_type&>;
+
+        iterator_base() = default;
+
+        // iterator -> const_iterator
+        template <bool other_const,
+                  typename = std::enable_if_t<is_const && !other_const>>
+        iterator_base(const iterator_base<other_const>& other)
+            : m_map(other.m_map), m_idx(other.m_idx) {
+        }
+
+        reference operator*() const {
+            return m_map->m_slots[m_idx];
+        }
+
+        pointer operator->() const {
+            return &m_map->m_slots[m_idx];
+        }
+
+        iterator_base& operator++() {
+            ++m_idx;
+            skip_empty();
+            return *this;
+        }
+
+        iterator_base operator++(int) {
+            iterator_base tmp(*this);
+            ++*this;
+            return tmp;
+        }
+
+        template <bool other_const>
+        bool operator==(const iterator_base<other_const>& other) const {
+            return m_idx == other.m_idx;
+        }
+
+        template <bool other_const>
+        bool operator!=(const iterator_base<other_const>& other) const {
+            return m_idx != other.m_idx;
+        }
+    };
+
+public:
+    using iterator = iterator_base<false>;
+    using const_iterator = iterator_base<true>;
+
+    flat_hash_map() = default;
+
+    explicit flat_hash_map(size_t bucket_count) {
+        reserve(bucket_count);
+    }
+
+    flat_hash_map(std::initializer_list<value_type> init) {
+        reserve(init.size());
+        for (const auto& v : init) {
+            insert(v);
+        }
+    }
+
+    flat_hash_map(const flat_hash_map& other)
+        : m_hash(other.m_hash), m_eq(other.m_eq) {
+        reserve(other.m_size);
+        for (const auto& v : other) {
+            insert_unique(hash_of(v.first), v);
+        }
+    }
+
+    flat_hash_map(flat_hash_map&& other) noexcept {
+        swap(other);
+    }
+
+    ~flat_hash_map() {
+        destroy_all();
+        deallocate(m_ctrl, m_slots, m_capacity);
+    }
+
+    flat_hash_map& operator=(const flat_hash_map& other) {
+        if (this != &other) {
+            flat_hash_map tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    flat_hash_map& operator=(flat_hash_map&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(flat_hash_map& other) noexcept {
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_eq, other.m_eq);
+    }
+
+    iterator begin() {
+        iterator it(this, 0);
+        it.skip_empty();
+        return it;
+    }
+    const_iterator begin() const {
+        const_iterator it(this, 0);
+        it.skip_empty();
+        return it;
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    iterator end() {
+        return iterator(this, m_capacity);
+    }
+    const_iterator end() const {
+        return const_iterator(this, m_capacity);
+    }
+    const_iterator cend() const {
+        return end();
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+    size_t size() const {
+        return m_size;
+    }
+    size_t bucket_count() const {
+        return m_capacity;
+    }
+    float load_factor() const {
+        return m_capacity ? (float)m_size / (float)m_capacity : 0.0f;
+    }
+    allocator_type get_allocator() const {
+        return allocator_type(m_slot_alloc);
+    }
+
+    void clear() {
+        destroy_all();
+        if (m_capacity) {
+            std::fill_n(m_ctrl, m_capacity + group_width - 1, ctrl_empty);
+        }
+        m_size = 0;
+    }
+
+    // make room for n elements without rehashing
+    void reserve(size_t n) {
+        size_t cap = group_width;
+        while (cap - cap / 8 < n) {
+            cap <<= 1;
+        }
+        if (cap > m_capacity) {
+            resize(cap);
+        }
+    }
+
+    void rehash(size_t n) {
+        reserve(n > m_size ? n : m_size);
+    }
+
+    iterator find(const Key& key) {
+        return iterator(this, find_index(key, hash_of(key)));
+    }
+    const_iterator find(const Key& key) const {
+        return const_iterator(this, find_index(key, hash_of(key)));
+    }
+
+    size_t count(const Key& key) const {
+        return find_index(key, hash_of(key)) != m_capacity;
+    }
+    bool contains(const Key& key) const {
+        return count(key);
+    }
+
+    T& at(const Key& key) {
+        size_t i = find_index(key, hash_of(key));
+        if (i == m_capacity) {
+            throw std::out_of_range("flat_hash_map::at");
+        }
+        return m_slots[i].second;
+    }
+    const T& at(const Key& key) const {
+        return const_cast<flat_hash_map*>(this)->at(key);
+    }
+
+    T& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+    T& operator[](Key&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        size_t h = hash_of(key);
+        size_t i = find_index(key, h);
+        if (i != m_capacity) {
+            return {iterator(this, i), false};
+        }
+        i = insert_unique(h, std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<K>(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+        return {iterator(this, i), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& v) {
+        return emplace_value(v);
+    }
+    std::pair<iterator, bool> insert(value_type&& v) {
+        return emplace_value(std::move(v));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return emplace_value(value_type(std::forward<Args>(args)...));
+    }
+
+    size_t erase(const Key& key) {
+        size_t i = find_index(key, hash_of(key));
+        if (i == m_capacity) {
+            return 0;
+        }
+        erase_slot(i);
+        return 1;
+    }
+
+    void erase(const_iterator pos) {
+        erase_slot(pos.m_idx);
+    }
+
+private:
+    size_t hash_of(const Key& key) const {
+        return flat_hash_detail::mix(m_hash(key));
+    }
+
+    static ctrl_t h2(size_t h) {
+        return (ctrl_t)(h & 0x7f);
+    }
+
+    size_t h1(size_t h) const {
+        return (h >> 7) & (m_capacity - 1);
+    }
+
+    void set_ctrl(size_t i, ctrl_t c) {
+        m_ctrl[i] = c;
+        if (i < group_width - 1) {
+            m_ctrl[m_capacity + i] = c;
+        }
+    }
+
+    // return m_capacity if it's not found
+    size_t find_index(const Key& key, size_t h) const {
+        if (!m_size) {
+            return m_capacity;
+        }
+
+        const size_t mask = m_capacity - 1;
+        const ctrl_t tag = h2(h);
+        size_t pos = h1(h);
+        for (;;) {
+            flat_hash_detail::group g(m_ctrl + pos);
+            for (uint32_t m = g.match(tag); m; m &= m - 1) {
+                size_t i = (pos + __builtin_ctz(m)) & mask;
+                if (m_eq(m_slots[i].first, key)) {
+                    return i;
+                }
+            }
+            /* The elements between home slot and the element are all
+             * full, meeting an empty slot means it doesn't exist.
+             */
+            if (g.match_empty()) {
+                return m_capacity;
+            }
+            pos = (pos + group_width) & mask;
+        }
+    }
+
+    // the first empty slot from the home slot
+    size_t find_empty(size_t h) const {
+        const size_t mask = m_capacity - 1;
+        size_t pos = h1(h);
+        for (;;) {
+            uint32_t m = flat_hash_detail::group(m_ctrl + pos).match_empty();
+            if (m) {
+                return (pos + __builtin_ctz(m)) & mask;
+            }
+            pos = (pos + group_width) & mask;
+        }
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> emplace_value(V&& v) {
+        size_t h = hash_of(v.first);
+        size_t i = find_index(v.first, h);
+        if (i != m_capacity) {
+            return {iterator(this, i), false};
+        }
+        i = insert_unique(h, std::forward<V>(v));
+        return {iterator(this, i), true};
+    }
+
+    // the key must not exist
+    template <typename... Args>
+    size_t insert_unique(size_t h, Args&&... args) {
+        // max load factor: 7/8
+        if (m_size + 1 > m_capacity - m_capacity / 8) {
+            resize(m_capacity ? m_capacity * 2 : group_width);
+        }
+        size_t i = find_empty(h);
+        slot_traits::construct(m_slot_alloc, &m_slots[i],
+                               std::forward<Args>(args)...);
+        set_ctrl(i, h2(h));
+        ++m_size;
+        return i;
+    }
+
+    void erase_slot(size_t i) {
+        const size_t mask = m_capacity - 1;
+        slot_traits::destroy(m_slot_alloc, &m_slots[i]);
+
+        /* Backward-shift deletion: shift the following element into the
+         * hole if the hole is still in [home slot, current slot) of the
+         * element, until meeting an empty slot.
+         */
+        for (size_t j = (i + 1) & mask; m_ctrl[j] != ctrl_empty;
+             j = (j + 1) & mask) {
+            size_t home = h1(hash_of(m_slots[j].first));
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slot_traits::construct(m_slot_alloc, &m_slots[i],
+                                       std::move(m_slots[j]));
+                slot_traits::destroy(m_slot_alloc, &m_slots[j]);
+                set_ctrl(i, m_ctrl[j]);
+                i = j;
+            }
+        }
+        set_ctrl(i, ctrl_empty);
+        --m_size;
+    }
+
+    void resize(size_t new_capacity) {
+        ctrl_t *old_ctrl = m_ctrl;
+        value_type *old_slots = m_slots;
+        size_t old_capacity = m_capacity;
+
+        m_ctrl = ctrl_traits::allocate(m_ctrl_alloc,
+                                       new_capacity + group_width - 1);
+        m_slots = slot_traits::allocate(m_slot_alloc, new_capacity);
+        m_capacity = new_capacity;
+        std::fill_n(m_ctrl, new_capacity + group_width - 1, ctrl_empty);
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] == ctrl_empty) {
+                continue;
+            }
+            size_t h = hash_of(old_slots[i].first);
+            size_t j = find_empty(h);
+            slot_traits::construct(m_slot_alloc, &m_slots[j],
+                                   std::move(old_slots[i]));
+            slot_traits::destroy(m_slot_alloc, &old_slots[i]);
+            set_ctrl(j, h2(h));
+        }
+        deallocate(old_ctrl, old_slots, old_capacity);
+    }
+
+    void destroy_all() {
+        if (std::is_trivially_destructible<value_type>::value) {
+            return;
+        }
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_ctrl[i] != ctrl_empty) {
+                slot_traits::destroy(m_slot_alloc, &m_slots[i]);
+            }
+        }
+    }
+
+    void deallocate(ctrl_t *ctrl, value_type *slots, size_t capacity) {
+        if (capacity) {
+            ctrl_traits::deallocate(m_ctrl_alloc, ctrl,
+                                    capacity + group_width - 1);
+            slot_traits::deallocate(m_slot_alloc, slots, capacity);
+        }
+    }
+};
+
+#endif //SPEC_FLAT_HASH_MAP_H
@@ -0,0 +1,165 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_MEMPOOL_ARENA_H
+#define SPEC_MEMPOOL_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../spec_atomic.h"
+#include "../compiler/likely.h"
+
+/* Request-scoped bump-pointer arena.
+ *
+ * One replicated write builds several buffer::list, ptr_node and small raw
+ * objects which all die together when the op completes. Installing an
+ * arena_scope makes the current thread take these allocations from a
+ * bump-pointer arena instead of malloc:
+ *     ptr_node objects, raw_combined::create() and mempool containers.
+ *
+ *         ||  {
+ *         ||      mempool::arena_scope scope;
+ *         ||      buffer_list bl;
+ *         ||      bl.append(...);   // ptr_node & raw_combined from arena
+ *         ||  }                     // all arena pages recycled in O(1)
+ *
+ * The arena is built from fixed-size pages(arena_page_size) carved from
+ * one reserved virtual region, so "does this pointer belong to an arena"
+ * is two compares. Free pages are kept in a global pool.
+ *
+ * Escaping:
+ *     Every arena allocation holds a reference of its arena. If anything
+ *     allocated in the scope is still alive at the end of the scope(e.g.
+ *     claimed into the cache), the escape is counted and the pages stay
+ *     pinned until the last escaped object is freed, so it's never
+ *     a dangling pointer. Use buffer::list::unshare_arena() to copy the
+ *     escaping data out and unpin the pages early.
+ */
+
+namespace mempool {
+
+enum {
+    arena_page_size = 64 * 1024,
+    arena_region_size = 1024 * 1024 * 1024,
+};
+
+class arena;
+
+extern thread_local arena *current_arena;
+
+/* The start of the reserved region of arena_region_size bytes, nullptr
+ * until the first arena. Published once with release.
+ */
+extern spec::atomic<char*> arena_region_begin;
+
+class arena {
+private:
+    // header at the beginning of every arena page
+    struct page {
+        page *next;
+        arena *owner;
+    };
+
+    page *head;             // the page holding this arena object
+    page *tail;
+    char *pos, *end;        // bump pointer in tail page
+
+    /* One reference for the scope plus one reference for every
+     * allocation that is still alive.
+     */
+    spec::atomic<size_t> nref{1};
+
+    arena(page *first, char *pos, char *end)
+        : head(first), tail(first), pos(pos), end(end) {
+    }
+
+    bool refill();
+    void put();
+
+public:
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    static arena* create();
+
+    // nullptr when the request can't be served from one arena page
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    // the end of the request scope, recycle the pages if nothing escaped
+    void end_scope();
+
+    static bool contains(const void *p) {
+        const char *begin = arena_region_begin.load(std::memory_order_acquire);
+        return begin && (const char*)p >= begin &&
+               (const char*)p < begin + arena_region_size;
+    }
+
+    static arena* owner_of(const void *p);
+
+    // drop the reference held by one arena allocation
+    static void release(const void *p) {
+        owner_of(p)->put();
+    }
+
+    // current thread's arena, nullptr if no arena_scope is installed
+    static arena* current() {
+        return current_arena;
+    }
+};
+
+class arena_scope {
+private:
+    arena *m_arena;
+    arena *m_prev;
+
+public:
+    arena_scope() : m_arena(arena::create()), m_prev(current_arena) {
+        current_arena = m_arena;
+    }
+
+    ~arena_scope() {
+        current_arena = m_prev;
+        if (m_arena) {
+            m_arena->end_scope();
+        }
+    }
+
+    arena_scope(const arena_scope&) = delete;
+    arena_scope& operator=(const arena_scope&) = delete;
+
+    // nullptr if the page pool is exhausted, the heap is used then
+    arena* get() const {
+        return m_arena;
+    }
+};
+
+// suspend the current thread's arena, e.g. to copy data out of arena
+class arena_bypass {
+private:
+    arena *m_prev;
+
+public:
+    arena_bypass() : m_prev(current_arena) {
+        current_arena = nullptr;
+    }
+
+    ~arena_bypass() {
+        current_arena = m_prev;
+    }
+
+    arena_bypass(const arena_bypass&) = delete;
+    arena_bypass& operator=(const arena_bypass&) = delete;
+};
+
+// number of pages taken out of the pool
+extern size_t get_arena_pages_in_use();
+
+// number of scopes ended with live allocations
+extern uint64_t get_arena_escaped_scopes();
+
+} //namespace: mempool
+
+#endif //SPEC_MEMPOOL_ARENA_H
@@ -13,10 +13,15 @@
 #include <mutex>
 #include <typeinfo>
 
+#include <boost/container/flat_map.hpp>
+
 #include "spec_assert/spec_assert.h"
 #include "spec_atomic.h"
 #include "compact_map.h"
 #include "compact_set.h"
+#include "flat_hash_map.h"
+#include "mempool_profiler.h"
+#include "arena.h"
 
 /* A memory pool is used to audit the memory usage of inner & struct &
  * & class & template-paratermized type.
@@ -34,6 +39,8 @@
  *        mempool::foo::map
  *        mempool::foo::multimap
  *        mempool::foo::unordered_map
+ *        mempool::foo::flat_hash_map
+ *        mempool::foo::flat_map
  *        mempool::foo::set
  *        mempool::foo::multiset
  *        mempool::foo::list
@@ -66,6 +73,19 @@
  *         ||  size_t bytes = mempool::foo::allocated_bytes();
  *         ||  size_t items = mempool::foo::allocated_items();
  *     The runtime complexity is O(num_shards);
+ *
+ *     The result may miss the pending per-thread deltas of other threads,
+ *     see thread_delta_max_bytes.
+ *
+ *  2. Find out which call sites hold the memory:
+ *         ||  mempool::profiler::start(sample_period);
+ *     See mempool_profiler.h
+ *
+ * Request-scoped allocation
+ * -------------------------
+ *  When a mempool::arena_scope is installed on the current thread, the
+ *  allocations are served from the bump-pointer arena. The pool accounting
+ *  is the same as heap allocation. See arena.h
  */
 
 namespace mempool {
@@ -101,6 +121,11 @@ struct shard_t {
 } __attribute__ ((aligned (128)));
 static_assert(sizeof(shard_t) == 128, "shard_t should be cacheline-sized");
 
+/* shards in use - 1, sized by the cpus(cpu_topology::mempool_shards). It's 0
+ * until initialized, the counts of static initialization go to shard 0.
+ */
+extern size_t shard_mask;
+
 
 struct type_info_hash {
     std::size_t operator()(const std::type_info& key) const {
@@ -114,6 +139,57 @@ struct object_attr {
     spec::atomic<ssize_t> object_items{0};
 };
 
+/* pool_allocator doesn't touch the shared shards on every call. The
+ * allocated bytes/items are accumulated in the per-thread deltas, and only
+ * folded into the shards when the delta is beyond the threshold or the
+ * thread exits. So allocated_bytes()/allocated_items() of a pool may miss
+ * at most (thread_delta_max_bytes/items) of every other thread, the
+ * calling thread's own delta is always counted.
+ */
+enum {
+    thread_delta_max_bytes = 64 * 1024,
+    thread_delta_max_items = 1024,
+};
+
+struct pool_delta {
+    ssize_t items;
+    ssize_t bytes;
+};
+
+extern thread_local pool_delta thread_pool_delta[num_pools];
+
+enum thread_delta_state_t : uint8_t {
+    thread_delta_unregistered = 0,
+    thread_delta_registered,
+    thread_delta_exited,        // thread exit flushing is done
+};
+
+extern thread_local uint8_t thread_delta_state;
+
+// slow path: register the thread exit flushing or fold into the shards
+extern void add_thread_pool_delta_slow(pool_type_id pool_index,
+                                       ssize_t items, ssize_t bytes);
+
+// fold the calling thread's deltas into the shards
+extern void flush_thread_pool_delta();
+
+inline void add_thread_pool_delta(pool_type_id pool_index,
+                                  ssize_t items, ssize_t bytes) {
+    pool_delta& d = thread_pool_delta[pool_index];
+    if (unlikely(thread_delta_state != thread_delta_registered)) {
+        add_thread_pool_delta_slow(pool_index, items, bytes);
+        return;
+    }
+    d.items += items;
+    d.bytes += bytes;
+    if (unlikely(d.bytes > thread_delta_max_bytes ||
+                 d.bytes < -thread_delta_max_bytes ||
+                 d.items > thread_delta_max_items ||
+                 d.items < -thread_delta_max_items)) {
+        flush_thread_pool_delta();
+    }
+}
+
 class pool_type {
 private:
     shard_t shard[num_shards];
@@ -122,14 +198,16 @@ private:
     std::unordered_map<const char *, object_attr> object_type_map;
 
 public:
+    pool_type_id get_id() const;
+
     shard_t* pick_a_shard() {
       auto shard_map = (size_t)pthread_self();
-      shard_map = (shard_map >> 3) & ((int)(num_shards) - 1);
+      shard_map = (shard_map >> 3) & shard_mask;
       return &shard[shard_map];
     }
 
     size_t allocated_bytes() const {
-        ssize_t result = 0;
+        ssize_t result = thread_pool_delta[get_id()].bytes;
         for (size_t i = 0; i < num_shards; ++i) {
             result += shard[i].allocated_bytes;
         }
@@ -142,7 +220,7 @@ public:
     }
 
     size_t allocated_items() const {
-        ssize_t result = 0;
+        ssize_t result = thread_pool_delta[get_id()].items;
         for (size_t i = 0; i < num_shards; ++i) {
             result += shard[i].allocated_items;
         }
@@ -160,6 +238,14 @@ public:
         shard->allocated_bytes += adjust_allocated_bytes;
     }
 
+    // items of every tracked type, types are only tracked in debug mode
+    void get_type_items(std::vector<std::pair<const char*, ssize_t>>& items) const {
+        std::lock_guard<std::mutex> lk(lock);
+        for (const auto& p : object_type_map) {
+            items.emplace_back(p.second.type_name, p.second.object_items.load());
+        }
+    }
+
     object_attr *get_type(const std::type_info& ti, size_t item_size) {
         std::lock_guard<std::mutex> lk(lock);
 
@@ -220,61 +306,76 @@ public:
 
     T* allocate(size_t n) {
         size_t allocating_size = sizeof(T) * n;
-        T* r = reinterpret_cast<T*>(new char[allocating_size]);
+        T* r = nullptr;
+        if (arena *a = arena::current()) {
+            r = reinterpret_cast<T*>(a->allocate(allocating_size, alignof(T)));
+        }
+        if (!r) {
+            r = reinterpret_cast<T*>(new char[allocating_size]);
+        }
 
-        shard_t *shard = pool->pick_a_shard();
-        shard->allocated_bytes += allocating_size;
-        shard->allocated_items += n;
+        add_thread_pool_delta(pool_index, n, allocating_size);
         if (type) {
             type->object_items += n;
         }
+        MEMPOOL_PROFILE_ALLOC(r, allocating_size);
         return r;
     }
 
     void deallocate(T* p, size_t n) {
         size_t releasing_size = sizeof(T) * n;
 
-        shard_t *shard = pool->pick_a_shard();
-        shard->allocated_bytes -= releasing_size;
-        shard->allocated_items -= n;
+        add_thread_pool_delta(pool_index, -(ssize_t)n, -(ssize_t)releasing_size);
         if (type) {
           type->object_items -= n;
         }
+        MEMPOOL_PROFILE_FREE(p);
 
-        delete[] reinterpret_cast<char*>(p);
+        if (arena::contains(p)) {
+            arena::release(p);
+        } else {
+            delete[] reinterpret_cast<char*>(p);
+        }
     }
 
     T* allocate_aligned(size_t n, size_t align) {
         size_t allocating_size = sizeof(T) * n;
 
-        char *ptr;
-        int rc = ::posix_memalign((void**)(void*)&ptr, align, allocating_size);
-        if (rc) {
-          throw std::bad_alloc();
+        char *ptr = nullptr;
+        if (arena *a = arena::current()) {
+          ptr = (char*)a->allocate(allocating_size, align);
+        }
+        if (!ptr) {
+          int rc = ::posix_memalign((void**)(void*)&ptr, align, allocating_size);
+          if (rc) {
+            throw std::bad_alloc();
+          }
         }
 
-        shard_t *shard = pool->pick_a_shard();
-        shard->allocated_bytes += allocating_size;
-        shard->allocated_items += n;
+        add_thread_pool_delta(pool_index, n, allocating_size);
         if (type) {
           type->object_items += n;
         }
 
         T* r = reinterpret_cast<T*>(ptr);
+        MEMPOOL_PROFILE_ALLOC(r, allocating_size);
         return r;
     }
 
     void deallocate_aligned(T* p, size_t n) {
         size_t releasing_size = sizeof(T) * n;
 
-        shard_t *shard = pool->pick_a_shard();
-        shard->allocated_bytes -= releasing_size;
-        shard->allocated_items -= n;
+        add_thread_pool_delta(pool_index, -(ssize_t)n, -(ssize_t)releasing_size);
         if (type) {
           type->object_items -= n;
         }
+        MEMPOOL_PROFILE_FREE(p);
 
-        ::free(p);
+        if (arena::contains(p)) {
+          arena::release(p);
+        } else {
+          ::free(p);
+        }
     }
 
     void destroy(T* p) {
@@ -338,6 +439,15 @@ namespace x {
     using unordered_map = std::unordered_map<key, value, h, eq,                   \
                                   pool_allocator<std::pair<const key, value>>>;   \
                                                                                   \
+    template<typename key, typename value, typename h = std::hash<key>,           \
+             typename eq = std::equal_to<key>>                                    \
+    using flat_hash_map = flat_hash_map<key, value, h, eq,                        \
+                                  pool_allocator<std::pair<const key, value>>>;   \
+                                                                                  \
+    template<typename key, typename value, typename cmp = std::less<key>>         \
+    using flat_map = boost::container::flat_map<key, value, cmp,                  \
+                                  pool_allocator<std::pair<key, value>>>;         \
+                                                                                  \
     template<typename key, typename cmp = std::less<key>>                         \
     using set = std::set<key, cmp, pool_allocator<key>>;                          \
                                                                                   \
@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_MEMPOOL_PROFILER_H
+#define SPEC_MEMPOOL_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+
+#include "../compiler/likely.h"
+
+/* Sampling allocation profiler for mempool.
+ *
+ * When it's started, one allocation is sampled for every "sample_period"
+ * bytes allocated on average(poisson sampling, same as tcmalloc). A sampled
+ * allocation records its call stack and stays in the live-sample table
+ * until it's freed, so the table always describes who holds the memory
+ * right now.
+ *
+ * The hooks are placed in mempool::pool_allocator and buffer::raw. When
+ * the profiler isn't started, the only cost in the hooks is one relaxed
+ * load of mempool::profiler::sampling and a predictable branch.
+ *
+ *         ||  mempool::profiler::start(512 * 1024);
+ *         ||  ...
+ *         ||  mempool::profiler::dump_folded(std::cout); // flamegraph.pl
+ *         ||  mempool::profiler::dump_pprof(ofs);        // pprof heap_v2
+ *         ||  mempool::profiler::stop();
+ */
+
+namespace mempool {
+
+namespace profiler {
+
+// fast path switch, only stored by start() and stop()
+extern std::atomic<bool> sampling;
+
+extern void record_alloc(const void *addr, size_t bytes);
+extern void record_free(const void *addr);
+
+// start sampling one allocation per sample_period bytes on average
+extern void start(size_t sample_period = 512 * 1024);
+
+// stop sampling and drop all the live samples
+extern void stop();
+
+extern size_t get_sample_period();
+
+// number of live samples and their estimated(unsampled) bytes
+extern size_t get_live_samples();
+extern size_t get_live_estimated_bytes();
+
+/* Brendan Gregg's folded stack format, root frame first:
+ *     main;foo;mempool::pool_allocator<...>::allocate 1048576
+ * The value is the estimated live bytes of the stack.
+ */
+extern void dump_folded(std::ostream& out);
+
+/* gperftools legacy heap profile(heap_v2) which is accepted by pprof.
+ * The values are the raw sampled counts, pprof does the unsampling
+ * from the sample period recorded in the header.
+ */
+extern void dump_pprof(std::ostream& out);
+
+} //namespace: profiler
+
+} //namespace: mempool
+
+#define MEMPOOL_PROFILE_ALLOC(addr, bytes)                          \
+    do {                                                            \
+        if (unlikely(mempool::profiler::sampling.load(              \
+                std::memory_order_relaxed))) {                      \
+            mempool::profiler::record_alloc((addr), (bytes));       \
+        }                                                           \
+    } while (0)
+
+#define MEMPOOL_PROFILE_FREE(addr)                                  \
+    do {                                                            \
+        if (unlikely(mempool::profiler::sampling.load(              \
+                std::memory_order_relaxed))) {                      \
+            mempool::profiler::record_free((addr));                 \
+        }                                                           \
+    } while (0)
+
+#endif //SPEC_MEMPOOL_PROFILER_H
@@ -7,6 +7,8 @@
 #define SPEC_BACKTRACE_H
 
 #include <iosfwd>
+#include <string>
+#include <string.h>
 #include <execinfo.h>
 #include <stdlib.h>
 
@@ -25,6 +27,13 @@ public:
         size = backtrace(array, max);
         strings = backtrace_symbols(array, size);
     }
+
+    // symbolize frames which were captured earlier by ::backtrace()
+    BackTrace(void * const *frames, size_t n, int s = 0) : skip(s) {
+        size = n < (size_t)max ? n : (size_t)max;
+        memcpy(array, frames, size * sizeof(void *));
+        strings = backtrace_symbols(array, size);
+    }
     ~BackTrace() {
         free(strings);
     }
@@ -33,6 +42,9 @@ public:
     const BackTrace& operator=(const BackTrace& other);
 
     void print(std::ostream& out) const;
+
+    // demangled function name of frame i, without the offset part
+    std::string function_name(size_t i) const;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const BackTrace& bt) {
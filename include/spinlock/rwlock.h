@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "spinlock.h"
+
+namespace spec {
+
+/* Reader-writer spinlock for the read-mostly data. The reader count is
+ * split into cache-line sized slots, one per cpu: a reader only bumps
+ * the slot of its thread and checks the writer flag, so the readers on
+ * different cpus never share a line. The writer raises the flag, then
+ * waits for every slot to drain, which makes the write side O(cpus):
+ * it's for data written once in a while.
+ *
+ * The slot of a thread is picked round-robin when it first reads, not
+ * by sched_getcpu(): the reader may migrate before it unlocks, and the
+ * unlock must hit the same slot.
+ *
+ * The writers are preferred, a reader backs off while the flag is up.
+ * It meets SharedMutex, so std::shared_lock/std::unique_lock work:
+ *         ||  spec::rw_spinlock lock;
+ *         ||  {
+ *         ||      spec::rw_spinlock::read_guard rg(lock);
+ *         ||      ...
+ *         ||  }
+ */
+class rw_spinlock {
+private:
+    struct alignas(64) slot {
+        std::atomic<uint32_t> readers{0};
+    };
+
+    std::unique_ptr<slot[]> m_slots;
+    unsigned m_mask;
+    alignas(64) std::atomic<bool> m_writer{false};
+    spinlock m_write_lock;
+
+    static unsigned thread_slot() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned idx = next.fetch_add(1, std::memory_order_relaxed);
+        return idx;
+    }
+
+    static unsigned num_slots() {
+        unsigned n = 1;
+        while (n < std::thread::hardware_concurrency()) {
+            n <<= 1;
+        }
+        return n;
+    }
+
+public:
+    using read_guard = std::shared_lock<rw_spinlock>;
+    using write_guard = std::unique_lock<rw_spinlock>;
+
+    rw_spinlock() : m_slots(new slot[num_slots()]), m_mask(num_slots() - 1) {}
+
+    rw_spinlock(const rw_spinlock&) = delete;
+    rw_spinlock& operator=(const rw_spinlock&) = delete;
+
+    void lock_shared() {
+        std::atomic<uint32_t>& readers = m_slots[thread_slot() & m_mask].readers;
+        spin_backoff<64> backoff;
+        while (true) {
+            // seq_cst pairs with lock(): either the writer sees the reader,
+            // or the reader sees the writer
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            if (!m_writer.load(std::memory_order_seq_cst)) {
+                return;
+            }
+            readers.fetch_sub(1, std::memory_order_release);
+            while (m_writer.load(std::memory_order_relaxed)) {
+                backoff.pause();
+            }
+        }
+    }
+
+    bool try_lock_shared() {
+        std::atomic<uint32_t>& readers = m_slots[thread_slot() & m_mask].readers;
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        if (!m_writer.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        readers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    void unlock_shared() {
+        m_slots[thread_slot() & m_mask].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    void lock() {
+        m_write_lock.lock();
+        m_writer.store(true, std::memory_order_seq_cst);
+        spin_backoff<64> backoff;
+        for (unsigned i = 0; i <= m_mask; ++i) {
+            while (m_slots[i].readers.load(std::memory_order_seq_cst)) {
+                backoff.pause();
+            }
+        }
+    }
+
+    bool try_lock() {
+        if (!m_write_lock.try_lock()) {
+            return false;
+        }
+        m_writer.store(true, std::memory_order_seq_cst);
+        for (unsigned i = 0; i <= m_mask; ++i) {
+            if (m_slots[i].readers.load(std::memory_order_seq_cst)) {
+                unlock();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void unlock() {
+        m_writer.store(false, std::memory_order_release);
+        m_write_lock.unlock();
+    }
+};
+
+} //namespace spec
+
+#endif //RWLOCK_H
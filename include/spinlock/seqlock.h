@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+#include "spinlock.h"
+
+namespace spec {
+
+/* A small trivially copyable value which is read much more often than
+ * it's written. The readers never write the shared line: they copy the
+ * value and retry if a writer got in between, so they don't block each
+ * other nor the writer. The writers are serialized by a spinlock.
+ *         ||  spec::seqlock<extent_hdr> hdr;
+ *         ||  extent_hdr h = hdr.load();
+ *         ||  {
+ *         ||      spec::seqlock<extent_hdr>::write_guard w(hdr);
+ *         ||      w->len += n;
+ *         ||  }
+ *
+ * The value is kept in relaxed atomic words, so a torn copy is never
+ * observed as a data race, only thrown away. Keep it to a few words: the
+ * readers copy all of it, and retry the whole copy.
+ */
+template <typename T>
+class seqlock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "seqlock value must be trivially copyable");
+
+private:
+    static constexpr size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> m_seq{0};     // odd while a write is in progress
+    spinlock m_write_lock;
+    std::atomic<uint64_t> m_words[words];
+
+    void copy_out(T *val) const {
+        uint64_t buf[words];
+        for (size_t i = 0; i < words; ++i) {
+            buf[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        memcpy(static_cast<void*>(val), buf, sizeof(T));
+    }
+
+    // with m_write_lock held
+    void publish(const T& val) {
+        uint64_t buf[words] = {0};
+        memcpy(buf, &val, sizeof(T));
+        uint32_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < words; ++i) {
+            m_words[i].store(buf[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+public:
+    explicit seqlock(const T& val = T()) {
+        uint64_t buf[words] = {0};
+        memcpy(buf, &val, sizeof(T));
+        for (size_t i = 0; i < words; ++i) {
+            m_words[i].store(buf[i], std::memory_order_relaxed);
+        }
+    }
+
+    seqlock(const seqlock&) = delete;
+    seqlock& operator=(const seqlock&) = delete;
+
+    T load() const {
+        T val;
+        spin_backoff<64> backoff;
+        while (true) {
+            uint32_t seq = m_seq.load(std::memory_order_acquire);
+            if (!(seq & 1)) {
+                copy_out(&val);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_seq.load(std::memory_order_relaxed) == seq) {
+                    return val;
+                }
+            }
+            backoff.pause();
+        }
+    }
+
+    void store(const T& val) {
+        std::lock_guard lk(m_write_lock);
+        publish(val);
+    }
+
+    // read-modify-write: f(T&) updates a copy which is published after
+    template <typename F>
+    void update(F&& f) {
+        std::lock_guard lk(m_write_lock);
+        T val;
+        copy_out(&val);
+        f(val);
+        publish(val);
+    }
+
+    // holds off the other writers, publishes the copy when it goes away
+    class write_guard {
+    private:
+        seqlock& m_lock;
+        T m_val;
+
+    public:
+        explicit write_guard(seqlock& lock) : m_lock(lock) {
+            m_lock.m_write_lock.lock();
+            m_lock.copy_out(&m_val);
+        }
+
+        ~write_guard() {
+            m_lock.publish(m_val);
+            m_lock.m_write_lock.unlock();
+        }
+
+        write_guard(const write_guard&) = delete;
+        write_guard& operator=(const write_guard&) = delete;
+
+        T& operator*() {
+            return m_val;
+        }
+
+        T* operator->() {
+            return &m_val;
+        }
+    };
+};
+
+} //namespace spec
+
+#endif //SEQLOCK_H
@@ -6,13 +6,120 @@
 #ifndef SPINLOCK_H
 #define SPINLOCK_H
 
+#include <sched.h>
+#include <stdint.h>
+
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#ifdef SPINLOCK_STATS
+#include <chrono>
+#endif
+
+/* Spinlocks for the short critical sections, e.g. the raw crc cache.
+ *
+ *     spinlock            test-and-test-and-set, the cheapest one
+ *     ticket_spinlock     FIFO: the waiters are served in order
+ *     mcs_spinlock        FIFO and every waiter spins on its own line
+ *
+ * The waiters PAUSE with exponential backoff, so they don't saturate the
+ * line and leave the pipeline to the SMT sibling. With YieldAfter > 0 a
+ * waiter yields the cpu after that many backoff rounds, for locks which
+ * may be held by a preempted thread. All of them are BasicLockable.
+ *
+ * Build with SPINLOCK_STATS to count the contention of every lock, see
+ * spinlock_stats. It isn't free, the clock is read on contention.
+ */
 
 namespace spec {
 
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+template <unsigned YieldAfter = 0>
+class spin_backoff {
+private:
+    static constexpr unsigned max_pauses = 64;
+    unsigned m_pauses = 1;
+    unsigned m_rounds = 0;
+
+public:
+    void pause(unsigned scale = 1) {
+        ++m_rounds;
+        if (YieldAfter && m_rounds > YieldAfter) {
+            sched_yield();
+            return;
+        }
+        for (unsigned i = 0; i < m_pauses * scale; ++i) {
+            cpu_relax();
+        }
+        m_pauses = std::min(m_pauses * 2, max_pauses);
+    }
+
+    unsigned rounds() const {
+        return m_rounds;
+    }
+};
+
+struct spinlock_stats {
+    uint64_t acquires = 0;
+    uint64_t contended = 0;         // acquires which had to wait
+    uint64_t spins = 0;             // backoff rounds
+    uint64_t max_wait_ns = 0;
+};
+
+#ifdef SPINLOCK_STATS
+// updated by the holder, protected by the lock itself
+class spinlock_counter {
+private:
+    spinlock_stats m_stats;
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    static clock::time_point now() {
+        return clock::now();
+    }
+
+    void acquired(unsigned rounds, clock::time_point start) {
+        m_stats.acquires++;
+        if (rounds) {
+            m_stats.contended++;
+            m_stats.spins += rounds;
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - start).count();
+            m_stats.max_wait_ns = std::max(m_stats.max_wait_ns, ns);
+        }
+    }
+
+    void acquired() {
+        m_stats.acquires++;
+    }
+
+    const spinlock_stats& get() const {
+        return m_stats;
+    }
+};
+#define SPINLOCK_STATS_MEMBER spinlock_counter m_counter;
+#define SPINLOCK_WAIT_START auto wait_start = spinlock_counter::now();
+#define SPINLOCK_ACQUIRED(rounds) m_counter.acquired(rounds, wait_start)
+#define SPINLOCK_ACQUIRED_FAST m_counter.acquired()
+#else
+#define SPINLOCK_STATS_MEMBER
+#define SPINLOCK_WAIT_START
+#define SPINLOCK_ACQUIRED(rounds)
+#define SPINLOCK_ACQUIRED_FAST
+#endif
+
 inline void spin_lock(std::atomic_flag& lock) {
+    spin_backoff<> backoff;
     while(lock.test_and_set(std::memory_order_acquire)) {
-        continue;
+        backoff.pause();
     }
 }
 
@@ -28,34 +135,217 @@ inline void spin_unlock(std::atomic_flag *lock) {
     spin_unlock(*lock);
 }
 
-class spinlock final {
+template <unsigned YieldAfter = 0>
+class basic_spinlock final {
+private:
+    std::atomic<bool> m_locked{false};
+    SPINLOCK_STATS_MEMBER
+
+public:
+    void lock() {
+        if (!m_locked.exchange(true, std::memory_order_acquire)) {
+            SPINLOCK_ACQUIRED_FAST;
+            return;
+        }
+        SPINLOCK_WAIT_START
+        spin_backoff<YieldAfter> backoff;
+        do {
+            // wait on the shared line, only write when it looks free
+            do {
+                backoff.pause();
+            } while (m_locked.load(std::memory_order_relaxed));
+        } while (m_locked.exchange(true, std::memory_order_acquire));
+        SPINLOCK_ACQUIRED(backoff.rounds());
+    }
+
+    bool try_lock() {
+        if (m_locked.load(std::memory_order_relaxed) ||
+            m_locked.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        SPINLOCK_ACQUIRED_FAST;
+        return true;
+    }
+
+    void unlock() noexcept {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+#ifdef SPINLOCK_STATS
+    const spinlock_stats& stats() const {
+        return m_counter.get();
+    }
+#endif
+};
+
+using spinlock = basic_spinlock<>;
+
+/* The waiter takes a ticket and waits until it's served, the backoff is
+ * proportional to the number of the waiters ahead.
+ */
+template <unsigned YieldAfter = 0>
+class ticket_spinlock final {
 private:
-    std::atomic_flag af = ATOMIC_FLAG_INIT;
+    std::atomic<uint32_t> m_next{0};
+    std::atomic<uint32_t> m_serving{0};
+    SPINLOCK_STATS_MEMBER
 
 public:
     void lock() {
-        spec::spin_lock(af);
+        uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t serving = m_serving.load(std::memory_order_acquire);
+        if (serving == ticket) {
+            SPINLOCK_ACQUIRED_FAST;
+            return;
+        }
+        SPINLOCK_WAIT_START
+        spin_backoff<YieldAfter> backoff;
+        do {
+            backoff.pause(ticket - serving);
+            serving = m_serving.load(std::memory_order_acquire);
+        } while (serving != ticket);
+        SPINLOCK_ACQUIRED(backoff.rounds());
+    }
+
+    bool try_lock() {
+        // pairs with the release of unlock(), nothing releases m_next
+        uint32_t serving = m_serving.load(std::memory_order_acquire);
+        uint32_t ticket = serving;
+        if (!m_next.compare_exchange_strong(ticket, serving + 1,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            return false;
+        }
+        SPINLOCK_ACQUIRED_FAST;
+        return true;
     }
 
     void unlock() noexcept {
-        spec::spin_unlock(af);
+        // only the holder writes it
+        m_serving.store(m_serving.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    }
+
+#ifdef SPINLOCK_STATS
+    const spinlock_stats& stats() const {
+        return m_counter.get();
     }
+#endif
+};
+
+/* MCS queue lock(Mellor-Crummey & Scott): the waiters form a queue, each
+ * spins on the flag of its own node, the holder hands the lock to the
+ * next one. The nodes of lock()/unlock() come from a small per-thread
+ * pool, a thread may hold up to max_nested MCS locks at once.
+ */
+struct mcs_node {
+    alignas(64) std::atomic<mcs_node*> next{nullptr};
+    std::atomic<bool> locked{false};
+    bool in_use = false;
 };
 
+template <unsigned YieldAfter = 0>
+class mcs_spinlock final {
+public:
+    static constexpr unsigned max_nested = 8;
+
+private:
+    std::atomic<mcs_node*> m_tail{nullptr};
+    mcs_node *m_holder = nullptr;
+    SPINLOCK_STATS_MEMBER
+
+    static mcs_node* get_node() {
+        static thread_local mcs_node nodes[max_nested];
+        for (auto& n : nodes) {
+            if (!n.in_use) {
+                n.in_use = true;
+                return &n;
+            }
+        }
+        assert(0 == "too many nested mcs_spinlock");
+        return nullptr;
+    }
+
+public:
+    void lock() {
+        mcs_node *n = get_node();
+        n->next.store(nullptr, std::memory_order_relaxed);
+        n->locked.store(true, std::memory_order_relaxed);
+        mcs_node *prev = m_tail.exchange(n, std::memory_order_acq_rel);
+        if (!prev) {
+            m_holder = n;
+            SPINLOCK_ACQUIRED_FAST;
+            return;
+        }
+        SPINLOCK_WAIT_START
+        prev->next.store(n, std::memory_order_release);
+        spin_backoff<YieldAfter> backoff;
+        while (n->locked.load(std::memory_order_acquire)) {
+            backoff.pause();
+        }
+        m_holder = n;
+        SPINLOCK_ACQUIRED(backoff.rounds());
+    }
+
+    bool try_lock() {
+        mcs_node *expected = nullptr;
+        mcs_node *n = get_node();
+        n->next.store(nullptr, std::memory_order_relaxed);
+        if (!m_tail.compare_exchange_strong(expected, n, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            n->in_use = false;
+            return false;
+        }
+        m_holder = n;
+        SPINLOCK_ACQUIRED_FAST;
+        return true;
+    }
+
+    void unlock() noexcept {
+        mcs_node *n = m_holder;
+        mcs_node *next = n->next.load(std::memory_order_acquire);
+        if (!next) {
+            mcs_node *expected = n;
+            if (m_tail.compare_exchange_strong(expected, nullptr,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+                n->in_use = false;
+                return;
+            }
+            // a waiter is linking itself
+            spin_backoff<YieldAfter> backoff;
+            while (!(next = n->next.load(std::memory_order_acquire))) {
+                backoff.pause();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+        n->in_use = false;
+    }
+
+#ifdef SPINLOCK_STATS
+    const spinlock_stats& stats() const {
+        return m_counter.get();
+    }
+#endif
+};
 
-inline void spin_lock(spec::spinlock& lock) {
+template <unsigned YieldAfter>
+inline void spin_lock(basic_spinlock<YieldAfter>& lock) {
     lock.lock();
 }
 
-inline void spin_lock(spec::spinlock *lock) {
+template <unsigned YieldAfter>
+inline void spin_lock(basic_spinlock<YieldAfter> *lock) {
     spin_lock(*lock);
 }
 
-inline void spin_unlock(spec::spinlock& lock) {
+template <unsigned YieldAfter>
+inline void spin_unlock(basic_spinlock<YieldAfter>& lock) {
     lock.unlock();
 }
 
-inline void spin_unlock(spec::spinlock *lock) {
+template <unsigned YieldAfter>
+inline void spin_unlock(basic_spinlock<YieldAfter> *lock) {
     spin_unlock(*lock);
 }
 
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_ADMIN_SOCKET_H
+#define SPEC_ADMIN_SOCKET_H
+
+#include <string>
+#include <thread>
+
+#include "stats_registry.h"
+
+/* Unix-domain admin socket to read the stats of the running process.
+ *
+ * The client sends one command line, the reply is written back and the
+ * connection is closed:
+ *     "stats json"    stats in JSON
+ *     "stats binary"  stats in binary format, see stats_registry.h
+ *
+ *         ||  $ echo "stats json" | socat - UNIX-CONNECT:/run/wbcache.asok
+ */
+
+namespace spec {
+
+namespace stats {
+
+class admin_socket {
+private:
+    registry& m_registry;
+    std::string m_path;
+    int m_listen_fd = -1;
+    int m_shutdown_fd[2] = {-1, -1};
+    std::thread m_thread;
+
+    void entry();
+    void handle(int fd);
+
+public:
+    explicit admin_socket(registry& r = registry::instance())
+        : m_registry(r) {
+    }
+
+    ~admin_socket() {
+        stop();
+    }
+
+    admin_socket(const admin_socket&) = delete;
+    admin_socket& operator=(const admin_socket&) = delete;
+
+    // return 0 on success, -errno on failure
+    int start(const std::string& path);
+    void stop();
+};
+
+} //namespace: stats
+
+} //namespace: spec
+
+#endif //SPEC_ADMIN_SOCKET_H
@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_STATS_HISTOGRAM_H
+#define SPEC_STATS_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/* Log-linear(HDR style) histogram of the uint64_t values, e.g. latencies
+ * in ns. Every power of two is split into 2^sub_bits linear buckets, so a
+ * value is off by at most 1/32 of itself, from 1ns to 2^64ns, in 1920
+ * buckets. The values below 32 are exact.
+ *
+ * Every thread records into its own shard, the first record of a thread
+ * takes a lock to get it. record() only does plain loads and stores on
+ * the shard, no atomic RMW nor fence. A snapshot takes no lock, it reads
+ * all the shards without stopping the writers: each counter is exact, but
+ * the counters may be a few records apart from each other.
+ *         ||  static spec::stats::histogram append_lat("bluefs.append_ns");
+ *         ||  append_lat.record(ns);
+ *         ||  auto snap = append_lat.snapshot();
+ *         ||  uint64_t p99 = snap.percentile(99);
+ *
+ * The shard of an exited thread is reused by the next new thread. With a
+ * name the histogram exports <name>.count/.p50/.p99/.p999/.max to the
+ * stats registry, see SPEC_LATENCY_TIMER() in clock/latency.h.
+ */
+
+namespace spec {
+
+namespace stats {
+
+class histogram_snapshot {
+public:
+    static constexpr unsigned sub_bits = 5;
+    static constexpr unsigned sub_buckets = 1u << sub_bits;
+    static constexpr unsigned num_buckets = (65 - sub_bits) * sub_buckets;
+
+    static unsigned bucket_of(uint64_t v) {
+        if (v < sub_buckets) {
+            return v;
+        }
+        unsigned msb = 63 - __builtin_clzll(v);
+        unsigned shift = msb - sub_bits;
+        return ((shift + 1) << sub_bits) + ((v >> shift) - sub_buckets);
+    }
+
+    // the smallest and the largest values of the bucket
+    static uint64_t bucket_low(unsigned b) {
+        if (b < sub_buckets) {
+            return b;
+        }
+        unsigned shift = (b >> sub_bits) - 1;
+        return (uint64_t)((b & (sub_buckets - 1)) + sub_buckets) << shift;
+    }
+
+    static uint64_t bucket_high(unsigned b) {
+        if (b < sub_buckets) {
+            return b;
+        }
+        unsigned shift = (b >> sub_bits) - 1;
+        return bucket_low(b) + ((1ull << shift) - 1);
+    }
+
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+
+    histogram_snapshot() : buckets(num_buckets, 0) {}
+
+    void add(uint64_t v, uint64_t n = 1);
+    void merge(const histogram_snapshot& other);
+
+    /* The value under which p% of the records fall, p in [0, 100]: the
+     * high end of its bucket, capped by max. 0 if it's empty.
+     */
+    uint64_t percentile(double p) const;
+
+    double mean() const {
+        return count ? (double)sum / count : 0;
+    }
+};
+
+class histogram {
+public:
+    struct shard;
+
+private:
+    const uint64_t m_id;        // never reused, the key of the thread caches
+    const std::string m_name;
+    std::vector<uint64_t> m_gauges;
+
+    // append-only list, so the snapshots walk it without any lock
+    std::atomic<shard*> m_shards{nullptr};
+
+    shard* local_shard();
+    shard* attach();
+
+public:
+    histogram();
+    // export it to the stats registry
+    explicit histogram(const std::string& name);
+    ~histogram();
+
+    histogram(const histogram&) = delete;
+    histogram& operator=(const histogram&) = delete;
+
+    const std::string& name() const {
+        return m_name;
+    }
+
+    void record(uint64_t v);
+
+    histogram_snapshot snapshot() const;
+
+    // merge this one into snap
+    void merge_into(histogram_snapshot& snap) const;
+
+    // only to be called when no thread records
+    void reset();
+};
+
+} //namespace: stats
+
+} //namespace: spec
+
+#endif //SPEC_STATS_HISTOGRAM_H
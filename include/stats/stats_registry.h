@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_STATS_REGISTRY_H
+#define SPEC_STATS_REGISTRY_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Stats registry of the running process.
+ *
+ * One snapshot collects:
+ *     mempool.<pool>.bytes / mempool.<pool>.items
+ *     mempool.<pool>.type.<type>.items   (only in mempool debug mode)
+ *     buffer.crc.cached / buffer.crc.cached_adjusted / buffer.crc.missed
+ *     all the registered gauges
+ * The cost is O(pools x shards) plus the registered gauges and the tracked
+ * types. The buffer wasted space depends on which lists are kept, so the
+ * owner registers it as a gauge:
+ *         ||  auto id = spec::stats::registry::instance().add_gauge(
+ *         ||      "cache.wasted_bytes", [&] { return cache_wasted_bytes(); });
+ *         ||  ...
+ *         ||  spec::stats::registry::instance().remove_gauge(id);
+ *
+ * Binary format(version 1), all integers are little-endian:
+ *     char     magic[8]      "SPECSTAT"
+ *     uint32_t version       1
+ *     uint32_t count         number of entries
+ *     uint64_t timestamp     nanoseconds since epoch
+ *     count x {
+ *         uint16_t name_len
+ *         char     name[name_len]
+ *         uint64_t value
+ *     }
+ * New entries may be added, but an existing name never changes its meaning.
+ */
+
+namespace spec {
+
+namespace stats {
+
+using stat_list_t = std::vector<std::pair<std::string, uint64_t>>;
+
+class registry {
+public:
+    using gauge_fn = std::function<uint64_t()>;
+
+private:
+    mutable std::mutex lock;    // protect gauges
+    uint64_t next_id = 0;
+    std::map<uint64_t, std::pair<std::string, gauge_fn>> gauges;
+
+public:
+    static registry& instance();
+
+    // return the id used to remove the gauge
+    uint64_t add_gauge(const std::string& name, gauge_fn fn);
+    void remove_gauge(uint64_t id);
+
+    stat_list_t snapshot() const;
+
+    void dump_json(std::ostream& out) const;
+    void dump_binary(std::string& out) const;
+};
+
+extern void encode_binary(const stat_list_t& stats, uint64_t timestamp,
+                          std::string& out);
+
+// return false if it's not a valid binary stats
+extern bool decode_binary(const std::string& in, stat_list_t& stats,
+                          uint64_t *timestamp = nullptr);
+
+} //namespace: stats
+
+} //namespace: spec
+
+#endif //SPEC_STATS_REGISTRY_H
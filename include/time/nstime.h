@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_NSTIME_H
+#define SPEC_NSTIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include "utime.h"
+
+/* A timestamp or a duration in 64-bit nanoseconds, for the monotonic
+ * clocks: it's what the latency math wants, one integer to subtract,
+ * and it doesn't wrap for 584 years. utime_t stays the wall clock type.
+ */
+class nstime_t {
+private:
+    uint64_t m_ns = 0;
+
+public:
+    nstime_t() = default;
+
+    explicit nstime_t(uint64_t ns) : m_ns(ns) {}
+
+    explicit nstime_t(const struct timespec& ts)
+        : m_ns((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec) {}
+
+    explicit nstime_t(const utime_t& ut) : m_ns(ut.to_nsec()) {}
+
+    bool is_zero() const {
+        return m_ns == 0;
+    }
+
+    uint64_t to_nsec() const {
+        return m_ns;
+    }
+    uint64_t to_usec() const {
+        return m_ns / 1000ull;
+    }
+    uint64_t to_msec() const {
+        return m_ns / 1000000ull;
+    }
+
+    uint64_t sec() const {
+        return m_ns / 1000000000ull;
+    }
+    uint32_t nsec() const {
+        return m_ns % 1000000000ull;
+    }
+
+    void to_timespec(struct timespec *ts) const {
+        ts->tv_sec = sec();
+        ts->tv_nsec = nsec();
+    }
+
+    utime_t to_utime() const {
+        return utime_t(cap_to_u32_max(sec()), nsec());
+    }
+
+    operator double() const {
+        return m_ns / 1000000000.0;
+    }
+
+    nstime_t& operator+=(const nstime_t& rhs) {
+        m_ns += rhs.m_ns;
+        return *this;
+    }
+
+    // saturates at 0, a duration never goes negative
+    nstime_t& operator-=(const nstime_t& rhs) {
+        m_ns = m_ns > rhs.m_ns ? m_ns - rhs.m_ns : 0;
+        return *this;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const nstime_t& val) {
+        char oldfill = out.fill('0');
+        out << val.sec() << "." << std::setw(9) << val.nsec();
+        out.fill(oldfill);
+        return out;
+    }
+};
+
+inline nstime_t operator+(nstime_t lhs, const nstime_t& rhs) {
+    return lhs += rhs;
+}
+
+inline nstime_t operator-(nstime_t lhs, const nstime_t& rhs) {
+    return lhs -= rhs;
+}
+
+inline bool operator<(const nstime_t& a, const nstime_t& b) {
+    return a.to_nsec() < b.to_nsec();
+}
+inline bool operator>(const nstime_t& a, const nstime_t& b) {
+    return b < a;
+}
+inline bool operator<=(const nstime_t& a, const nstime_t& b) {
+    return !(b < a);
+}
+inline bool operator>=(const nstime_t& a, const nstime_t& b) {
+    return !(a < b);
+}
+inline bool operator==(const nstime_t& a, const nstime_t& b) {
+    return a.to_nsec() == b.to_nsec();
+}
+inline bool operator!=(const nstime_t& a, const nstime_t& b) {
+    return !(a == b);
+}
+
+#endif //SPEC_NSTIME_H
@@ -0,0 +1,305 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#ifndef SPEC_TRACE_H
+#define SPEC_TRACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../clock/spec_clock.h"
+#include "../compiler/likely.h"
+
+/* Binary tracer: a tracepoint copies its arguments, as they are, into the
+ * ring of the calling thread, the formatting is left to the decoder.
+ *         ||  SPEC_TRACE("buffer.rebuild", "len {} num {}", _len, _num);
+ *
+ * The name and the format are registered on the first hit of the
+ * tracepoint and written to the trace before its first record, "{}"
+ * is replaced by the next argument. The arguments must be integers,
+ * enums, bool, floating points or pointers, up to max_args of them.
+ *
+ * While the tracer is stopped a tracepoint is one load and one not-taken
+ * branch, the arguments aren't evaluated. Build with SPEC_TRACE_DISABLE
+ * to compile them out.
+ *
+ * Every thread writes to its own lock-free SPSC ring, when it's full the
+ * record is dropped and counted. The tracer thread drains the rings to
+ * the trace file, see tracer::start() and spec_trace_decode.
+ *
+ * Trace file, in host byte order:
+ *     char     magic[8]        "SPECTRC1"
+ *     uint64_t mult            ns per cycle, 32.32 fixed point
+ *     uint64_t base_cycles     the cycle at base_ns
+ *     uint64_t base_ns         CLOCK_MONOTONIC
+ *     records of {
+ *         uint32_t type        record_type
+ *         uint32_t len         of the payload
+ *         payload
+ *     }
+ * An event record in the rings is record_header then nargs x uint64_t.
+ */
+
+namespace spec {
+
+namespace trace {
+
+constexpr unsigned max_args = 16;
+
+enum record_type : uint32_t {
+    // uint16_t id, uint16_t nargs, uint16_t name_len, uint16_t fmt_len,
+    // name, fmt, the type of each arg
+    RECORD_EVENT_DEF = 1,
+    // uint32_t tid, uint32_t 0, event records
+    RECORD_EVENTS = 2,
+    // uint32_t tid, uint32_t 0, uint64_t records dropped so far
+    RECORD_DROPPED = 3,
+};
+
+struct record_header {
+    uint16_t id;
+    uint16_t nargs;
+    uint32_t reserved;
+    uint64_t cycles;        // spec_tsc_cycles()
+};
+
+// the type of an argument, in the event definition
+template <typename T>
+constexpr char type_code() {
+    using U = std::decay_t<T>;
+    static_assert(std::is_arithmetic<U>::value || std::is_enum<U>::value ||
+                  std::is_pointer<U>::value || std::is_null_pointer<U>::value,
+                  "trace arguments must be scalars");
+    if constexpr (std::is_pointer<U>::value || std::is_null_pointer<U>::value) {
+        return 'p';
+    } else if constexpr (std::is_same<U, bool>::value) {
+        return 'b';
+    } else if constexpr (std::is_floating_point<U>::value) {
+        return 'f';
+    } else if constexpr (std::is_enum<U>::value) {
+        return std::is_signed<std::underlying_type_t<U>>::value ? 'i' : 'u';
+    } else {
+        return std::is_signed<U>::value ? 'i' : 'u';
+    }
+}
+
+template <typename... A>
+struct type_list {};
+
+// only in decltype(), the arguments aren't evaluated
+template <typename... A>
+type_list<std::decay_t<A>...> type_list_of(A&&...);
+
+template <typename L>
+struct signature;
+
+template <typename... A>
+struct signature<type_list<A...>> {
+    static_assert(sizeof...(A) <= max_args, "too many trace arguments");
+    static constexpr char value[] = {type_code<A>()..., '\0'};
+};
+
+template <typename T>
+inline uint64_t encode_arg(const T& v) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_pointer<U>::value) {
+        return (uint64_t)(uintptr_t)v;
+    } else if constexpr (std::is_null_pointer<U>::value) {
+        return 0;
+    } else if constexpr (std::is_floating_point<U>::value) {
+        double d = v;
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        return bits;
+    } else if constexpr (std::is_enum<U>::value) {
+        return (uint64_t)(int64_t)v;
+    } else if constexpr (std::is_signed<U>::value) {
+        return (uint64_t)(int64_t)v;
+    } else {
+        return (uint64_t)v;
+    }
+}
+
+// the ring of a thread, written by it and read by the tracer thread
+class ring {
+private:
+    std::unique_ptr<char[]> m_buf;
+    const uint64_t m_mask;
+
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    uint64_t m_cached_tail = 0;
+    std::atomic<uint64_t> m_dropped{0};
+
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+
+public:
+    const uint32_t tid;
+    std::atomic<bool> exited{false};
+    uint64_t reported_dropped = 0;  // by the tracer thread
+
+    ring(uint64_t size, uint32_t tid);
+
+    uint64_t size() const {
+        return m_mask + 1;
+    }
+
+    // by the owner thread
+    void push(const void *data, uint64_t len) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head + len - m_cached_tail > size()) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head + len - m_cached_tail > size()) {
+                m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
+                return;
+            }
+        }
+        uint64_t off = head & m_mask;
+        uint64_t first = std::min(len, size() - off);
+        memcpy(m_buf.get() + off, data, first);
+        memcpy(m_buf.get(), (const char*)data + first, len - first);
+        m_head.store(head + len, std::memory_order_release);
+    }
+
+    /* By the tracer thread */
+
+    uint64_t head() const {
+        return m_head.load(std::memory_order_acquire);
+    }
+
+    uint64_t dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    // append [tail, head) to out and consume it
+    void drain(uint64_t head, std::string& out);
+
+    // throw away all the records before head
+    void discard(uint64_t head) {
+        m_tail.store(head, std::memory_order_release);
+    }
+};
+
+struct event_def {
+    std::string name;
+    std::string fmt;
+    std::string sig;
+};
+
+class tracer {
+private:
+    static std::atomic<bool> s_on;
+
+    std::mutex m_lock;          // protect all below
+    std::condition_variable m_cond;
+    std::vector<std::shared_ptr<ring>> m_rings;
+    uint64_t m_dropped_exited = 0;  // by the rings gone
+    std::vector<event_def> m_events;
+    size_t m_events_written = 0;
+    uint64_t m_ring_size = 256 * 1024;
+    int m_fd = -1;
+    bool m_stopping = false;
+    std::thread m_thread;
+    uint64_t m_interval_ms = 10;
+
+    tracer() = default;
+    void entry();
+    void drain(std::unique_lock<std::mutex>& lk);
+
+public:
+    static tracer& instance();
+
+    static bool on() {
+        return s_on.load(std::memory_order_relaxed);
+    }
+
+    uint16_t register_event(const char *name, const char *fmt, const char *sig);
+
+    // the ring of the calling thread
+    std::shared_ptr<ring> new_ring();
+
+    /* Truncate the file at path and trace into it, the rings of the new
+     * threads have ring_size bytes(a power of 2). Return 0 or -errno.
+     */
+    int start(const std::string& path, uint64_t ring_size = 256 * 1024,
+              uint64_t interval_ms = 10);
+    // drain everything and close the file
+    void stop();
+
+    // the records dropped since the process started
+    uint64_t dropped();
+
+    std::vector<event_def> events();
+};
+
+// to the ring of the calling thread
+extern void push_record(const void *rec, uint64_t len);
+
+template <typename... A>
+inline void emit(uint16_t id, const A&... args) {
+    struct {
+        record_header hdr;
+        uint64_t args[sizeof...(A) + 1];
+    } rec;
+    rec.hdr.id = id;
+    rec.hdr.nargs = sizeof...(A);
+    rec.hdr.reserved = 0;
+    rec.hdr.cycles = spec_tsc_cycles();
+    size_t i = 0;
+    ((rec.args[i++] = encode_arg(args)), ...);
+    (void)i;
+    push_record(&rec, sizeof(record_header) + sizeof...(A) * sizeof(uint64_t));
+}
+
+/* Decoding */
+
+struct event {
+    uint64_t ns;                // CLOCK_MONOTONIC
+    uint32_t tid;
+    uint16_t id;
+    std::vector<uint64_t> args;
+};
+
+struct trace_file {
+    std::vector<event_def> defs;
+    std::vector<event> events;  // sorted by the time
+    uint64_t dropped = 0;
+};
+
+// return false if it's not a valid trace
+extern bool decode(const std::string& in, trace_file& out);
+
+// "name: fmt" with the arguments filled in
+extern std::string format(const trace_file& t, const event& e);
+
+} //namespace: trace
+
+} //namespace: spec
+
+#ifdef SPEC_TRACE_DISABLE
+#define SPEC_TRACE(name, fmt, ...) do {} while (0)
+#else
+#define SPEC_TRACE(name, fmt, ...)                                              \
+    do {                                                                        \
+        if (unlikely(spec::trace::tracer::on())) {                              \
+            static const uint16_t spec_trace_id =                               \
+                spec::trace::tracer::instance().register_event(name, fmt,       \
+                    spec::trace::signature<decltype(                            \
+                        spec::trace::type_list_of(__VA_ARGS__))>::value);       \
+            spec::trace::emit(spec_trace_id, ##__VA_ARGS__);                    \
+        }                                                                       \
+    } while (0)
+#endif
+
+#endif //SPEC_TRACE_H
@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "arch/cpu_topology.h"
+#include "arch/dispatch.h"
+#include "arch/intel.h"
+#include "arch/mem.h"
+#include "crc32/crc32c.h"
+#include "crc32/crc64.h"
+#include "crc32/sctp_crc32.h"
+
+#include "gtest/gtest.h"
+
+TEST(ArchDispatch, self_test) {
+    std::vector<unsigned char> zeros(300);
+    EXPECT_TRUE(arch_mem_is_zero(zeros.data(), zeros.size()));
+    zeros[299] = 1;
+    EXPECT_FALSE(arch_mem_is_zero(zeros.data(), zeros.size()));
+
+    for (auto name : {"crc32c", "crc32c_multi", "crc32c_zeros", "crc64", "mem_is_zero"}) {
+        auto k = arch_kernel_find(name);
+        ASSERT_TRUE(k) << name;
+        std::cout << name << ": " << k->chosen->name << std::endl;
+    }
+    EXPECT_EQ(nullptr, arch_kernel_find("no_such_kernel"));
+
+    std::cout << "arch level: " << arch_level_name(arch_level()) << std::endl;
+    EXPECT_EQ(0, arch_kernel_self_test([](const char *kernel, const char *variant, int ok) {
+        std::cout << "self test " << kernel << "/" << variant << ": "
+                  << (ok ? "ok" : "FAILED") << std::endl;
+    }));
+}
+
+TEST(ArchDispatch, level_override) {
+    auto p = (const unsigned char*)"123456789";
+
+    setenv("SPEC_ARCH_LEVEL", "scalar", 1);
+    arch_kernel_reselect();
+    EXPECT_EQ(ARCH_LEVEL_SCALAR, arch_level());
+    EXPECT_EQ((crc32c_func_t)crc32c_sctp, crc32c_func);
+    for (auto name : {"crc32c", "crc32c_multi", "crc32c_zeros", "crc64"}) {
+        auto k = arch_kernel_find(name);
+        ASSERT_TRUE(k);
+        EXPECT_EQ(&k->variants[0], k->chosen) << name;
+    }
+    EXPECT_EQ(0xe3069283u, ~spec_crc32c(~0U, p, 9));
+    EXPECT_EQ(0x995dc9bbdf1939faULL, ~spec_crc64(~0ULL, p, 9));
+
+    // unknown name is ignored
+    setenv("SPEC_ARCH_LEVEL", "sse9", 1);
+    arch_kernel_reselect();
+    EXPECT_EQ(arch_level_detected(), arch_level());
+
+    unsetenv("SPEC_ARCH_LEVEL");
+    arch_kernel_reselect();
+    EXPECT_EQ(arch_level_detected(), arch_level());
+    EXPECT_EQ(0xe3069283u, ~spec_crc32c(~0U, p, 9));
+}
+
+#if defined(__x86_64__)
+TEST(ArchDispatch, per_feature) {
+    if (arch_level_detected() < ARCH_LEVEL_SSE42) {
+        GTEST_SKIP() << "no sse4.2";
+    }
+    auto p = (const unsigned char*)"123456789";
+
+    // sse4.2 without pclmul, e.g. Nehalem: crc32c still runs on sse4.2
+    auto crc32c = arch_kernel_find("crc32c")->chosen;
+    int pclmul = arch_intel_pclmul;
+    arch_intel_pclmul = 0;
+    arch_kernel_reselect();
+    EXPECT_EQ(ARCH_LEVEL_SSE42, std::min(arch_level(), (int)ARCH_LEVEL_SSE42));
+    EXPECT_EQ(crc32c, arch_kernel_find("crc32c")->chosen);
+    EXPECT_STREQ("intel", arch_kernel_find("crc32c_multi")->chosen->name);
+    EXPECT_STREQ("generic", arch_kernel_find("crc32c_zeros")->chosen->name);
+    EXPECT_STREQ("table", arch_kernel_find("crc64")->chosen->name);
+    EXPECT_EQ(0xe3069283u, ~spec_crc32c(~0U, p, 9));
+    std::vector<unsigned char> zeros(4096);
+    EXPECT_EQ(spec_crc32c(5, zeros.data(), zeros.size()), crc32c_zeros(5, zeros.size()));
+    EXPECT_EQ(0x995dc9bbdf1939faULL, ~spec_crc64(~0ULL, p, 9));
+
+    arch_intel_pclmul = pclmul;
+    arch_kernel_reselect();
+    EXPECT_EQ(pclmul ? std::string("intel") : std::string("generic"),
+              arch_kernel_find("crc32c_zeros")->chosen->name);
+}
+#endif
+
+TEST(CpuTopology, probe) {
+    const auto& topo = spec::cpu_topology::get();
+    std::cout << topo.num_cpus << " cpus, " << topo.num_cores << " cores, "
+              << topo.num_sockets << " sockets, " << topo.num_nodes << " nodes, "
+              << "L1d " << topo.l1d_size << ", L2 " << topo.l2_size
+              << ", L3 " << topo.l3_size << ", line " << topo.cache_line_size
+              << std::endl;
+    EXPECT_LE(1u, topo.num_cpus);
+    EXPECT_LE(topo.num_cores, topo.num_cpus);
+    EXPECT_LT(0u, topo.l1d_size);
+    EXPECT_EQ(0u, topo.cache_line_size & (topo.cache_line_size - 1));
+    EXPECT_LE(4096u, topo.buffer_append_unit());
+    EXPECT_LE(topo.num_cpus, topo.mempool_shards());
+    EXPECT_LT(0u, topo.nt_store_threshold());
+}
+
+static void write_file(const std::string& path, const std::string& content) {
+    std::ofstream(path) << content << "\n";
+}
+
+TEST(CpuTopology, sysfs) {
+    // 2 sockets x 2 cores x 2 threads, one node per socket, cpu 7 offline
+    std::string root = "/tmp/unittest_cpu_topology." + std::to_string(getpid());
+    std::string cpu = root + "/cpu";
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+    mkdir(root.c_str(), 0755);
+    mkdir(cpu.c_str(), 0755);
+    mkdir((root + "/node").c_str(), 0755);
+    write_file(cpu + "/online", "0-6");
+    for (int i = 0; i < 7; ++i) {
+        std::string dir = cpu + "/cpu" + std::to_string(i);
+        mkdir(dir.c_str(), 0755);
+        mkdir((dir + "/topology").c_str(), 0755);
+        write_file(dir + "/topology/physical_package_id", std::to_string(i / 4));
+        write_file(dir + "/topology/core_id", std::to_string((i / 2) % 2));
+    }
+    std::string cache = cpu + "/cpu0/cache";
+    mkdir(cache.c_str(), 0755);
+    const char *levels[][4] = {
+        {"1", "Data", "48K", "0-1"},
+        {"1", "Instruction", "32K", "0-1"},
+        {"2", "Unified", "2048K", "0-1"},
+        {"3", "Unified", "32M", "0-3"},
+    };
+    for (int i = 0; i < 4; ++i) {
+        std::string dir = cache + "/index" + std::to_string(i);
+        mkdir(dir.c_str(), 0755);
+        write_file(dir + "/level", levels[i][0]);
+        write_file(dir + "/type", levels[i][1]);
+        write_file(dir + "/size", levels[i][2]);
+        write_file(dir + "/coherency_line_size", "128");
+        write_file(dir + "/shared_cpu_list", levels[i][3]);
+    }
+    mkdir((root + "/node/node0").c_str(), 0755);
+    mkdir((root + "/node/node1").c_str(), 0755);
+    mkdir((root + "/node/node2").c_str(), 0755);
+    write_file(root + "/node/node0/cpulist", "0-3");
+    write_file(root + "/node/node1/cpulist", "4-7");
+    write_file(root + "/node/node2/cpulist", "");    // memory only
+
+    spec::cpu_topology topo;
+    topo.probe_sysfs_cache(root);
+    topo.probe_sysfs_topology(root);
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+
+    ASSERT_EQ(4u, topo.caches.size());
+    EXPECT_EQ('D', topo.caches[0].type);
+    EXPECT_EQ(48u * 1024, topo.caches[0].size);
+    EXPECT_EQ(32u << 20, topo.caches[3].size);
+    EXPECT_EQ(4u, topo.caches[3].shared_cpus);
+    EXPECT_EQ(128u, topo.caches[2].line_size);
+
+    EXPECT_EQ(7u, topo.num_cpus);
+    EXPECT_EQ(4u, topo.num_cores);
+    EXPECT_EQ(2u, topo.num_sockets);
+    EXPECT_EQ(2u, topo.threads_per_core);
+    EXPECT_EQ(2u, topo.num_nodes);
+    EXPECT_EQ(topo.cpu_core[0], topo.cpu_core[1]);
+    EXPECT_NE(topo.cpu_core[1], topo.cpu_core[2]);
+    EXPECT_NE(topo.cpu_core[0], topo.cpu_core[4]);
+    EXPECT_EQ(0, topo.node_of_cpu(3));
+    EXPECT_EQ(1, topo.node_of_cpu(6));
+    EXPECT_EQ(-1, topo.node_of_cpu(7));
+    EXPECT_EQ(8u, topo.mempool_shards());
+}
@@ -10,16 +10,23 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include <iomanip>
+#include <random>
+#include <set>
+
 #include "buffer/buffer_create.h"
 #include "buffer/buffer_audit.h"
 #include "buffer/buffer_hash.h"
 #include "buffer/buffer_raw.h"
 #include "buffer/buffer_ptr.h"
 #include "buffer/buffer_list.h"
+#include "arch/dispatch.h"
 #include "clock/spec_clock.h"
+#include "encode/armor.h"
 #include "safe_io.h"
 
 #include "gtest/gtest.h"
+#include "crc32/checksum.h"
 #include "crc32/crc32c.h"
 #include "crc32/sctp_crc32.h"
 
@@ -2127,6 +2134,247 @@ TEST(BufferList, decode_base64) {
     EXPECT_THROW(other.decode_base64(malformed), buffer::malformed_input);
 }
 
+// the byte-at-a-time codec before the bulk kernels, the fuzz reference
+static int64_t ref_armor(char *dst, const char *dst_end,
+                         const char *src, const char *src_end, int line_width) {
+    static const char *key = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                             "abcdefghijklmnopqrstuvwxyz0123456789+/";
+    int64_t out_len = 0;
+    uint64_t track_line = 0;
+    auto put = [&](char c) {
+        if (dst >= dst_end) {
+            return false;
+        }
+        *dst++ = c;
+        return true;
+    };
+    while (src < src_end) {
+        unsigned char a = *src++, b = 0, c = 0;
+        int n = 1;
+        if (src < src_end) {
+            b = *src++;
+            n++;
+            if (src < src_end) {
+                c = *src++;
+                n++;
+            }
+        }
+        if (!put(key[a >> 2]) || !put(key[((a & 3) << 4) | (b >> 4)]) ||
+            !put(n > 1 ? key[((b & 15) << 2) | (c >> 6)] : '=') ||
+            !put(n > 2 ? key[c & 63] : '=')) {
+            return -ERANGE;
+        }
+        out_len += 4;
+        track_line += 4;
+        if (line_width && track_line == (uint64_t)line_width) {
+            track_line = 0;
+            if (!put('\n')) {
+                return -ERANGE;
+            }
+            out_len++;
+        }
+    }
+    return out_len;
+}
+
+static int64_t ref_unarmor(char *dst, const char *dst_end,
+                           const char *src, const char *src_end) {
+    auto bits = [](char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        if (c == '=') return 0;
+        return -EINVAL;
+    };
+    int64_t out_len = 0;
+    while (src < src_end) {
+        if (src[0] == '\n') {
+            src++;
+            continue;
+        }
+        if (src + 4 > src_end) {
+            return -EINVAL;
+        }
+        int a = bits(src[0]), b = bits(src[1]), c = bits(src[2]), d = bits(src[3]);
+        if (a < 0 || b < 0 || c < 0 || d < 0) {
+            return -EINVAL;
+        }
+        char out[3] = {(char)((a << 2) | (b >> 4)), (char)(((b & 15) << 4) | (c >> 2)),
+                       (char)(((c & 3) << 6) | d)};
+        int n = src[2] == '=' ? 1 : src[3] == '=' ? 2 : 3;
+        for (int i = 0; i < n; i++) {
+            if (dst >= dst_end) {
+                return -ERANGE;
+            }
+            *dst++ = out[i];
+        }
+        if (n < 3) {
+            return out_len + n;
+        }
+        out_len += 3;
+        src += 4;
+    }
+    return out_len;
+}
+
+TEST(BufferList, base64_fuzz) {
+    static const char noise[] = {'=', '\n', '-', '_', '+', '/', '*', ' ', '\0', (char)0xc3};
+    std::mt19937 rng(5);
+    std::vector<char> src(2000), exp(4000), got(4000);
+
+    EXPECT_TRUE(arch_kernel_find("armor_encode"));
+    EXPECT_TRUE(arch_kernel_find("armor_decode"));
+    EXPECT_EQ(0, arch_kernel_self_test(nullptr));
+    for (auto level : {"scalar", "sse42", "avx2", "avx512"}) {
+        setenv("SPEC_ARCH_LEVEL", level, 1);
+        arch_kernel_reselect();
+        for (int round = 0; round < 3000; ++round) {
+            size_t len = rng() % (round < 1000 ? 100 : src.size());
+            for (size_t i = 0; i < len; ++i) {
+                src[i] = rng();
+            }
+            int line_width = std::vector<int>{0, 0, 4, 64, 76, 30}[round % 6];
+            size_t room = len * 4 / 3 + len / 2 + 8;
+            if (round % 5 == 0) {
+                room = rng() % room;
+            }
+
+            std::fill(exp.begin(), exp.end(), 'x');
+            std::fill(got.begin(), got.end(), 'x');
+            int64_t r0 = ref_armor(exp.data(), exp.data() + room,
+                                   src.data(), src.data() + len, line_width);
+            int64_t r1 = (int64_t)spec_armor_line_break(
+                    got.data(), got.data() + room, src.data(), src.data() + len,
+                    line_width);
+            ASSERT_EQ(r0, r1) << level << " len " << len << " room " << room;
+            ASSERT_EQ(exp, got) << level << " len " << len << " room " << room;
+
+            // decode the output, mostly intact, sometimes with noise
+            std::vector<char> text(exp.begin(), exp.begin() + (r0 > 0 ? r0 : room));
+            if (round % 3 == 0 && !text.empty()) {
+                for (int i = rng() % 3; i >= 0; --i) {
+                    text[rng() % text.size()] = noise[rng() % sizeof(noise)];
+                }
+            }
+            room = text.size() * 3 / 4 + 4;
+            if (round % 7 == 0) {
+                room = rng() % room;
+            }
+            std::fill(exp.begin(), exp.end(), 'x');
+            std::fill(got.begin(), got.end(), 'x');
+            r0 = ref_unarmor(exp.data(), exp.data() + room,
+                             text.data(), text.data() + text.size());
+            r1 = spec_unarmor(got.data(), got.data() + room,
+                              text.data(), text.data() + text.size());
+            ASSERT_EQ(r0, r1) << level << " text " << text.size() << " room " << room;
+            ASSERT_EQ(exp, got) << level << " text " << text.size() << " room " << room;
+        }
+    }
+    unsetenv("SPEC_ARCH_LEVEL");
+    arch_kernel_reselect();
+}
+
+TEST(BufferList, base64_segmented) {
+    std::mt19937 rng(11);
+    // split s into segments of 1..max bytes
+    auto split = [&](const std::string& s, size_t max) {
+        buffer_list bl;
+        for (size_t pos = 0; pos < s.size(); ) {
+            size_t n = std::min<size_t>(1 + rng() % max, s.size() - pos);
+            bl.push_back(buffer_ptr(buffer::copy(s.data() + pos, n)));
+            pos += n;
+        }
+        return bl;
+    };
+    auto to_string = [](const buffer_list& bl) {
+        std::string s;
+        for (const auto& node : bl.buffers()) {
+            s.append(node.c_str(), node.length());
+        }
+        return s;
+    };
+
+    for (int round = 0; round < 500; ++round) {
+        std::string raw(rng() % (round < 400 ? 64 : 20000), '\0');
+        for (auto& c : raw) {
+            c = rng();
+        }
+        std::string text(raw.size() * 4 / 3 + 4, '\0');
+        text.resize(spec_armor(&text[0], &text[0] + text.size(),
+                               raw.data(), raw.data() + raw.size()));
+
+        buffer_list bl = split(raw, round % 2 ? 7 : 5000);
+        size_t segments = bl.get_num_buffers();
+        buffer_list encoded;
+        bl.encode_base64(encoded);
+        ASSERT_EQ(segments, bl.get_num_buffers());
+        ASSERT_EQ(text, to_string(encoded));
+
+        // line breaks and trailing garbage after the padding
+        std::string lined;
+        for (size_t pos = 0; pos < text.size(); pos += 76) {
+            lined += text.substr(pos, 76) + "\n";
+        }
+        if (raw.size() % 3) {
+            lined += "**";
+        }
+        buffer_list decoded;
+        decoded.append("head");
+        buffer_list in = split(lined, round % 2 ? 5 : 3000);
+        segments = in.get_num_buffers();
+        decoded.decode_base64(in);
+        ASSERT_EQ(segments, in.get_num_buffers());
+        ASSERT_EQ("head" + raw, to_string(decoded));
+
+        // '\n' inside a quad, a short tail
+        if (text.size() > 8) {
+            std::string bad = text.substr(0, 5) + "\n" + text.substr(5);
+            in = split(bad, 3);
+            EXPECT_THROW(decoded.decode_base64(in), buffer::malformed_input);
+            in = split(text.substr(0, text.size() - 2), 3);
+            EXPECT_THROW(decoded.decode_base64(in), buffer::malformed_input);
+            ASSERT_EQ("head" + raw, to_string(decoded));
+        }
+    }
+}
+
+TEST(BufferList, BenchBase64) {
+    const size_t size = 1024 * 1024;
+    const int rounds = 100;
+    std::vector<char> raw(size), text(size * 4 / 3 + 4), out(size + 4);
+    for (auto& c : raw) {
+        c = rand();
+    }
+
+    double mb = (double)size * rounds / (1024 * 1024);
+    for (auto level : {"scalar", "sse42", "avx2"}) {
+        setenv("SPEC_ARCH_LEVEL", level, 1);
+        arch_kernel_reselect();
+        utime_t start = spec_clock_now();
+        uint64_t len = 0;
+        for (int r = 0; r < rounds; ++r) {
+            len = spec_armor(text.data(), text.data() + text.size(),
+                             raw.data(), raw.data() + size);
+        }
+        utime_t enc = spec_clock_now() - start;
+        start = spec_clock_now();
+        int64_t dec_len = 0;
+        for (int r = 0; r < rounds; ++r) {
+            dec_len = spec_unarmor(out.data(), out.data() + out.size(),
+                                   text.data(), text.data() + len);
+        }
+        utime_t dec = spec_clock_now() - start;
+        ASSERT_EQ((int64_t)size, dec_len);
+        EXPECT_EQ(0, memcmp(raw.data(), out.data(), size));
+        std::cout << "base64 " << level << ": encode " << mb / (double)enc
+                  << " MB/sec, decode " << mb / (double)dec << " MB/sec" << std::endl;
+    }
+    unsetenv("SPEC_ARCH_LEVEL");
+    arch_kernel_reselect();
+}
+
 TEST(BufferList, hexdump) {
     buffer_list bl;
     std::ostringstream stream;
@@ -2138,6 +2386,117 @@ TEST(BufferList, hexdump) {
 	          stream.str());
 }
 
+// the ostream based hexdump before the row formatting, the fuzz reference
+static std::string ref_hexdump(const std::string& s, bool trailing_newline) {
+    std::ostringstream out;
+    if (s.empty()) {
+        return "";
+    }
+    out.setf(std::ios::right);
+    out.fill('0');
+    uint64_t per = 16;
+    char last_row_char = s[0];
+    bool was_same = false, did_star = false;
+    for (uint64_t off = 0; off < s.size(); off += per) {
+        if (off + per < s.size()) {
+            bool row_is_same = true;
+            for (uint64_t i = 0; i < per; i++) {
+                if (s[off + i] != last_row_char) {
+                    if (i == 0) {
+                        last_row_char = s[off + i];
+                        was_same = false;
+                        did_star = false;
+                    } else {
+                        row_is_same = false;
+                    }
+                }
+            }
+            if (row_is_same) {
+                if (was_same) {
+                    if (!did_star) {
+                        out << "\n*";
+                        did_star = true;
+                    }
+                    continue;
+                }
+                was_same = true;
+            } else {
+                was_same = false;
+                did_star = false;
+            }
+        }
+        if (off) {
+            out << "\n";
+        }
+        out << std::hex << std::setw(8) << off << " ";
+        uint64_t i;
+        for (i = 0; i < per; i++) {
+            if (i == 8) {
+                out << ' ';
+            }
+            if (off + i < s.size()) {
+                out << " " << std::setw(2) << ((unsigned)s[off + i] & 0xff);
+            } else {
+                out << "   ";
+            }
+        }
+        out << "  |";
+        for (i = 0; i < per && off + i < s.size(); i++) {
+            char c = s[off + i];
+            out << ((isupper(c) || islower(c) || isdigit(c) || c == ' ' || ispunct(c)) ? c : '.');
+        }
+        out << '|' << std::dec;
+    }
+    if (trailing_newline) {
+        out << "\n" << std::hex << std::setw(8) << s.size() << "\n";
+    }
+    return out.str();
+}
+
+TEST(BufferList, hexdump_fuzz) {
+    std::mt19937 rng(3);
+    for (int round = 0; round < 300; ++round) {
+        // runs of the same byte to exercise the "*" rows
+        std::string s;
+        size_t len = rng() % (round < 200 ? 200 : 5000);
+        while (s.size() < len) {
+            size_t run = rng() % 3 ? 1 + rng() % 5 : 1 + rng() % 80;
+            s.append(std::min(run, len - s.size()), rng() % 4 ? (char)rng() : 'A');
+        }
+
+        buffer_list bl;
+        for (size_t pos = 0; pos < s.size(); ) {
+            size_t n = std::min<size_t>(rng() % (round % 2 ? 7 : 100), s.size() - pos);
+            bl.push_back(buffer_ptr(buffer::copy(s.data() + pos, n)));
+            pos += n;
+        }
+        for (bool trailing : {true, false}) {
+            std::ostringstream stream;
+            bl.hexdump(stream, trailing);
+            ASSERT_EQ(ref_hexdump(s, trailing), stream.str()) << "round " << round;
+        }
+    }
+}
+
+TEST(BufferList, BenchHexdump) {
+    const size_t size = 8 * 1024 * 1024;
+    buffer_list bl;
+    for (size_t pos = 0; pos < size; pos += 4096) {
+        buffer_ptr bp(buffer::create(4096));
+        for (unsigned i = 0; i < 4096; i++) {
+            bp.c_str()[i] = (pos / 4096) % 8 ? rand() : 0;
+        }
+        bl.push_back(std::move(bp));
+    }
+
+    std::ostringstream stream;
+    utime_t start = spec_clock_now();
+    bl.hexdump(stream);
+    utime_t elapsed = spec_clock_now() - start;
+    std::cout << "hexdump 8M in 4K segments: " << (double)elapsed << " sec, "
+              << stream.str().size() << " chars" << std::endl;
+}
+
 TEST(BufferList, read_file) {
     std::string error;
     buffer_list bl;
@@ -2240,6 +2599,89 @@ TEST(BufferList, write_fd_offset) {
     ::unlink(FILENAME);
 }
 
+TEST(BufferList, sparsify) {
+    const uint64_t bs = 4096;
+    // data/zero pattern of the blocks, the segments cross the blocks
+    const char *pattern = "DZZDZZZZDDZDZZZZZZZZz";   // z: short zero tail
+    std::string content;
+    for (const char *c = pattern; *c; ++c) {
+        std::string block(*c == 'z' ? 100 : bs, '\0');
+        if (*c == 'D') {
+            block[rand() % (bs / 2)] = 1 + rand() % 255;
+        }
+        content += block;
+    }
+    buffer_list bl;
+    for (size_t pos = 0; pos < content.size(); ) {
+        size_t n = std::min<size_t>(1000 + rand() % 7000, content.size() - pos);
+        bl.push_back(buffer_ptr(buffer::copy(content.data() + pos, n)));
+        pos += n;
+    }
+
+    auto bitmap = bl.scan_zero_blocks(bs);
+    ASSERT_EQ(1u, bitmap.size());
+    for (size_t i = 0; pattern[i]; ++i) {
+        EXPECT_EQ(pattern[i] != 'D', (bitmap[0] >> i) & 1) << i;
+    }
+    EXPECT_EQ(0u, bitmap[0] >> strlen(pattern));
+
+    auto to_string = [](const buffer_list& bl) {
+        std::string s;
+        for (const auto& node : bl.buffers()) {
+            s.append(node.c_str(), node.length());
+        }
+        return s;
+    };
+    bl.sparsify(bs);
+    EXPECT_EQ(content.size(), bl.length());
+    EXPECT_TRUE(content == to_string(bl));
+    bl.sparsify(bs);
+    EXPECT_EQ(bitmap, bl.scan_zero_blocks(bs));
+
+    // the zero runs share one raw
+    std::set<const char*> zero_raws;
+    uint64_t zero_bytes = 0;
+    for (const auto& node : bl.buffers()) {
+        if (node.is_zero() && node.length() >= bs) {
+            zero_raws.insert(node.raw_c_str());
+            zero_bytes += node.length();
+        }
+    }
+    EXPECT_EQ(1u, zero_raws.size());
+    EXPECT_EQ(15 * bs + 100, zero_bytes);
+
+    // the holes are punched over the old data, the size is kept
+    ::unlink(FILENAME);
+    int fd = ::open(FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0600);
+    ASSERT_NE(-1, fd);
+    std::string garbage(content.size() + 2 * bs, 'x');
+    ASSERT_EQ((ssize_t)garbage.size(), ::pwrite(fd, garbage.data(), garbage.size(), 0));
+    EXPECT_EQ(0, bl.write_fd(fd, bs));
+    std::string got(garbage.size(), '\0');
+    ASSERT_EQ((ssize_t)got.size(), ::pread(fd, &got[0], got.size(), 0));
+    EXPECT_TRUE(garbage.substr(0, bs) + content + garbage.substr(bs + content.size()) == got);
+
+    // a zero tail extends the file
+    ASSERT_EQ(0, ::ftruncate(fd, 0));
+    EXPECT_EQ(0, bl.write_fd(fd, 0));
+    struct stat st;
+    ASSERT_EQ(0, ::fstat(fd, &st));
+    EXPECT_EQ((off_t)content.size(), st.st_size);
+    std::cout << "sparse file: " << st.st_size << " bytes, "
+              << st.st_blocks * 512 << " allocated" << std::endl;
+    got.resize(content.size());
+    ASSERT_EQ((ssize_t)got.size(), ::pread(fd, &got[0], got.size(), 0));
+    EXPECT_TRUE(content == got);
+    ::close(fd);
+    ::unlink(FILENAME);
+
+    // zeroing skips the read-only zero area
+    bl.zero(bs / 2, bl.length() - bs / 2);
+    EXPECT_FALSE(bl.is_zero());
+    bl.zero();
+    EXPECT_TRUE(bl.is_zero());
+}
+
 TEST(BufferList, crc32c) {
     buffer_list bl;
     uint32_t crc = 0;
@@ -2289,6 +2731,73 @@ TEST(BufferList, crc32c_zeros) {
     }
 }
 
+TEST(BufferList, crc32c_per_block) {
+    const uint64_t block_size = 4096;
+    buffer_list bl;
+    // whole blocks, blocks across nodes and the short last block
+    for (uint64_t len : {8192, 100, 4000, 5000, 4096, 4096, 4096, 4096, 4096, 777}) {
+        buffer_ptr bp(len);
+        for (uint64_t i = 0; i < len; ++i) {
+            bp.c_str()[i] = rand();
+        }
+        bl.append(bp);
+    }
+
+    std::vector<uint32_t> crcs;
+    bl.crc32c_per_block(block_size, &crcs, 111);
+    ASSERT_EQ((bl.length() + block_size - 1) / block_size, crcs.size());
+
+    const char *p = bl.c_str();
+    for (uint64_t i = 0; i < crcs.size(); ++i) {
+        uint64_t len = std::min(block_size, bl.length() - i * block_size);
+        EXPECT_EQ(spec_crc32c(111, (unsigned char*)p + i * block_size, len),
+                  crcs[i]);
+    }
+
+    buffer_list empty;
+    empty.crc32c_per_block(block_size, &crcs);
+    EXPECT_TRUE(crcs.empty());
+}
+
+TEST(BufferList, checksum) {
+    buffer_list bl;
+    for (uint64_t len : {1, 100, 4096, 5000, 7}) {
+        buffer_ptr bp(len);
+        for (uint64_t i = 0; i < len; ++i) {
+            bp.c_str()[i] = rand();
+        }
+        bl.append(bp);
+    }
+    buffer_list flat;
+    flat.append(bl);
+    auto p = (const unsigned char*)flat.c_str();
+    ASSERT_EQ(5u, bl.get_num_buffers());
+
+    for (int type : {SPEC_CSUM_CRC32C, SPEC_CSUM_CRC64, SPEC_CSUM_XXH64}) {
+        buffer_list copy(bl);
+        // miss, hit and the adjusted cache
+        for (uint64_t seed : {111, 111, 222}) {
+            EXPECT_EQ(spec_checksum(type, seed, p, flat.length()),
+                      copy.checksum(type, seed));
+        }
+    }
+    EXPECT_EQ(bl.crc32c(333), bl.checksum(SPEC_CSUM_CRC32C, 333));
+    EXPECT_EQ(0u, bl.checksum(SPEC_CSUM_NONE, 333));
+    EXPECT_EQ(0u, bl.checksum(SPEC_CSUM_MAX, 333));
+
+    // the cache slot is shared, a crc64 value is never used as crc32c
+    buffer_list one;
+    one.append((const char*)p, flat.length());
+    uint64_t crc64 = one.checksum(SPEC_CSUM_CRC64, 0);
+    EXPECT_EQ(spec_crc32c(0, p, flat.length()), one.crc32c(0));
+    EXPECT_EQ(crc64, one.checksum(SPEC_CSUM_CRC64, 0));
+
+    // modification drops the cached value
+    one.c_str()[0]++;
+    one.invalidate_crc();
+    EXPECT_NE(crc64, one.checksum(SPEC_CSUM_CRC64, 0));
+}
+
 TEST(BufferList, crc32c_append_perf) {
     int len = 256 * 1024 * 1024;
     buffer_ptr a(len);
@@ -2757,3 +3266,115 @@ TEST(BufferHash, all) {
     EXPECT_EQ(0xB3109EBF, hash.digest());
     }
 }
+
+TEST(BufferHash, combine) {
+    std::mt19937 rng(17);
+    std::vector<buffer_list> lists(40);
+    std::string all;
+    for (auto& bl : lists) {
+        for (int seg = rng() % 6; seg > 0; --seg) {
+            std::string s(rng() % 3000, '\0');
+            for (auto& c : s) {
+                c = rng();
+            }
+            bl.push_back(buffer_ptr(buffer::copy(s.data(), s.size())));
+            all += s;
+        }
+    }
+    std::vector<const buffer_list*> ptrs;
+    for (auto& bl : lists) {
+        ptrs.push_back(&bl);
+    }
+
+    using width = buffer_hash::width;
+    for (auto w : {width::bits32, width::bits64, width::bits128}) {
+        buffer_hash serial(w, 5);
+        for (auto& bl : lists) {
+            serial.update(bl);
+        }
+        EXPECT_EQ(all.size(), serial.length());
+
+        buffer_hash flat(w, 5);
+        flat.update(all.data(), all.size());
+        EXPECT_EQ(serial.digest128(), flat.digest128());
+        EXPECT_EQ(serial.length(), flat.length());
+        EXPECT_EQ(serial.digest64(), flat.digest64());
+
+        buffer_hash multi(w, 5);
+        multi.update(ptrs.data(), ptrs.size());
+        EXPECT_EQ(serial.digest128(), multi.digest128());
+        EXPECT_EQ(serial.length(), multi.length());
+        EXPECT_EQ(serial.digest64(), multi.digest64());
+
+        // split at every 7th list, the parts start from any seed
+        buffer_hash combined(w, 5);
+        for (size_t i = 0; i < lists.size(); i += 7) {
+            buffer_hash part(w, i);
+            size_t n = std::min<size_t>(7, lists.size() - i);
+            part.update(ptrs.data() + i, n);
+            combined.combine(part);
+        }
+        EXPECT_EQ(serial.digest128(), combined.digest128());
+        EXPECT_EQ(serial.length(), combined.length());
+        EXPECT_EQ(serial.digest64(), combined.digest64());
+    }
+
+    // the default width is compatible with the crc32c chain
+    buffer_hash h32(7);
+    uint32_t crc = 7;
+    for (auto& bl : lists) {
+        h32 << bl;
+        crc = bl.crc32c(crc);
+    }
+    EXPECT_EQ(crc, h32.digest());
+    // CRC-64/XZ check value
+    buffer_hash h64(buffer_hash::width::bits64, ~0ULL);
+    h64.update("123456789", 9);
+    EXPECT_EQ(0x995dc9bbdf1939faULL, ~h64.digest64());
+}
+
+TEST(BufferHash, Bench) {
+    // many lists of small segments: the serial chain is bound by the
+    // latency of the crc instruction
+    const int num_lists = 4096;
+    const unsigned seg_size = 512;
+    auto make = [&] {
+        std::vector<buffer_list> lists(num_lists);
+        for (auto& bl : lists) {
+            for (int seg = 0; seg < 8; ++seg) {
+                buffer_ptr bp(buffer::create(seg_size));
+                memset(bp.c_str(), seg, seg_size);
+                bl.push_back(std::move(bp));
+            }
+        }
+        return lists;
+    };
+    double mb = (double)num_lists * 8 * seg_size / (1024 * 1024);
+
+    auto lists = make();
+    utime_t start = spec_clock_now();
+    buffer_hash serial;
+    for (auto& bl : lists) {
+        serial.update(bl);
+    }
+    utime_t elapsed = spec_clock_now() - start;
+    std::cout << "serial crc32c chain: " << mb / (double)elapsed << " MB/sec" << std::endl;
+
+    lists = make();
+    std::vector<const buffer_list*> ptrs;
+    for (auto& bl : lists) {
+        ptrs.push_back(&bl);
+    }
+    start = spec_clock_now();
+    buffer_hash multi;
+    multi.update(ptrs.data(), ptrs.size());
+    elapsed = spec_clock_now() - start;
+    std::cout << "multi crc32c + combine: " << mb / (double)elapsed << " MB/sec" << std::endl;
+    EXPECT_EQ(serial.digest(), multi.digest());
+
+    start = spec_clock_now();
+    buffer_hash wide(buffer_hash::width::bits128);
+    wide.update(ptrs.data(), ptrs.size());
+    elapsed = spec_clock_now() - start;
+    std::cout << "multi 128-bit: " << mb / (double)elapsed << " MB/sec" << std::endl;
+}
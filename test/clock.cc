@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "clock/spec_clock.h"
+
+#include "gtest/gtest.h"
+
+TEST(NsTime, arith) {
+    nstime_t a(1500000000ull), b(500000000ull);
+    EXPECT_EQ(2000000000ull, (a + b).to_nsec());
+    EXPECT_EQ(1000000000ull, (a - b).to_nsec());
+    EXPECT_EQ(0ull, (b - a).to_nsec());
+    EXPECT_TRUE(b < a);
+    EXPECT_TRUE(a >= a);
+    EXPECT_EQ(1u, a.sec());
+    EXPECT_EQ(500000000u, a.nsec());
+    EXPECT_EQ(1500u, a.to_msec());
+
+    utime_t ut = a.to_utime();
+    EXPECT_EQ(1, ut.sec());
+    EXPECT_EQ(500000000u, ut.nsec());
+    EXPECT_EQ(a, nstime_t(ut));
+
+    std::ostringstream os;
+    os << nstime_t(3000000042ull);
+    EXPECT_EQ("3.000000042", os.str());
+}
+
+TEST(SpecClock, monotonic) {
+    nstime_t prev = spec_mono_now();
+    for (int i = 0; i < 100000; ++i) {
+        nstime_t now = spec_mono_now();
+        ASSERT_LE(prev, now);
+        prev = now;
+    }
+    prev = spec_tsc_now();
+    for (int i = 0; i < 100000; ++i) {
+        nstime_t now = spec_tsc_now();
+        ASSERT_LE(prev, now);
+        prev = now;
+    }
+}
+
+TEST(SpecClock, tsc) {
+    // the tsc clock follows CLOCK_MONOTONIC
+    nstime_t mono0 = spec_mono_now();
+    nstime_t tsc0 = spec_tsc_now();
+    uint64_t c0 = spec_tsc_cycles();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    uint64_t c1 = spec_tsc_cycles();
+    nstime_t tsc1 = spec_tsc_now();
+    nstime_t mono1 = spec_mono_now();
+
+    int64_t skew = (int64_t)tsc0.to_nsec() - (int64_t)mono0.to_nsec();
+    EXPECT_LT(llabs(skew), 1000000);
+    uint64_t mono = (mono1 - mono0).to_nsec();
+    uint64_t tsc = (tsc1 - tsc0).to_nsec();
+    EXPECT_LT(llabs((int64_t)tsc - (int64_t)mono), 1000000);
+    uint64_t cycles_ns = spec_tsc_to_ns(c1 - c0);
+    EXPECT_LT(llabs((int64_t)cycles_ns - (int64_t)mono), 1000000);
+
+    // the coarse one lags by a tick at most
+    nstime_t coarse = spec_mono_coarse_now();
+    EXPECT_LE(coarse, spec_mono_now());
+    EXPECT_LT((spec_mono_now() - coarse).to_nsec(), 100000000ull);
+}
+
+TEST(SpecClock, Bench) {
+    const int n = 10000000;
+    auto bench = [](const char *name, auto&& fn) {
+        uint64_t sum = 0;
+        nstime_t start = spec_mono_now();
+        for (int i = 0; i < n; ++i) {
+            sum += fn();
+        }
+        nstime_t elapsed = spec_mono_now() - start;
+        std::cout << name << ": " << elapsed.to_nsec() / (double)n << "ns/call"
+                  << std::endl;
+        return sum;
+    };
+
+    spec_tsc_cycles();
+    uint64_t sum = 0;
+    sum += bench("spec_clock_now", [] { return spec_clock_now().to_nsec(); });
+    sum += bench("spec_mono_now", [] { return spec_mono_now().to_nsec(); });
+    sum += bench("spec_mono_coarse_now", [] { return spec_mono_coarse_now().to_nsec(); });
+    sum += bench("std::chrono::steady_clock", [] {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    });
+    sum += bench("spec_tsc_now", [] { return spec_tsc_now().to_nsec(); });
+    sum += bench("spec_tsc_cycles", [] { return spec_tsc_cycles(); });
+    EXPECT_NE(0u, sum);
+}
@@ -0,0 +1,890 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "clock/spec_clock.h"
+#include "context/combinators.h"
+#include "context/completion.h"
+#include "context/coroutine.h"
+#include "context/finisher.h"
+#include "context/timer_wheel.h"
+#include "Context.h"
+
+#include "gtest/gtest.h"
+
+using namespace spec;
+
+class C_Count : public Context {
+private:
+    int *m_result;
+
+protected:
+    void finish(int r) override {
+        *m_result = r;
+    }
+
+public:
+    explicit C_Count(int *result) : m_result(result) {}
+};
+
+TEST(Completion, create) {
+    int result = 0;
+    completion::create([&result](int r) { result = r; })->complete(3);
+    EXPECT_EQ(3, result);
+
+    // too big to be inline
+    char big[100] = {7};
+    completion::create([&result, big](int r) { result = r + big[0]; })->complete(1);
+    EXPECT_EQ(8, result);
+
+    // the captures are destroyed without running
+    auto sp = std::make_shared<int>(0);
+    auto c0 = completion::create([sp](int r) { *sp = r; });
+    auto c1 = completion::create([sp, big](int r) { *sp = r; });
+    EXPECT_EQ(3, sp.use_count());
+    c0->release();
+    c1->release();
+    EXPECT_EQ(1, sp.use_count());
+    EXPECT_EQ(0, *sp);
+}
+
+TEST(Completion, context) {
+    int result = 0;
+    completion::wrap(new C_Count(&result))->complete(5);
+    EXPECT_EQ(5, result);
+
+    auto sp = Context::create<C_Count>(&result);
+    completion::wrap(sp.get())->complete(6);
+    EXPECT_EQ(6, result);
+
+    (new C_Completion(completion::create([&result](int r) { result = r; })))->complete(7);
+    EXPECT_EQ(7, result);
+
+    // dropping the Context releases the completion
+    auto counter = std::make_shared<int>(0);
+    delete new C_Completion(completion::create([counter](int r) { *counter = r; }));
+    EXPECT_EQ(1, counter.use_count());
+
+    // and releasing the completion drops the Context without finishing it
+    result = 0;
+    completion::wrap(new C_Completion(completion::create([counter](int r) { *counter = r; })))
+        ->release();
+    EXPECT_EQ(1, counter.use_count());
+    std::weak_ptr<C_Count> wp;
+    {
+        auto ref = Context::create<C_Count>(&result);
+        wp = ref;
+        completion::wrap(ref.get())->release();
+    }
+    EXPECT_TRUE(wp.expired());
+    EXPECT_EQ(0, result);
+}
+
+TEST(Completion, cross_thread) {
+    // created by one thread, completed by the other
+    const int n = 200000;
+    std::atomic<uint64_t> done{0};
+    std::vector<completion*> cs;
+    for (int round = 0; round < 4; ++round) {
+        cs.clear();
+        for (int i = 0; i < n; ++i) {
+            cs.push_back(completion::create([&done](int r) { done += r; }));
+        }
+        std::thread t([&] {
+            for (auto c : cs) {
+                c->complete(1);
+            }
+        });
+        t.join();
+    }
+    EXPECT_EQ(4u * n, done.load());
+
+    // the completions came back to the global pool at the thread exit
+    auto stats = completion::get_pool_stats();
+    EXPECT_LE(n, stats.global_free);
+    EXPECT_LE(stats.slabs * 64, stats.global_free + 2048);
+}
+
+// a thread_local destroyed after the completion cache of its thread
+struct late_release {
+    completion *c = nullptr;
+
+    ~late_release() {
+        if (c) {
+            c->complete(0);
+            completion::create([](int r) {})->complete(0);
+        }
+    }
+};
+
+thread_local late_release tl_late;
+
+TEST(Completion, thread_exit) {
+    auto before = completion::get_pool_stats();
+    std::thread t([] {
+        // constructed before the cache, so destroyed after it
+        late_release& late = tl_late;
+        late.c = completion::create([](int r) {});
+    });
+    t.join();
+
+    // everything the thread took is back, the late one included
+    auto after = completion::get_pool_stats();
+    EXPECT_EQ(before.global_free + (after.slabs - before.slabs) * 64,
+              after.global_free);
+
+    // and the global freelist is still sound
+    std::vector<completion*> cs;
+    for (uint64_t i = 0; i < after.global_free + 64; ++i) {
+        cs.push_back(completion::create([](int r) {}));
+    }
+    std::sort(cs.begin(), cs.end());
+    EXPECT_EQ(cs.end(), std::adjacent_find(cs.begin(), cs.end()));
+    for (auto c : cs) {
+        c->complete(0);
+    }
+}
+
+TEST(Completion, Bench) {
+    const int rounds = 2000000;
+    int result = 0;
+    auto bench = [&](const char *name, auto&& fn) {
+        utime_t start = spec_clock_now();
+        for (int i = 0; i < rounds; ++i) {
+            fn(i);
+        }
+        utime_t elapsed = spec_clock_now() - start;
+        std::cout << name << ": " << rounds / (double)elapsed << " ops/sec" << std::endl;
+    };
+
+    bench("Context::create", [&](int i) {
+        Context::create<C_Count>(&result)->complete(i);
+    });
+    bench("new Context", [&](int i) {
+        (new C_Count(&result))->complete(i);
+    });
+    bench("completion", [&](int i) {
+        completion::create([&result](int r) { result = r; })->complete(i);
+    });
+    EXPECT_EQ(rounds - 1, result);
+
+    // ping-pong: each side completes the other's completion and replies
+    const int pings = 100000;
+    std::atomic<completion*> to_b{nullptr}, to_a{nullptr};
+    uint64_t sum = 0;
+    auto take = [](std::atomic<completion*>& slot) {
+        completion *c;
+        while (!(c = slot.exchange(nullptr, std::memory_order_acquire))) {
+            std::this_thread::yield();
+        }
+        return c;
+    };
+    utime_t start = spec_clock_now();
+    std::thread b([&] {
+        for (int i = 0; i < pings; ++i) {
+            take(to_b)->complete(i);
+            to_a.store(completion::create([&sum](int r) { sum += r; }),
+                       std::memory_order_release);
+        }
+    });
+    for (int i = 0; i < pings; ++i) {
+        to_b.store(completion::create([&sum](int r) { sum += r; }),
+                   std::memory_order_release);
+        take(to_a)->complete(1);
+    }
+    b.join();
+    utime_t elapsed = spec_clock_now() - start;
+    std::cout << "completion ping-pong: " << 2 * pings / (double)elapsed
+              << " ops/sec" << std::endl;
+    EXPECT_EQ((uint64_t)pings * (pings - 1) / 2 + pings, sum);
+}
+
+class C_Sync : public Context {
+private:
+    std::atomic<int> *m_count;
+
+protected:
+    void finish(int r) override {
+        *m_count += r;
+    }
+
+    bool sync_finish(int r) override {
+        *m_count += r * 100;
+        return true;
+    }
+
+public:
+    explicit C_Sync(std::atomic<int> *count) : m_count(count) {}
+};
+
+TEST(Finisher, queue) {
+    finisher fin(4);
+    EXPECT_EQ(4u, fin.num_workers());
+
+    std::atomic<int> count{0};
+    int result = 0;
+    fin.queue(new C_Count(&result), 9);
+    fin.queue([&count](int r) { count += r; }, 2);
+    fin.queue(completion::create([&count](int r) { count += r; }), 3);
+    // completed by the caller, not queued
+    fin.queue(new C_Sync(&count), 1);
+    EXPECT_EQ(100, count.load() / 100 * 100);
+    fin.wait_for_empty();
+    EXPECT_EQ(9, result);
+    EXPECT_EQ(105, count.load());
+
+    auto perf = fin.get_perf();
+    EXPECT_EQ(3u, perf.queued);
+    EXPECT_EQ(3u, perf.completed);
+    EXPECT_EQ(1u, perf.sync_completed);
+    EXPECT_EQ(0u, perf.queue_depth);
+    EXPECT_EQ(3u, perf.latency_count);
+}
+
+TEST(Finisher, producers) {
+    const int producers = 4, n = 100000;
+    std::atomic<uint64_t> sum{0};
+    std::atomic<int> requeued{0};
+    finisher::options opts(3);
+    opts.deque_size = 64;       // overflow the deques
+    opts.pin_cpus = true;
+    {
+        finisher fin(opts);
+        std::vector<std::thread> ts;
+        for (int p = 0; p < producers; ++p) {
+            ts.emplace_back([&] {
+                for (int i = 0; i < n; ++i) {
+                    if (i % 100) {
+                        fin.queue([&sum](int r) { sum += r; }, 1);
+                        continue;
+                    }
+                    // queued from the workers
+                    fin.queue([&](int r) {
+                        for (int j = 0; j < 100; ++j) {
+                            fin.queue([&requeued](int r) { requeued += r; }, 1);
+                        }
+                        sum += r;
+                    }, 1);
+                }
+            });
+        }
+        for (auto& t : ts) {
+            t.join();
+        }
+        fin.wait_for_empty();
+        auto perf = fin.get_perf();
+        EXPECT_EQ(perf.queued, perf.completed);
+        EXPECT_EQ((uint64_t)producers * n * 2, perf.completed);
+        // the destructor completes the rest
+    }
+    EXPECT_EQ((uint64_t)producers * n, sum.load());
+    EXPECT_EQ(producers * n, requeued.load());
+}
+
+TEST(Finisher, steal) {
+    // one worker is blocked, the others steal its items
+    finisher fin(2);
+    std::atomic<bool> block{true};
+    std::atomic<int> count{0};
+    fin.queue([&](int r) {
+        for (int i = 0; i < 1000; ++i) {
+            fin.queue([&count](int r) { count++; });
+        }
+        while (block) {
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < 200 && count < 1000; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1000, count.load());
+    EXPECT_LE(1000u, fin.get_perf().stolen);
+    block = false;
+    fin.wait_for_empty();
+}
+
+TEST(Finisher, Bench) {
+    const int n = 1000000;
+    for (unsigned threads : {1, 2}) {
+        std::atomic<uint64_t> sum{0};
+        finisher fin(threads);
+        utime_t start = spec_clock_now();
+        for (int i = 0; i < n; ++i) {
+            fin.queue([&sum](int r) { sum.fetch_add(r, std::memory_order_relaxed); }, 1);
+        }
+        fin.wait_for_empty();
+        utime_t elapsed = spec_clock_now() - start;
+        auto perf = fin.get_perf();
+        std::cout << "finisher " << threads << " workers: " << n / (double)elapsed
+                  << " ops/sec, avg latency " << perf.avg_latency_ns()
+                  << "ns, max " << perf.latency_max_ns << "ns, stolen "
+                  << perf.stolen << std::endl;
+        EXPECT_EQ((uint64_t)n, sum.load());
+    }
+}
+
+class C_Result : public Context {
+private:
+    std::atomic<int> *m_result;
+    std::atomic<int> *m_calls;
+
+protected:
+    void finish(int r) override {
+        m_result->store(r);
+        (*m_calls)++;
+    }
+
+public:
+    C_Result(std::atomic<int> *result, std::atomic<int> *calls)
+        : m_result(result), m_calls(calls) {}
+};
+
+TEST(Combinators, gather) {
+    std::atomic<int> result{1}, calls{0};
+
+    // 2 of 3, the quorum is met by the 2nd
+    auto g = C_Gather::create(new C_Result(&result, &calls), 3, 2);
+    g->sub(0)->complete(0);
+    g->sub(2)->complete(-EIO);
+    EXPECT_EQ(0, calls.load());
+    g->sub(1)->complete(5);
+    EXPECT_EQ(1, calls.load());
+    EXPECT_EQ(0, result.load());
+
+    // all of 3, the first error fails it at once
+    g = C_Gather::create(new C_Result(&result, &calls), 3);
+    g->sub(0)->complete(-ENOENT);
+    EXPECT_EQ(2, calls.load());
+    EXPECT_EQ(-ENOENT, result.load());
+    g->sub(1)->complete(-EIO);
+    g->sub(2)->complete(0);
+    EXPECT_EQ(2, calls.load());
+
+    // wait for all, the errors disagree
+    g = C_Gather::create(new C_Result(&result, &calls), 4, 3,
+                         gather_error::aggregate, true);
+    g->sub(0)->complete(-ENOENT);
+    g->sub(1)->complete(-ENOENT);
+    EXPECT_EQ(2, calls.load());
+    g->sub(2)->complete(-EINVAL);
+    g->sub(3)->complete(0);
+    EXPECT_EQ(3, calls.load());
+    EXPECT_EQ(-EIO, result.load());
+
+    g = C_Gather::create(new C_Result(&result, &calls), 2, 2, gather_error::aggregate);
+    g->sub(1)->complete(-ENOENT);
+    g->sub(0)->complete(-ENOENT);
+    EXPECT_EQ(4, calls.load());
+    EXPECT_EQ(-ENOENT, result.load());
+}
+
+TEST(Combinators, chain) {
+    std::atomic<int> result{1}, calls{0};
+    std::vector<int> steps;
+
+    auto chain = new C_Chain(new C_Result(&result, &calls));
+    chain->then([&](Context *next) { steps.push_back(1); next->complete(0); })
+         .then([&](Context *next) {
+             // completed by another thread
+             std::thread([next, &steps] { steps.push_back(2); next->complete(7); }).detach();
+         });
+    chain->start();
+    while (!calls) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(std::vector<int>({1, 2}), steps);
+    EXPECT_EQ(7, result.load());
+
+    chain = new C_Chain(new C_Result(&result, &calls));
+    chain->then([](Context *next) { next->complete(-EAGAIN); })
+         .then([&](Context *next) { steps.push_back(3); next->complete(0); });
+    chain->start();
+    EXPECT_EQ(2, calls.load());
+    EXPECT_EQ(-EAGAIN, result.load());
+    EXPECT_EQ(2u, steps.size());
+}
+
+TEST(Combinators, on_error) {
+    std::atomic<int> result{1}, calls{0};
+    int errors = 0;
+    make_on_error(new C_Result(&result, &calls), [&](int r) { errors++; })->complete(3);
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(3, result.load());
+    make_on_error(new C_Result(&result, &calls), [&](int r) { errors++; })->complete(-EIO);
+    EXPECT_EQ(1, errors);
+    EXPECT_EQ(-EIO, result.load());
+    make_on_error(nullptr, [&](int r) { errors++; })->complete(-EIO);
+    EXPECT_EQ(2, errors);
+}
+
+TEST(Combinators, timeout) {
+    std::atomic<int> result{1}, calls{0};
+
+    auto to = new C_Timeout(new C_Result(&result, &calls));
+    Context *expiry = to->expiry();
+    to->complete(4);
+    expiry->complete(0);
+    EXPECT_EQ(1, calls.load());
+    EXPECT_EQ(4, result.load());
+
+    to = new C_Timeout(new C_Result(&result, &calls));
+    expiry = to->expiry();
+    expiry->complete(0);
+    to->complete(4);
+    EXPECT_EQ(2, calls.load());
+    EXPECT_EQ(-ETIMEDOUT, result.load());
+
+    // the timer is canceled
+    to = new C_Timeout(new C_Result(&result, &calls));
+    delete to->expiry();
+    to->complete(5);
+    EXPECT_EQ(3, calls.load());
+    EXPECT_EQ(5, result.load());
+}
+
+TEST(Combinators, stress) {
+    // every sub and expiry is completed by a random thread
+    const int rounds = 20000, threads = 4;
+    std::atomic<int> calls{0};
+    std::vector<std::atomic<int>> results(rounds);
+    std::vector<std::vector<std::pair<Context*, int>>> work(threads);
+    std::vector<int> expected(rounds);
+    std::mt19937 rng(42);
+
+    for (int i = 0; i < rounds; ++i) {
+        uint32_t total = rng() % 7 + 1;
+        uint32_t quorum = rng() % total + 1;
+        uint32_t fails = rng() % (total + 1);
+        expected[i] = total - fails >= quorum ? 0 : -EIO;
+
+        auto to = new C_Timeout(new C_Result(&results[i], &calls));
+        work[rng() % threads].emplace_back(to->expiry(), 0);
+        auto g = C_Gather::create(to, total, quorum, gather_error::aggregate, rng() % 2);
+        for (uint32_t j = 0; j < total; ++j) {
+            work[rng() % threads].emplace_back(g->sub(j), j < fails ? -EIO : 0);
+        }
+    }
+    for (auto& w : work) {
+        std::shuffle(w.begin(), w.end(), rng);
+    }
+
+    std::vector<std::thread> ts;
+    std::atomic<int> ready{0};
+    for (int t = 0; t < threads; ++t) {
+        ts.emplace_back([&, t] {
+            ready++;
+            while (ready < threads) {
+            }
+            for (auto [c, r] : work[t]) {
+                c->complete(r);
+            }
+        });
+    }
+    for (auto& t : ts) {
+        t.join();
+    }
+
+    EXPECT_EQ(rounds, calls.load());
+    int timed_out = 0;
+    for (int i = 0; i < rounds; ++i) {
+        int r = results[i].load();
+        if (r == -ETIMEDOUT) {
+            timed_out++;
+        } else {
+            EXPECT_EQ(expected[i], r);
+        }
+    }
+    std::cout << "timed out " << timed_out << " of " << rounds << std::endl;
+}
+
+// record the tick it fires at
+class C_Tick : public Context {
+private:
+    const uint64_t *m_now;
+    uint64_t *m_fired;
+
+protected:
+    void finish(int r) override {
+        *m_fired = *m_now;
+    }
+
+public:
+    C_Tick(const uint64_t *now, uint64_t *fired) : m_now(now), m_fired(fired) {}
+};
+
+TEST(TimerWheel, advance) {
+    const uint64_t ms = 1000000;
+    timer_wheel wheel(ms);
+    uint64_t base = timer_wheel::clock_ns() / ms * ms + 10 * ms;
+    uint64_t now = 0;
+    wheel.advance_to(base);
+
+    // the delays cover all the levels, and beyond
+    std::vector<uint64_t> delays = {0, 1, 5, 63, 64, 65, 100, 4095, 4096, 4097,
+                                    262143, 262144, 300000, 16777216,
+                                    (1ULL << 36) + 12345};
+    std::vector<uint64_t> fired(delays.size(), 0);
+    std::vector<timer_wheel::timer_id> ids;
+    for (size_t i = 0; i < delays.size(); ++i) {
+        ids.push_back(wheel.add_at_ns(base + delays[i] * ms, new C_Tick(&now, &fired[i])));
+    }
+    EXPECT_EQ(delays.size(), wheel.size());
+    EXPECT_EQ(base, wheel.next_expiry_ns());
+
+    // fired exactly at the tick
+    for (size_t i = 0; i < delays.size(); ++i) {
+        if (i) {
+            now = delays[i] - 1;
+            EXPECT_EQ(0u, wheel.advance_to(base + now * ms)) << delays[i];
+            EXPECT_LE(wheel.next_expiry_ns(), base + delays[i] * ms);
+        }
+        now = delays[i];
+        wheel.advance_to(base + now * ms + ms / 2);
+        EXPECT_EQ(delays[i], fired[i]);
+        // skip the ones which are due at the same time
+        while (i + 1 < delays.size() && delays[i + 1] <= now) {
+            ++i;
+        }
+    }
+    EXPECT_EQ(0u, wheel.size());
+    EXPECT_EQ(UINT64_MAX, wheel.next_expiry_ns());
+    EXPECT_EQ(-1, wheel.next_timeout_ms());
+    EXPECT_FALSE(wheel.cancel(ids[0]));
+
+    // never early: 1.5ms fires at 2ms
+    uint64_t f = 0;
+    wheel.add_at_ns(base + delays.back() * ms + 1500000, new C_Tick(&now, &f));
+    now = 1;
+    EXPECT_EQ(0u, wheel.advance_to(base + delays.back() * ms + 1999999));
+    now = 2;
+    EXPECT_EQ(1u, wheel.advance_to(base + delays.back() * ms + 2000000));
+    EXPECT_EQ(2u, f);
+}
+
+TEST(TimerWheel, boundary) {
+    const uint64_t ms = 1000000;
+    timer_wheel wheel(ms);
+    uint64_t t0 = timer_wheel::clock_ns() / ms;
+    // the tick before a 64 ticks boundary
+    uint64_t b = (t0 / 64 + 3) * 64 + 63;
+    uint64_t now = 0;
+    uint64_t f1 = 0, f2 = 0;
+    wheel.add_at_ns(b * ms, new C_Tick(&now, &f1));
+    wheel.add_at_ns((b + 3) * ms, new C_Tick(&now, &f2));
+
+    // one advance across the boundary fires both
+    now = 10;
+    EXPECT_EQ(2u, wheel.advance_to((b + 10) * ms));
+    EXPECT_EQ(10u, f1);
+    EXPECT_EQ(10u, f2);
+    EXPECT_EQ(0u, wheel.size());
+
+    // the same, from the tick ending in 63 with the cascade pending
+    wheel.add_at_ns((b + 64) * ms, new C_Tick(&now, &f1));
+    wheel.add_at_ns((b + 64 + 3) * ms, new C_Tick(&now, &f2));
+    wheel.add_at_ns((b + 64 + 4096 + 5) * ms, new C_Tick(&now, &f2));
+    now = 63;
+    EXPECT_EQ(0u, wheel.advance_to((b + 63) * ms));
+    now = 64;
+    EXPECT_EQ(1u, wheel.advance_to((b + 64) * ms));
+    EXPECT_EQ(64u, f1);
+    EXPECT_EQ((b + 64 + 3) * ms, wheel.next_expiry_ns());
+    now = 70;
+    EXPECT_EQ(1u, wheel.advance_to((b + 70) * ms));
+    EXPECT_EQ(70u, f2);
+    EXPECT_LE(wheel.next_expiry_ns(), (b + 64 + 4096 + 5) * ms);
+    now = 4096 + 68;
+    EXPECT_EQ(0u, wheel.advance_to((b + 64 + 4096 + 4) * ms));
+    now = 4096 + 69;
+    EXPECT_EQ(1u, wheel.advance_to((b + 64 + 4096 + 5) * ms));
+    EXPECT_EQ(4096u + 69, f2);
+}
+
+TEST(TimerWheel, cancel) {
+    timer_wheel wheel;
+    uint64_t base = timer_wheel::clock_ns();
+    auto count = std::make_shared<int>(0);
+    std::vector<timer_wheel::timer_id> ids;
+    for (int i = 0; i < 1000; ++i) {
+        ids.push_back(wheel.add_at_ns(base + i * 100000000ULL,
+                                      new C_Completion(completion::create(
+                                          [count](int r) { (*count)++; }))));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        EXPECT_TRUE(wheel.cancel(ids[i]));
+        EXPECT_FALSE(wheel.cancel(ids[i]));
+    }
+    EXPECT_EQ(500, count.use_count() - 1);
+    wheel.advance_to(base + 1000 * 100000000ULL);
+    EXPECT_EQ(500, *count);
+    EXPECT_EQ(0u, wheel.size());
+
+    // the ids of the reused nodes differ
+    auto id = wheel.add_after(1000000000, new C_Completion(completion::create(
+                                  [count](int r) { (*count)++; })));
+    for (auto old : ids) {
+        EXPECT_NE(old, id);
+    }
+    // the destructor deletes the pending ones
+}
+
+TEST(TimerWheel, thread) {
+    finisher fin(1);
+    timer_wheel wheel(1000000, &fin);
+    wheel.start();
+
+    std::atomic<int> result{1}, calls{0};
+    uint64_t start = timer_wheel::clock_ns();
+    wheel.add_after(20000000, new C_Result(&result, &calls));
+    // an earlier one wakes the thread
+    wheel.add_after(5000000, new C_Result(&result, &calls));
+
+    // the op is too slow
+    auto to = new C_Timeout(new C_Result(&result, &calls));
+    wheel.add_after(10000000, to->expiry());
+    while (calls < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_LE(20000000u, timer_wheel::clock_ns() - start);
+    EXPECT_EQ(3, calls.load());
+    to->complete(0);
+    fin.wait_for_empty();
+    EXPECT_EQ(3, calls.load());
+
+    // the op is in time
+    to = new C_Timeout(new C_Result(&result, &calls));
+    auto id = wheel.add_after(1000000000, to->expiry());
+    to->complete(0);
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_EQ(4, calls.load());
+    EXPECT_EQ(0, result.load());
+    wheel.stop();
+}
+
+TEST(TimerWheel, Bench) {
+    // 2M timers over 10 minutes of 1ms ticks, half of them are canceled
+    const uint64_t ms = 1000000, n = 2000000, span = 600000;
+    timer_wheel wheel(ms);
+    uint64_t base = timer_wheel::clock_ns() / ms * ms + ms;
+    wheel.advance_to(base);
+
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> due(n), fired(n, 0);
+    std::vector<timer_wheel::timer_id> ids(n);
+    uint64_t now = 0;
+
+    auto t0 = timer_wheel::clock_ns();
+    for (uint64_t i = 0; i < n; ++i) {
+        due[i] = rng() % span;
+        ids[i] = wheel.add_at_ns(base + due[i] * ms, new C_Tick(&now, &fired[i]));
+    }
+    auto t1 = timer_wheel::clock_ns();
+    for (uint64_t i = 0; i < n; i += 2) {
+        wheel.cancel(ids[i]);
+    }
+    auto t2 = timer_wheel::clock_ns();
+    EXPECT_EQ(n / 2, wheel.size());
+
+    size_t total = 0;
+    for (now = 1; now <= span; ++now) {
+        total += wheel.advance_to(base + now * ms);
+    }
+    auto t3 = timer_wheel::clock_ns();
+    EXPECT_EQ(n / 2, total);
+
+    uint64_t wrong = 0;
+    for (uint64_t i = 1; i < n; i += 2) {
+        // the ones due at 0 fire at the first advance
+        wrong += fired[i] != std::max<uint64_t>(due[i], 1);
+    }
+    EXPECT_EQ(0u, wrong);
+    std::cout << "insert " << (t1 - t0) / n << "ns, cancel " << (t2 - t1) * 2 / n
+              << "ns, advance " << (t3 - t2) / span << "ns/tick with "
+              << (t3 - t2) * 2 / n << "ns per fired timer" << std::endl;
+}
+
+TEST(Coroutine, yield) {
+    co_scheduler sched(2);
+    EXPECT_FALSE(co_scheduler::in_coroutine());
+    std::atomic<int> steps{0};
+    std::vector<int> order;
+    // spawned by the core itself, all queued before they run
+    sched.spawn_on(0, [&] {
+        for (int i = 0; i < 4; ++i) {
+            sched.spawn_on(0, [&, i] {
+                EXPECT_TRUE(co_scheduler::in_coroutine());
+                EXPECT_EQ(&sched, co_scheduler::scheduler());
+                for (int j = 0; j < 3; ++j) {
+                    order.push_back(i);
+                    steps++;
+                    co_scheduler::yield();
+                }
+            });
+        }
+    });
+    for (int i = 0; i < 1000; ++i) {
+        sched.spawn([&] {
+            co_scheduler::yield();
+            steps++;
+        });
+    }
+    sched.wait_for_empty();
+    EXPECT_EQ(1012, steps.load());
+    // round robin on the core
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3}), order);
+}
+
+TEST(Coroutine, await) {
+    co_scheduler sched(2);
+    finisher fin(2);
+    std::atomic<int> done{0};
+
+    sched.spawn_on(0, [&] {
+        // inline
+        EXPECT_EQ(3, co_scheduler::await([](Context *c) { c->complete(3); }));
+        // by another thread
+        EXPECT_EQ(4, co_scheduler::await([&](Context *c) { fin.queue(c, 4); }));
+        // fan-out
+        int r = co_scheduler::await([&](Context *c) {
+            auto g = C_Gather::create(c, 8);
+            for (uint32_t i = 0; i < 8; ++i) {
+                fin.queue(g->sub(i), i == 5 ? -EIO : 0);
+            }
+        });
+        EXPECT_EQ(-EIO, r);
+
+        uint64_t start = timer_wheel::clock_ns();
+        co_scheduler::sleep_for(10000000);
+        EXPECT_LE(10000000u, timer_wheel::clock_ns() - start);
+        done++;
+    });
+
+    // the waiter yields the core: only the other coroutine completes it
+    Context *wakeup = nullptr;
+    std::atomic<bool> waiting{false};
+    sched.spawn_on(1, [&] {
+        int r = co_scheduler::await([&](Context *c) { wakeup = c; waiting = true; });
+        EXPECT_EQ(7, r);
+        done++;
+    });
+    sched.spawn_on(1, [&] {
+        while (!waiting) {
+            co_scheduler::yield();
+        }
+        wakeup->complete(7);
+        done++;
+    });
+    sched.wait_for_empty();
+    EXPECT_EQ(3, done.load());
+}
+
+TEST(Coroutine, file_io) {
+    char path[] = "/tmp/unittest_context_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_LE(0, fd);
+    unlink(path);
+
+    const int writers = 16, blocks = 64, bs = 4096;
+    {
+        co_scheduler sched(2);
+        for (int w = 0; w < writers; ++w) {
+            sched.spawn([=] {
+                std::vector<char> buf(bs), rbuf(bs);
+                for (int b = 0; b < blocks; ++b) {
+                    off_t off = (off_t)(w * blocks + b) * bs;
+                    std::fill(buf.begin(), buf.end(), (char)(w * 31 + b));
+                    EXPECT_EQ(bs, co_scheduler::pwrite(fd, buf.data(), bs, off));
+                    EXPECT_EQ(bs, co_scheduler::pread(fd, rbuf.data(), bs, off));
+                    EXPECT_TRUE(buf == rbuf);
+                }
+                EXPECT_EQ(0, co_scheduler::fsync(fd));
+            });
+        }
+    }
+    // outside a coroutine, it blocks
+    char c;
+    EXPECT_EQ(1, co_scheduler::pread(fd, &c, 1, (off_t)(3 * blocks + 5) * bs));
+    EXPECT_EQ((char)(3 * 31 + 5), c);
+    EXPECT_EQ(0, co_scheduler::pread(fd, &c, 1, (off_t)writers * blocks * bs));
+    ::close(fd);
+}
+
+TEST(Coroutine, Bench) {
+    const int n = 1000000;
+    co_scheduler sched(1);
+
+    // 2 coroutines switch to each other through the core loop
+    uint64_t start = timer_wheel::clock_ns();
+    for (int i = 0; i < 2; ++i) {
+        sched.spawn([] {
+            for (int j = 0; j < n; ++j) {
+                co_scheduler::yield();
+            }
+        });
+    }
+    sched.wait_for_empty();
+    uint64_t yield_ns = timer_wheel::clock_ns() - start;
+
+    start = timer_wheel::clock_ns();
+    sched.spawn([] {
+        for (int j = 0; j < n; ++j) {
+            co_scheduler::await([](Context *c) { c->complete(0); });
+        }
+    });
+    sched.wait_for_empty();
+    uint64_t inline_ns = timer_wheel::clock_ns() - start;
+
+    // woken by another thread
+    const int m = 100000;
+    finisher fin(1);
+    start = timer_wheel::clock_ns();
+    sched.spawn([&] {
+        for (int j = 0; j < m; ++j) {
+            co_scheduler::await([&](Context *c) { fin.queue(c, 0); });
+        }
+    });
+    sched.wait_for_empty();
+    uint64_t remote_ns = timer_wheel::clock_ns() - start;
+
+    // the same handoff between two threads
+    std::mutex lock;
+    std::condition_variable cond;
+    int turn = 0;
+    start = timer_wheel::clock_ns();
+    std::thread t([&] {
+        for (int j = 0; j < m; ++j) {
+            std::unique_lock lk(lock);
+            cond.wait(lk, [&] { return turn == 1; });
+            turn = 0;
+            cond.notify_one();
+        }
+    });
+    for (int j = 0; j < m; ++j) {
+        std::unique_lock lk(lock);
+        turn = 1;
+        cond.notify_one();
+        cond.wait(lk, [&] { return turn == 0; });
+    }
+    t.join();
+    uint64_t thread_ns = timer_wheel::clock_ns() - start;
+
+    std::cout << "coroutine yield: " << yield_ns / (2.0 * n) << "ns"
+              << ", inline await: " << inline_ns / (double)n << "ns"
+              << ", await woken by a thread: " << remote_ns / (double)m << "ns"
+              << ", thread condvar round trip: " << thread_ns / (double)m << "ns"
+              << std::endl;
+}
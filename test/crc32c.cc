@@ -0,0 +1,235 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <string.h>
+
+#include "clock/spec_clock.h"
+#include "crc32/checksum.h"
+#include "crc32/crc32c.h"
+#include "crc32/crc64.h"
+#include "crc32/sctp_crc32.h"
+#include "crc32/xxhash64.h"
+
+#include "gtest/gtest.h"
+
+TEST(Crc32c, multi) {
+    std::vector<unsigned char> data(64 * 1024);
+    for (auto& c : data) {
+        c = rand();
+    }
+
+    for (unsigned n : {0, 1, 3, 4, 5, 8, 13, 64}) {
+        std::vector<const unsigned char*> bufs(n);
+        std::vector<unsigned> lens(n);
+        std::vector<uint32_t> crcs(n);
+        std::vector<uint32_t> expected(n);
+        for (unsigned i = 0; i < n; ++i) {
+            lens[i] = rand() % 5000;
+            // NULL means zero-filled buffer
+            bufs[i] = (rand() % 7) ? &data[rand() % (data.size() - lens[i])] : nullptr;
+            crcs[i] = rand();
+            expected[i] = spec_crc32c(crcs[i], bufs[i], lens[i]);
+        }
+        crc32c_multi(bufs.data(), lens.data(), crcs.data(), n);
+        EXPECT_EQ(expected, crcs);
+    }
+}
+
+// may run before the initializers of crc32c.cc
+static const uint32_t static_init_zeros = spec_crc32c(0x12345678, nullptr, 4096 + 5);
+
+TEST(Crc32c, zeros) {
+    std::vector<unsigned char> buf(4096 + 5);
+    EXPECT_EQ(crc32c_func(0x12345678, buf.data(), buf.size()), static_init_zeros);
+
+    std::vector<unsigned char> zeros(1 << 20);
+    for (int i = 0; i < 1000; ++i) {
+        unsigned len = (i < 100) ? i : rand() % zeros.size();
+        uint32_t crc = rand();
+        uint32_t expected = crc32c_func(crc, zeros.data(), len);
+        EXPECT_EQ(expected, crc32c_zeros(crc, len));
+        EXPECT_EQ(expected, crc32c_zeros_generic(crc, len));
+        EXPECT_EQ(expected, spec_crc32c(crc, nullptr, len));
+    }
+
+    // beyond the buffer: composed from the shorter ones
+    for (unsigned len : {1U << 30, (1U << 31) + 12345, UINT32_MAX}) {
+        uint32_t crc = rand();
+        unsigned half = len / 2;
+        uint32_t expected = crc32c_zeros(crc32c_zeros(crc, half), len - half);
+        EXPECT_EQ(expected, crc32c_zeros(crc, len));
+        EXPECT_EQ(expected, crc32c_zeros_generic(crc, len));
+    }
+}
+
+TEST(Crc32c, BenchZeros) {
+    const int rounds = 1000000;
+    for (uint64_t len = 16; len <= (1ULL << 30); len <<= 2) {
+        uint32_t crc = 1;
+        utime_t start = spec_clock_now();
+        for (int r = 0; r < rounds; ++r) {
+            crc = crc32c_zeros(crc | 1, len);
+        }
+        utime_t fast = spec_clock_now() - start;
+
+        start = spec_clock_now();
+        for (int r = 0; r < rounds; ++r) {
+            crc = crc32c_zeros_generic(crc | 1, len);
+        }
+        utime_t generic = spec_clock_now() - start;
+
+        std::cout << "zeros " << len << " bytes: crc32c_zeros "
+                  << (double)fast * 1e9 / rounds << " ns, generic "
+                  << (double)generic * 1e9 / rounds << " ns" << std::endl;
+    }
+}
+
+TEST(Crc32c, BenchMulti) {
+    const unsigned block_size = 4096;
+    const unsigned num = 1024;
+    const int rounds = 100;
+    std::vector<unsigned char> data(block_size * num);
+    for (auto& c : data) {
+        c = rand();
+    }
+
+    std::vector<const unsigned char*> bufs(num);
+    std::vector<unsigned> lens(num, block_size);
+    std::vector<uint32_t> crcs(num);
+    for (unsigned i = 0; i < num; ++i) {
+        bufs[i] = &data[i * block_size];
+    }
+
+    utime_t start = spec_clock_now();
+    for (int r = 0; r < rounds; ++r) {
+        for (unsigned i = 0; i < num; ++i) {
+            crcs[i] = spec_crc32c(-1, bufs[i], block_size);
+        }
+    }
+    utime_t one_by_one = spec_clock_now() - start;
+    std::vector<uint32_t> expected(crcs);
+
+    start = spec_clock_now();
+    for (int r = 0; r < rounds; ++r) {
+        std::fill(crcs.begin(), crcs.end(), -1);
+        crc32c_multi(bufs.data(), lens.data(), crcs.data(), num);
+    }
+    utime_t multi = spec_clock_now() - start;
+    EXPECT_EQ(expected, crcs);
+
+    double mb = (double)data.size() * rounds / (1024 * 1024);
+    std::cout << "4K blocks: spec_crc32c " << mb / (double)one_by_one
+              << " MB/sec, crc32c_multi " << mb / (double)multi
+              << " MB/sec" << std::endl;
+}
+
+TEST(Crc64, check) {
+    auto p = (const unsigned char*)"123456789";
+    // CRC-64/XZ check value
+    EXPECT_EQ(0x995dc9bbdf1939faULL, ~spec_crc64(~0ULL, p, 9));
+    EXPECT_EQ(0x995dc9bbdf1939faULL, ~crc64_table(~0ULL, p, 9));
+
+    std::vector<unsigned char> data(10000);
+    for (auto& c : data) {
+        c = rand();
+    }
+    for (unsigned len : {0, 1, 15, 16, 63, 64, 65, 127, 128, 200, 4096, 9999}) {
+        uint64_t seed = ((uint64_t)rand() << 32) | rand();
+        uint64_t expected = crc64_table(seed, data.data(), len);
+        EXPECT_EQ(expected, spec_crc64(seed, data.data(), len));
+        // chained
+        uint64_t crc = spec_crc64(seed, data.data(), len / 3);
+        EXPECT_EQ(expected, spec_crc64(crc, data.data() + len / 3, len - len / 3));
+    }
+
+    std::vector<unsigned char> zeros(5000);
+    for (unsigned len : {0, 1, 8, 100, 5000}) {
+        EXPECT_EQ(crc64_table(12345, zeros.data(), len), spec_crc64(12345, nullptr, len));
+    }
+}
+
+TEST(Xxh64, check) {
+    // reference values
+    EXPECT_EQ(0xef46db3751d8e999ULL, spec_xxh64(0, "", 0));
+    EXPECT_EQ(0xd24ec4f1a98c6e5bULL, spec_xxh64(0, "a", 1));
+    EXPECT_EQ(0x44bc2cf5ad770999ULL, spec_xxh64(0, "abc", 3));
+
+    std::vector<unsigned char> data(1000);
+    for (auto& c : data) {
+        c = rand();
+    }
+    for (unsigned len : {0, 5, 31, 32, 33, 100, 1000}) {
+        uint64_t expected = spec_xxh64(7, data.data(), len);
+        spec_xxh64_state st;
+        spec_xxh64_reset(&st, 7);
+        unsigned off = 0;
+        while (off < len) {
+            unsigned n = std::min<unsigned>(rand() % 40, len - off);
+            spec_xxh64_update(&st, data.data() + off, n);
+            off += n;
+        }
+        EXPECT_EQ(expected, spec_xxh64_digest(&st));
+    }
+}
+
+TEST(Checksum, kernel) {
+    for (int type = 0; type < SPEC_CSUM_MAX; ++type) {
+        auto k = spec_csum_get_kernel(type);
+        ASSERT_TRUE(k);
+        EXPECT_EQ(type, spec_csum_from_name(k->name));
+    }
+    EXPECT_EQ(nullptr, spec_csum_get_kernel(SPEC_CSUM_MAX));
+    EXPECT_EQ(-1, spec_csum_from_name("md5"));
+
+    auto p = (const unsigned char*)"123456789";
+    EXPECT_EQ(0u, spec_checksum(SPEC_CSUM_NONE, 1, p, 9));
+    EXPECT_EQ(spec_crc32c(1, p, 9), spec_checksum(SPEC_CSUM_CRC32C, 1, p, 9));
+    EXPECT_EQ(spec_crc64(1, p, 9), spec_checksum(SPEC_CSUM_CRC64, 1, p, 9));
+    EXPECT_EQ(spec_xxh64(1, p, 9), spec_checksum(SPEC_CSUM_XXH64, 1, p, 9));
+
+    // crc cached for one seed is adjusted to another one
+    std::vector<unsigned char> zeros(4096);
+    for (int type : {SPEC_CSUM_CRC32C, SPEC_CSUM_CRC64}) {
+        auto k = spec_csum_get_kernel(type);
+        ASSERT_TRUE(k->zeros);
+        uint64_t v = k->calc(5, p, 9);
+        EXPECT_EQ(k->calc(9, p, 9), v ^ k->zeros(5 ^ 9, 9));
+        EXPECT_EQ(k->calc(5, zeros.data(), zeros.size()), k->zeros(5, zeros.size()));
+    }
+    auto x = spec_csum_get_kernel(SPEC_CSUM_XXH64);
+    EXPECT_EQ(x->calc(3, zeros.data(), zeros.size()), x->calc(3, nullptr, zeros.size()));
+}
+
+TEST(Checksum, Bench) {
+    const unsigned block_size = 64 * 1024;
+    const int rounds = 2000;
+    std::vector<unsigned char> data(block_size);
+    for (auto& c : data) {
+        c = rand();
+    }
+
+    double mb = (double)block_size * rounds / (1024 * 1024);
+    auto bench = [&](const char *name, auto&& fn) {
+        uint64_t sum = 0;
+        utime_t start = spec_clock_now();
+        for (int r = 0; r < rounds; ++r) {
+            sum += fn();
+        }
+        utime_t elapsed = spec_clock_now() - start;
+        std::cout << "64K blocks: " << name << " " << mb / (double)elapsed
+                  << " MB/sec (" << std::hex << sum << std::dec << ")" << std::endl;
+    };
+
+    for (int type = 1; type < SPEC_CSUM_MAX; ++type) {
+        auto k = spec_csum_get_kernel(type);
+        bench(k->name, [&] { return k->calc(-1, data.data(), block_size); });
+    }
+    bench("crc64 table", [&] { return crc64_table(-1, data.data(), block_size); });
+}
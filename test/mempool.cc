@@ -0,0 +1,399 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "mempool/mempool.h"
+#include "mempool/arena.h"
+#include "buffer/buffer_create.h"
+#include "buffer/buffer_ptr.h"
+#include "buffer/buffer_raw.h"
+#include "buffer/buffer_list.h"
+#include "clock/spec_clock.h"
+
+#include "gtest/gtest.h"
+
+TEST(MempoolProfiler, sample_container) {
+    mempool::profiler::start(1);
+    {
+        mempool::unittest_1::vector<uint64_t> v;
+        v.reserve(1024);
+        EXPECT_EQ(1u, mempool::profiler::get_live_samples());
+        EXPECT_LE(1024 * sizeof(uint64_t),
+                  mempool::profiler::get_live_estimated_bytes());
+
+        std::ostringstream folded;
+        mempool::profiler::dump_folded(folded);
+        EXPECT_FALSE(folded.str().empty());
+
+        std::ostringstream pprof;
+        mempool::profiler::dump_pprof(pprof);
+        EXPECT_EQ(0u, pprof.str().find("heap profile: 1: 8192 [1: 8192] @ heap_v2/1\n"));
+        EXPECT_NE(std::string::npos, pprof.str().find("MAPPED_LIBRARIES:"));
+    }
+    EXPECT_EQ(0u, mempool::profiler::get_live_samples());
+    mempool::profiler::stop();
+}
+
+TEST(MempoolProfiler, sample_buffer_raw) {
+    mempool::profiler::start(1);
+    {
+        spec::buffer::ptr bp(spec::buffer::create(4096));
+        EXPECT_LE(1u, mempool::profiler::get_live_samples());
+    }
+    EXPECT_EQ(0u, mempool::profiler::get_live_samples());
+
+    // samples are dropped when the profiler is stopped
+    spec::buffer::ptr bp(spec::buffer::create(4096));
+    EXPECT_LE(1u, mempool::profiler::get_live_samples());
+    mempool::profiler::stop();
+    EXPECT_EQ(0u, mempool::profiler::get_live_samples());
+}
+
+TEST(MempoolProfiler, sample_rate) {
+    const size_t period = 64 * 1024;
+    const size_t item = 256;
+    const size_t num = 40000;
+
+    mempool::profiler::start(period);
+    mempool::unittest_1::list<std::array<char, item>> l;
+    for (size_t i = 0; i < num; ++i) {
+        l.emplace_back();
+    }
+    size_t samples = mempool::profiler::get_live_samples();
+    size_t estimated = mempool::profiler::get_live_estimated_bytes();
+    size_t allocated = mempool::unittest_1::allocated_bytes();
+    std::cout << "allocated " << allocated << " bytes, "
+              << samples << " samples, "
+              << "estimated " << estimated << " bytes" << std::endl;
+    EXPECT_LT(0u, samples);
+    EXPECT_LT(samples, num);
+    // the estimation should be in the right magnitude
+    EXPECT_LT(allocated / 2, estimated);
+    EXPECT_LT(estimated, allocated * 2);
+    mempool::profiler::stop();
+}
+
+TEST(MempoolArena, scope) {
+    size_t pages = mempool::get_arena_pages_in_use();
+    {
+        mempool::arena_scope scope;
+        ASSERT_NE(nullptr, scope.get());
+        EXPECT_EQ(scope.get(), mempool::arena::current());
+
+        spec::buffer::list bl;
+        bl.append("abcdefg", 7);
+        EXPECT_TRUE(mempool::arena::contains(&bl.front()));
+        EXPECT_TRUE(mempool::arena::contains(bl.front().raw_c_str()));
+
+        mempool::unittest_1::vector<uint64_t> v(128);
+        EXPECT_TRUE(mempool::arena::contains(v.data()));
+        EXPECT_EQ(128 * sizeof(uint64_t), mempool::unittest_1::allocated_bytes());
+
+        // too large to be taken from the arena
+        mempool::unittest_1::vector<char> big(mempool::arena_page_size);
+        EXPECT_FALSE(mempool::arena::contains(big.data()));
+
+        {
+            mempool::arena_bypass bypass;
+            spec::buffer::list heap;
+            heap.append("abcdefg", 7);
+            EXPECT_FALSE(mempool::arena::contains(&heap.front()));
+        }
+    }
+    EXPECT_EQ(nullptr, mempool::arena::current());
+    EXPECT_EQ(pages, mempool::get_arena_pages_in_use());
+    EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+}
+
+TEST(MempoolArena, escape) {
+    size_t pages = mempool::get_arena_pages_in_use();
+    uint64_t escaped = mempool::get_arena_escaped_scopes();
+
+    spec::buffer::list cache;
+    {
+        mempool::arena_scope scope;
+        spec::buffer::list bl;
+        for (int i = 0; i < 1000; ++i) {
+            bl.append("0123456789", 10);
+            bl.append(spec::buffer::create(100));
+        }
+        cache.claim_append(bl);
+    }
+    // the escaped buffers pin the arena pages
+    EXPECT_EQ(escaped + 1, mempool::get_arena_escaped_scopes());
+    EXPECT_LT(pages, mempool::get_arena_pages_in_use());
+    EXPECT_EQ(110000u, cache.length());
+
+    spec::buffer::list copy(cache);
+    EXPECT_TRUE(cache.unshare_arena());
+    EXPECT_FALSE(cache.unshare_arena());
+    EXPECT_TRUE(copy.contents_equal(cache));
+    copy.clear();
+    EXPECT_EQ(pages, mempool::get_arena_pages_in_use());
+}
+
+TEST(MempoolArena, BenchAlloc) {
+    const int rounds = 100000;
+    auto op = [] {
+        spec::buffer::list bl;
+        for (int i = 0; i < 8; ++i) {
+            bl.append(spec::buffer::create(128));
+        }
+        spec::buffer::list other;
+        other.claim_append(bl);
+    };
+
+    utime_t start = spec_clock_now();
+    for (int i = 0; i < rounds; ++i) {
+        op();
+    }
+    utime_t heap = spec_clock_now() - start;
+
+    start = spec_clock_now();
+    for (int i = 0; i < rounds; ++i) {
+        mempool::arena_scope scope;
+        op();
+    }
+    utime_t in_arena = spec_clock_now() - start;
+
+    std::cout << rounds << " ops: heap " << heap << ", arena " << in_arena
+              << std::endl;
+}
+
+TEST(MempoolContainer, flat_hash_map) {
+    {
+        mempool::unittest_1::flat_hash_map<uint64_t, uint64_t> m;
+        std::map<uint64_t, uint64_t> ref;
+        uint64_t rnd = 88172645463325252ULL;
+        for (int i = 0; i < 200000; ++i) {
+            rnd ^= rnd << 13;
+            rnd ^= rnd >> 7;
+            rnd ^= rnd << 17;
+            uint64_t key = rnd % 4096;
+            switch (rnd >> 62) {
+            case 0:
+            case 1:
+                m[key] = i;
+                ref[key] = i;
+                break;
+            case 2:
+                EXPECT_EQ(ref.erase(key), m.erase(key));
+                break;
+            default:
+                EXPECT_EQ(ref.count(key), m.count(key));
+                if (ref.count(key)) {
+                    EXPECT_EQ(ref[key], m.at(key));
+                }
+                break;
+            }
+            ASSERT_EQ(ref.size(), m.size());
+        }
+
+        size_t n = 0;
+        for (const auto& [key, value] : m) {
+            EXPECT_EQ(ref[key], value);
+            ++n;
+        }
+        EXPECT_EQ(ref.size(), n);
+
+        auto copy = m;
+        EXPECT_EQ(m.size(), copy.size());
+        EXPECT_LT(0u, mempool::unittest_1::allocated_bytes());
+
+        m.clear();
+        EXPECT_TRUE(m.empty());
+        EXPECT_EQ(m.end(), m.find(ref.begin()->first));
+    }
+    EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+}
+
+TEST(MempoolContainer, flat_map) {
+    {
+        mempool::unittest_1::flat_map<uint64_t, uint64_t> m;
+        for (uint64_t i = 100; i > 0; --i) {
+            m[i * 4096] = i;
+        }
+        EXPECT_EQ(100u, m.size());
+        EXPECT_EQ(4096u, m.begin()->first);
+        EXPECT_EQ(4096u, m.lower_bound(1)->first);
+        EXPECT_EQ(50u, m.at(50 * 4096));
+        EXPECT_LE(100 * sizeof(std::pair<uint64_t, uint64_t>),
+                  mempool::unittest_1::allocated_bytes());
+    }
+    EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+}
+
+/* Cache index: LBA(4KiB aligned offset in 4TiB space) -> cache offset.
+ * Compare std::unordered_map with flat_hash_map & flat_map.
+ */
+template <typename Map>
+static void bench_lba_index(const char *name, Map& m,
+                            const std::vector<uint64_t>& lbas) {
+    utime_t start = spec_clock_now();
+    for (size_t i = 0; i < lbas.size(); ++i) {
+        m[lbas[i]] = i;
+    }
+    utime_t insert = spec_clock_now() - start;
+    size_t bytes = mempool::unittest_1::allocated_bytes();
+
+    start = spec_clock_now();
+    uint64_t sum = 0;
+    for (auto lba : lbas) {
+        sum += m.find(lba)->second;
+    }
+    for (auto lba : lbas) {
+        // miss
+        sum += m.count(lba + 1);
+    }
+    utime_t lookup = spec_clock_now() - start;
+
+    start = spec_clock_now();
+    for (size_t i = 0; i < lbas.size(); i += 2) {
+        m.erase(lbas[i]);
+    }
+    utime_t erase = spec_clock_now() - start;
+
+    std::cout << name << ": insert " << insert << ", lookup(hit + miss) "
+              << lookup << ", erase half " << erase << ", "
+              << bytes / lbas.size() << " bytes/entry"
+              << " (" << sum << ")" << std::endl;
+}
+
+TEST(MempoolContainer, BenchLBAIndex) {
+    const size_t num = 10 * 1000 * 1000;
+    std::vector<uint64_t> lbas(num);
+    uint64_t rnd = 88172645463325252ULL;
+    for (auto& lba : lbas) {
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 7;
+        rnd ^= rnd << 17;
+        lba = (rnd & ((1ULL << 42) - 1)) & ~4095ULL;
+    }
+    std::sort(lbas.begin(), lbas.end());
+    lbas.erase(std::unique(lbas.begin(), lbas.end()), lbas.end());
+    std::shuffle(lbas.begin(), lbas.end(), std::mt19937_64(rnd));
+
+    {
+        mempool::unittest_1::unordered_map<uint64_t, uint64_t> m;
+        bench_lba_index("std::unordered_map", m, lbas);
+    }
+    {
+        mempool::unittest_1::flat_hash_map<uint64_t, uint64_t> m;
+        bench_lba_index("flat_hash_map", m, lbas);
+    }
+    {
+        // random insertion into flat_map is O(n^2), build it from sorted keys
+        std::vector<uint64_t> sorted(lbas);
+        std::sort(sorted.begin(), sorted.end());
+        mempool::unittest_1::flat_map<uint64_t, uint64_t> m;
+        m.reserve(sorted.size());
+        utime_t start = spec_clock_now();
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            m.emplace_hint(m.end(), sorted[i], i);
+        }
+        utime_t insert = spec_clock_now() - start;
+
+        start = spec_clock_now();
+        uint64_t sum = 0;
+        for (auto lba : lbas) {
+            sum += m.find(lba)->second;
+        }
+        utime_t lookup = spec_clock_now() - start;
+        std::cout << "flat_map: sorted insert " << insert << ", lookup(hit) "
+                  << lookup << ", "
+                  << mempool::unittest_1::allocated_bytes() / lbas.size()
+                  << " bytes/entry (" << sum << ")" << std::endl;
+    }
+}
+
+TEST(MempoolThreadDelta, flush_on_exit) {
+    mempool::unittest_1::vector<char> *v = nullptr;
+    std::thread t([&] {
+        v = new mempool::unittest_1::vector<char>(1000);
+        // the calling thread always sees its own delta
+        EXPECT_EQ(1000u, mempool::unittest_1::allocated_bytes());
+    });
+    t.join();
+    EXPECT_EQ(1000u, mempool::unittest_1::allocated_bytes());
+    EXPECT_EQ(1000u, mempool::unittest_1::allocated_items());
+
+    std::thread t2([&] {
+        delete v;
+        mempool::flush_thread_pool_delta();
+        EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+    });
+    t2.join();
+    EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+}
+
+TEST(MempoolThreadDelta, bound) {
+    std::atomic<bool> done{false};
+    std::atomic<bool> ready{false};
+    size_t actual = 0;
+    std::thread t([&] {
+        mempool::unittest_1::list<uint64_t> l;
+        for (int i = 0; i < 100000; ++i) {
+            l.push_back(i);
+        }
+        // with the delta of this thread
+        actual = mempool::unittest_1::allocated_bytes();
+        ready = true;
+        while (!done) {
+            std::this_thread::yield();
+        }
+    });
+    while (!ready) {
+        std::this_thread::yield();
+    }
+    EXPECT_LE(100000 * sizeof(uint64_t), actual);
+    size_t seen = mempool::unittest_1::allocated_bytes();
+    EXPECT_LE(seen, actual);
+    EXPECT_LE(actual - seen, (size_t)mempool::thread_delta_max_bytes);
+    done = true;
+    t.join();
+    EXPECT_EQ(0u, mempool::unittest_1::allocated_bytes());
+}
+
+TEST(MempoolThreadDelta, BenchAllocFree) {
+    const int rounds = 10 * 1000 * 1000;
+    for (int nthreads : {1, 4}) {
+        std::vector<std::thread> threads;
+        std::atomic<uint64_t> pool_ns{0}, heap_ns{0};
+        for (int t = 0; t < nthreads; ++t) {
+            threads.emplace_back([&] {
+                mempool::unittest_1::pool_allocator<uint64_t> alloc;
+                utime_t start = spec_clock_now();
+                for (int i = 0; i < rounds; ++i) {
+                    uint64_t *p = alloc.allocate(1);
+                    *(volatile uint64_t*)p = i;
+                    alloc.deallocate(p, 1);
+                }
+                pool_ns += (spec_clock_now() - start).to_nsec();
+
+                start = spec_clock_now();
+                for (int i = 0; i < rounds; ++i) {
+                    uint64_t *p = new uint64_t;
+                    *(volatile uint64_t*)p = i;
+                    delete p;
+                }
+                heap_ns += (spec_clock_now() - start).to_nsec();
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        std::cout << nthreads << " threads, allocate/free pairs per second"
+                  << " per thread: pool_allocator "
+                  << (uint64_t)(rounds * 1e9 * nthreads / pool_ns)
+                  << ", new/delete "
+                  << (uint64_t)(rounds * 1e9 * nthreads / heap_ns)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,373 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "spinlock/rwlock.h"
+#include "spinlock/seqlock.h"
+#include "spinlock/spinlock.h"
+
+#include "gtest/gtest.h"
+
+using namespace spec;
+
+// n threads add to a plain counter under the lock
+template <typename Lock>
+static uint64_t hammer(Lock& lock, unsigned n, uint64_t loops) {
+    uint64_t counter = 0;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back([&] {
+            for (uint64_t j = 0; j < loops; ++j) {
+                std::lock_guard lk(lock);
+                ++counter;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return counter;
+}
+
+// half the threads lock(), the others spin on try_lock()
+template <typename Lock>
+static uint64_t hammer_try(Lock& lock, unsigned n, uint64_t loops) {
+    uint64_t counter = 0;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            for (uint64_t j = 0; j < loops; ++j) {
+                if (i % 2) {
+                    lock.lock();
+                } else {
+                    while (!lock.try_lock()) {
+                        std::this_thread::yield();
+                    }
+                }
+                ++counter;
+                lock.unlock();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return counter;
+}
+
+TEST(Spinlock, spinlock) {
+    spinlock lock;
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock();
+    spin_lock(&lock);
+    EXPECT_FALSE(lock.try_lock());
+    spin_unlock(&lock);
+
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+    spin_lock(flag);
+    EXPECT_TRUE(flag.test_and_set());
+    spin_unlock(flag);
+
+    EXPECT_EQ(4 * 20000u, hammer(lock, 4, 20000));
+    basic_spinlock<16> yielding;
+    EXPECT_EQ(4 * 20000u, hammer(yielding, 4, 20000));
+    EXPECT_EQ(4 * 20000u, hammer_try(yielding, 4, 20000));
+}
+
+TEST(Spinlock, ticket) {
+    ticket_spinlock<> lock;
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+
+    // a FIFO lock without yield convoys once a waiter is preempted
+    EXPECT_EQ(4 * 2000u, hammer(lock, 4, 2000));
+    ticket_spinlock<16> yielding;
+    EXPECT_EQ(4 * 20000u, hammer(yielding, 4, 20000));
+    EXPECT_EQ(4 * 20000u, hammer_try(yielding, 4, 20000));
+}
+
+TEST(Spinlock, mcs) {
+    mcs_spinlock<> lock, other;
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock());
+    // nested, each one takes its own node
+    other.lock();
+    other.unlock();
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+
+    EXPECT_EQ(4 * 2000u, hammer(lock, 4, 2000));
+    mcs_spinlock<16> yielding;
+    EXPECT_EQ(4 * 20000u, hammer(yielding, 4, 20000));
+    EXPECT_EQ(4 * 20000u, hammer_try(yielding, 4, 20000));
+}
+
+#ifdef SPINLOCK_STATS
+TEST(Spinlock, stats) {
+    ticket_spinlock<16> lock;
+    hammer(lock, 4, 20000);
+    const spinlock_stats& s = lock.stats();
+    EXPECT_EQ(4 * 20000u, s.acquires);
+    EXPECT_LE(s.contended, s.acquires);
+    EXPECT_LE(s.contended, s.spins);
+}
+#endif
+
+TEST(Spinlock, Bench) {
+    using clock = std::chrono::steady_clock;
+    // a short critical section, then some work outside of the lock
+    auto bench = [](const char *name, auto& lock, unsigned n) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> ops{0};
+        uint64_t shared[8] = {0};
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < n; ++i) {
+            threads.emplace_back([&] {
+                uint64_t done = 0;
+                volatile uint64_t local = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    {
+                        std::lock_guard lk(lock);
+                        for (auto& s : shared) {
+                            ++s;
+                        }
+                    }
+                    for (int j = 0; j < 32; ++j) {
+                        local = local + j;
+                    }
+                    ++done;
+                }
+                ops += done;
+            });
+        }
+        auto start = clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stop = true;
+        for (auto& t : threads) {
+            t.join();
+        }
+        double secs = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << name << " " << n << " threads: " << ops / secs << " ops/sec"
+                  << std::endl;
+        EXPECT_EQ(ops.load(), shared[0]);
+    };
+
+    for (unsigned n : {2, 4, 8, 16, 32, 64}) {
+        spinlock tas;
+        basic_spinlock<16> tas_yield;
+        ticket_spinlock<> ticket;
+        ticket_spinlock<16> ticket_yield;
+        mcs_spinlock<> mcs;
+        mcs_spinlock<16> mcs_yield;
+        std::mutex mutex;
+        bench("spinlock", tas, n);
+        bench("spinlock yield", tas_yield, n);
+        bench("ticket", ticket, n);
+        bench("ticket yield", ticket_yield, n);
+        bench("mcs", mcs, n);
+        bench("mcs yield", mcs_yield, n);
+        bench("std::mutex", mutex, n);
+#ifdef SPINLOCK_STATS
+        std::cout << "spinlock contended " << tas.stats().contended << "/"
+                  << tas.stats().acquires << ", max wait "
+                  << tas.stats().max_wait_ns << "ns" << std::endl;
+#endif
+    }
+}
+
+struct triple {
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint32_t c = 0;
+};
+
+TEST(Seqlock, basic) {
+    seqlock<triple> sl;
+    EXPECT_EQ(0u, sl.load().a);
+
+    triple t;
+    t.a = 1;
+    t.b = 2;
+    t.c = 3;
+    sl.store(t);
+    triple r = sl.load();
+    EXPECT_EQ(1u, r.a);
+    EXPECT_EQ(2u, r.b);
+    EXPECT_EQ(3u, r.c);
+
+    sl.update([](triple& v) { v.a += 10; });
+    {
+        seqlock<triple>::write_guard w(sl);
+        EXPECT_EQ(11u, w->a);
+        w->c = 7;
+    }
+    r = sl.load();
+    EXPECT_EQ(11u, r.a);
+    EXPECT_EQ(2u, r.b);
+    EXPECT_EQ(7u, r.c);
+}
+
+TEST(Seqlock, stress) {
+    // the readers must never see a half written value
+    triple init;
+    init.c = ~0u;
+    seqlock<triple> sl(init);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> torn{0}, reads{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            uint64_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                triple t = sl.load();
+                if (t.b != t.a * 3 || t.c != (uint32_t)~t.a) {
+                    torn++;
+                }
+                ++n;
+            }
+            reads += n;
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 2; ++i) {
+        writers.emplace_back([&] {
+            for (uint64_t j = 0; j < 20000; ++j) {
+                sl.update([](triple& t) {
+                    t.a++;
+                    t.b = t.a * 3;
+                    t.c = ~t.a;
+                });
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    stop = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(0u, torn.load());
+    EXPECT_EQ(40000u, sl.load().a);
+    EXPECT_LT(0u, reads.load());
+}
+
+TEST(RWSpinlock, basic) {
+    rw_spinlock lock;
+    {
+        rw_spinlock::read_guard r1(lock);
+        rw_spinlock::read_guard r2(lock);
+        EXPECT_FALSE(lock.try_lock());
+    }
+    {
+        rw_spinlock::write_guard w(lock);
+        EXPECT_FALSE(lock.try_lock_shared());
+        EXPECT_FALSE(lock.try_lock());
+    }
+    EXPECT_TRUE(lock.try_lock_shared());
+    lock.unlock_shared();
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TEST(RWSpinlock, stress) {
+    // the writers keep a == b, the readers check it
+    rw_spinlock lock;
+    uint64_t a = 0, b = 0;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> torn{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                rw_spinlock::read_guard r(lock);
+                if (a != b) {
+                    torn++;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 2; ++i) {
+        writers.emplace_back([&] {
+            for (int j = 0; j < 10000; ++j) {
+                rw_spinlock::write_guard w(lock);
+                a++;
+                b++;
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    stop = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(0u, torn.load());
+    EXPECT_EQ(20000u, a);
+}
+
+TEST(RWSpinlock, Bench) {
+    using clock = std::chrono::steady_clock;
+    // read-only, what the readers of a cache see
+    auto bench = [](const char *name, auto&& read, unsigned n) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> ops{0};
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < n; ++i) {
+            threads.emplace_back([&] {
+                uint64_t done = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    read();
+                    ++done;
+                }
+                ops += done;
+            });
+        }
+        auto start = clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stop = true;
+        for (auto& t : threads) {
+            t.join();
+        }
+        double secs = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << name << " " << n << " readers: " << ops / secs << " ops/sec"
+                  << std::endl;
+    };
+
+    triple value;
+    seqlock<triple> sl;
+    rw_spinlock rw;
+    std::shared_mutex shared;
+    spinlock excl;
+    for (unsigned n : {1, 2, 4, 8}) {
+        bench("seqlock", [&] { return sl.load().a; }, n);
+        bench("rw_spinlock", [&] {
+            rw_spinlock::read_guard r(rw);
+            return value.a;
+        }, n);
+        bench("std::shared_mutex", [&] {
+            std::shared_lock r(shared);
+            return value.a;
+        }, n);
+        bench("spinlock", [&] {
+            std::lock_guard r(excl);
+            return value.a;
+        }, n);
+    }
+}
@@ -0,0 +1,255 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#define LATENCY_STATS
+#include "clock/latency.h"
+#include "mempool/mempool.h"
+#include "stats/admin_socket.h"
+#include "stats/histogram.h"
+#include "stats/stats_registry.h"
+
+#include "gtest/gtest.h"
+
+using namespace spec::stats;
+
+static uint64_t find_stat(const stat_list_t& stats, const std::string& name) {
+    auto p = std::find_if(stats.begin(), stats.end(),
+                          [&](const auto& s) { return s.first == name; });
+    return p == stats.end() ? UINT64_MAX : p->second;
+}
+
+TEST(StatsRegistry, snapshot) {
+    mempool::unittest_1::vector<char> v(1000);
+    auto& r = registry::instance();
+
+    stat_list_t stats = r.snapshot();
+    EXPECT_EQ(1000u, find_stat(stats, "mempool.unittest_1.bytes"));
+    EXPECT_EQ(1000u, find_stat(stats, "mempool.unittest_1.items"));
+    EXPECT_NE(UINT64_MAX, find_stat(stats, "buffer.crc.missed"));
+    EXPECT_EQ(UINT64_MAX, find_stat(stats, "test.gauge"));
+
+    uint64_t id = r.add_gauge("test.gauge", [] { return 42; });
+    stats = r.snapshot();
+    EXPECT_EQ(42u, find_stat(stats, "test.gauge"));
+
+    std::ostringstream json;
+    r.dump_json(json);
+    EXPECT_NE(std::string::npos, json.str().find("\"test.gauge\": 42"));
+    EXPECT_NE(std::string::npos, json.str().find("\"mempool.unittest_1.bytes\": 1000"));
+
+    r.remove_gauge(id);
+    stats = r.snapshot();
+    EXPECT_EQ(UINT64_MAX, find_stat(stats, "test.gauge"));
+}
+
+TEST(StatsRegistry, binary) {
+    stat_list_t stats = {{"a", 1}, {"b.c", UINT64_MAX}, {"", 0}};
+    std::string bin;
+    encode_binary(stats, 123456789, bin);
+    EXPECT_EQ(0, bin.compare(0, 8, "SPECSTAT"));
+
+    stat_list_t decoded;
+    uint64_t ts = 0;
+    ASSERT_TRUE(decode_binary(bin, decoded, &ts));
+    EXPECT_EQ(stats, decoded);
+    EXPECT_EQ(123456789u, ts);
+
+    bin.pop_back();
+    EXPECT_FALSE(decode_binary(bin, decoded));
+    EXPECT_FALSE(decode_binary("SPECSTA", decoded));
+}
+
+static std::string query(const std::string& path, const std::string& cmd) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    EXPECT_EQ(0, ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)));
+    EXPECT_EQ((ssize_t)cmd.size(), ::write(fd, cmd.data(), cmd.size()));
+
+    std::string reply;
+    char buf[4096];
+    ssize_t r;
+    while ((r = ::read(fd, buf, sizeof(buf))) > 0) {
+        reply.append(buf, r);
+    }
+    ::close(fd);
+    return reply;
+}
+
+TEST(AdminSocket, query) {
+    std::string path = "/tmp/unittest_stats." + std::to_string(getpid()) + ".asok";
+    admin_socket asok;
+    ASSERT_EQ(0, asok.start(path));
+    EXPECT_EQ(-EBUSY, asok.start(path));
+
+    std::string json = query(path, "stats json\n");
+    EXPECT_EQ(0u, json.find("{\"version\": 1"));
+
+    std::string bin = query(path, "stats binary\n");
+    stat_list_t stats;
+    ASSERT_TRUE(decode_binary(bin, stats));
+    EXPECT_NE(UINT64_MAX, find_stat(stats, "mempool.buffer_anon.bytes"));
+
+    EXPECT_EQ(0u, query(path, "foo\n").find("unknown command"));
+
+    asok.stop();
+    EXPECT_NE(0, ::access(path.c_str(), F_OK));
+}
+
+TEST(AdminSocket, silent_client) {
+    std::string path = "/tmp/unittest_stats." + std::to_string(getpid()) + ".asok";
+    admin_socket asok;
+    ASSERT_EQ(0, asok.start(path));
+
+    // connected but sends nothing, stop() doesn't wait for it
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(0, ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    asok.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ::close(fd);
+}
+
+TEST(Histogram, buckets) {
+    using snap = histogram_snapshot;
+    EXPECT_EQ(0u, snap::bucket_of(0));
+    EXPECT_EQ(31u, snap::bucket_of(31));
+    EXPECT_EQ(32u, snap::bucket_of(32));
+    EXPECT_EQ(snap::num_buckets - 1, snap::bucket_of(UINT64_MAX));
+    for (unsigned b = 0; b + 1 < snap::num_buckets; ++b) {
+        ASSERT_EQ(b, snap::bucket_of(snap::bucket_low(b)));
+        ASSERT_EQ(b, snap::bucket_of(snap::bucket_high(b)));
+        ASSERT_EQ(snap::bucket_high(b) + 1, snap::bucket_low(b + 1));
+    }
+
+    // the relative error is at most 1/32
+    std::mt19937_64 rng(42);
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t v = rng() >> (rng() % 64);
+        unsigned b = snap::bucket_of(v);
+        ASSERT_LE(snap::bucket_low(b), v);
+        ASSERT_GE(snap::bucket_high(b), v);
+        ASSERT_LE(snap::bucket_high(b) - snap::bucket_low(b), v / 32);
+    }
+}
+
+TEST(Histogram, percentile) {
+    histogram h;
+    EXPECT_EQ(0u, h.snapshot().percentile(99));
+    for (uint64_t v = 1; v <= 10000; ++v) {
+        h.record(v);
+    }
+    auto s = h.snapshot();
+    EXPECT_EQ(10000u, s.count);
+    EXPECT_EQ(1u, s.min);
+    EXPECT_EQ(10000u, s.max);
+    EXPECT_DOUBLE_EQ(5000.5, s.mean());
+    EXPECT_NEAR(5000, s.percentile(50), 5000 / 32);
+    EXPECT_NEAR(9900, s.percentile(99), 9900 / 32);
+    EXPECT_NEAR(9990, s.percentile(99.9), 9990 / 32);
+    EXPECT_EQ(10000u, s.percentile(100));
+    EXPECT_EQ(1u, s.percentile(0));
+
+    histogram_snapshot other;
+    other.add(1000000, 100);
+    s.merge(other);
+    EXPECT_EQ(10100u, s.count);
+    EXPECT_EQ(1000000u, s.max);
+    EXPECT_NEAR(1000000, s.percentile(99.5), 1000000 / 32);
+
+    h.reset();
+    EXPECT_EQ(0u, h.snapshot().count);
+}
+
+TEST(Histogram, threads) {
+    histogram h("test.lat");
+    std::atomic<bool> stop{false};
+    // snapshot while the others record
+    std::thread reader([&] {
+        uint64_t last = 0;
+        while (!stop.load()) {
+            uint64_t n = h.snapshot().count;
+            EXPECT_LE(last, n);
+            last = n;
+        }
+    });
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 4; ++i) {
+            writers.emplace_back([&h, i] {
+                for (int j = 0; j < 100000; ++j) {
+                    h.record(i * 1000 + j % 100);
+                }
+            });
+        }
+        for (auto& t : writers) {
+            t.join();
+        }
+    }
+    stop = true;
+    reader.join();
+
+    auto s = h.snapshot();
+    EXPECT_EQ(800000u, s.count);
+    EXPECT_EQ(0u, s.min);
+    EXPECT_EQ(3099u, s.max);
+
+    stat_list_t stats = registry::instance().snapshot();
+    EXPECT_EQ(800000u, find_stat(stats, "test.lat.count"));
+    EXPECT_EQ(s.percentile(99), find_stat(stats, "test.lat.p99"));
+    EXPECT_EQ(3099u, find_stat(stats, "test.lat.max"));
+}
+
+TEST(Histogram, timer) {
+    histogram h;
+    for (int i = 0; i < 10; ++i) {
+        SPEC_LATENCY_TIMER(h);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto s = h.snapshot();
+    EXPECT_EQ(10u, s.count);
+    EXPECT_LE(1000000u, s.min);
+    EXPECT_GT(1000000000u, s.max);
+}
+
+TEST(Histogram, Bench) {
+    const int n = 10000000;
+    histogram h;
+    std::atomic<uint64_t> counter{0};
+    auto bench = [](const char *name, auto&& fn) {
+        nstime_t start = spec_mono_now();
+        for (int i = 0; i < n; ++i) {
+            fn(i);
+        }
+        nstime_t elapsed = spec_mono_now() - start;
+        std::cout << name << ": " << elapsed.to_nsec() / (double)n << "ns/op"
+                  << std::endl;
+    };
+    bench("histogram::record", [&](int i) { h.record(i & 0xffff); });
+    bench("atomic fetch_add", [&](int i) {
+        counter.fetch_add(i, std::memory_order_relaxed);
+    });
+    bench("latency_timer", [&](int) { SPEC_LATENCY_TIMER(h); });
+    EXPECT_EQ(2u * n, h.snapshot().count);
+}
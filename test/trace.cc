@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "buffer/buffer_list.h"
+#include "clock/spec_clock.h"
+#include "trace/trace.h"
+
+#include "gtest/gtest.h"
+
+using namespace spec;
+using spec::trace::tracer;
+
+static std::string trace_path() {
+    return "/tmp/unittest_trace." + std::to_string(getpid()) + ".trace";
+}
+
+static trace::trace_file read_trace(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream data;
+    data << in.rdbuf();
+    trace::trace_file t;
+    EXPECT_TRUE(trace::decode(data.str(), t));
+    return t;
+}
+
+static size_t count_events(const trace::trace_file& t, const std::string& name) {
+    return std::count_if(t.events.begin(), t.events.end(), [&](const auto& e) {
+        return e.id < t.defs.size() && t.defs[e.id].name == name;
+    });
+}
+
+enum class color : int8_t { red = -1, green = 1 };
+
+TEST(Trace, disabled) {
+    ASSERT_FALSE(tracer::on());
+    int evaluated = 0;
+    auto arg = [&] { return ++evaluated; };
+    SPEC_TRACE("test.disabled", "{}", arg());
+    SPEC_TRACE("test.no_args", "");
+    EXPECT_EQ(0, evaluated);
+}
+
+TEST(Trace, record) {
+    std::string path = trace_path();
+    auto& t = tracer::instance();
+    ASSERT_EQ(0, t.start(path));
+    EXPECT_EQ(-EBUSY, t.start(path));
+    EXPECT_TRUE(tracer::on());
+
+    nstime_t start = spec_mono_now();
+    int x = 0;
+    SPEC_TRACE("test.types", "u {} i {} b {} f {} p {} e {}",
+               42u, -7, true, 0.5, &x, color::red);
+    SPEC_TRACE("test.no_args", "");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i] {
+            for (int j = 0; j < 1000; ++j) {
+                SPEC_TRACE("test.loop", "thread {} iter {}", i, j);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    buffer::list bl;
+    bl.append(std::string(100, 'a'));
+    bl.append(std::string(100, 'b'));
+    bl.crc32c(0);
+    bl.rebuild();
+    bl.crc32c(0);
+    t.stop();
+    nstime_t end = spec_mono_now();
+    EXPECT_FALSE(tracer::on());
+
+    trace::trace_file f = read_trace(path);
+    ::unlink(path.c_str());
+    EXPECT_EQ(0u, f.dropped);
+    EXPECT_EQ(4000u, count_events(f, "test.loop"));
+    EXPECT_EQ(1u, count_events(f, "buffer.list.rebuild"));
+    EXPECT_EQ(2u, count_events(f, "buffer.list.crc32c"));
+    EXPECT_LE(1u, count_events(f, "buffer.list.alloc"));
+    EXPECT_EQ(0u, count_events(f, "test.disabled"));
+
+    bool found = false;
+    for (const auto& e : f.events) {
+        EXPECT_LE(start.to_nsec() - 1000000, e.ns);
+        EXPECT_GE(end.to_nsec() + 1000000, e.ns);
+        const std::string& name = f.defs[e.id].name;
+        if (name == "test.types") {
+            std::ostringstream p;
+            p << &x;
+            EXPECT_EQ("test.types: u 42 i -7 b true f 0.5 p " + p.str() + " e -1",
+                      trace::format(f, e));
+            found = true;
+        } else if (name == "test.no_args") {
+            EXPECT_EQ("test.no_args:", trace::format(f, e));
+        } else if (name == "buffer.list.crc32c" && e.args[2]) {
+            EXPECT_EQ(200u, e.args[1]);
+        }
+    }
+    EXPECT_TRUE(found);
+
+    // the events of a thread stay in order
+    uint64_t last[4] = {0};
+    int seen[4] = {0};
+    for (const auto& e : f.events) {
+        if (f.defs[e.id].name == "test.loop") {
+            int i = e.args[0];
+            EXPECT_EQ((uint64_t)seen[i]++, e.args[1]);
+            EXPECT_LE(last[i], e.ns);
+            last[i] = e.ns;
+        }
+    }
+}
+
+TEST(Trace, dropped) {
+    // a small ring, drained rarely: the overflow is counted, not blocked
+    std::string path = trace_path();
+    auto& t = tracer::instance();
+    ASSERT_EQ(-EINVAL, t.start(path, 1000));
+    uint64_t dropped = t.dropped();
+    ASSERT_EQ(0, t.start(path, 4096, 1000));
+    const int n = 10000;
+    std::thread th([] {
+        for (int j = 0; j < n; ++j) {
+            SPEC_TRACE("test.flood", "{}", j);
+        }
+    });
+    th.join();
+    t.stop();
+    EXPECT_LT(dropped, t.dropped());
+
+    trace::trace_file f = read_trace(path);
+    ::unlink(path.c_str());
+    EXPECT_LT(0u, f.dropped);
+    EXPECT_EQ((uint64_t)n, count_events(f, "test.flood") + f.dropped);
+}
+
+TEST(Trace, Bench) {
+    const int n = 10000000;
+    auto bench = [](const char *name, auto&& fn) {
+        nstime_t start = spec_mono_now();
+        for (int i = 0; i < n; ++i) {
+            fn(i);
+        }
+        nstime_t elapsed = spec_mono_now() - start;
+        std::cout << name << ": " << elapsed.to_nsec() / (double)n << "ns/op"
+                  << std::endl;
+    };
+    bench("disabled tracepoint", [](int i) {
+        SPEC_TRACE("test.bench", "{} {}", i, i);
+    });
+
+    std::string path = trace_path();
+    auto& t = tracer::instance();
+    ASSERT_EQ(0, t.start(path, 1 << 24, 1));
+    bench("enabled tracepoint", [](int i) {
+        SPEC_TRACE("test.bench", "{} {}", i, i);
+    });
+    t.stop();
+    std::cout << "dropped " << t.dropped() << std::endl;
+    ::unlink(path.c_str());
+}
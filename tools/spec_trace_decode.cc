@@ -0,0 +1,75 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright(c) 2020 Liu, Changcheng <changcheng.liu@aliyun.com>
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "trace/trace.h"
+
+/* Print a trace of spec::trace::tracer, one event per line:
+ *     <us since the first event> <tid> <name>: <args>
+ *         ||  spec_trace_decode /tmp/osd.trace
+ */
+static void usage() {
+    std::cerr << "usage: spec_trace_decode [--events] <trace file>" << std::endl
+              << "  --events    only list the event definitions" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    bool only_events = false;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--events")) {
+            only_events = true;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!path) {
+        usage();
+        return 1;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "failed to open " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::ostringstream data;
+    data << in.rdbuf();
+
+    spec::trace::trace_file t;
+    if (!spec::trace::decode(data.str(), t)) {
+        std::cerr << path << ": not a valid trace" << std::endl;
+        return 1;
+    }
+
+    if (only_events) {
+        for (size_t i = 0; i < t.defs.size(); ++i) {
+            std::cout << i << " " << t.defs[i].name << " \"" << t.defs[i].fmt
+                      << "\" " << t.defs[i].sig << std::endl;
+        }
+        return 0;
+    }
+
+    uint64_t first = t.events.empty() ? 0 : t.events.front().ns;
+    for (const auto& e : t.events) {
+        char ts[32];
+        snprintf(ts, sizeof(ts), "%.3f", (e.ns - first) / 1000.0);
+        std::cout << ts << " " << e.tid << " " << spec::trace::format(t, e) << "\n";
+    }
+    if (t.dropped) {
+        std::cerr << t.dropped << " events dropped" << std::endl;
+    }
+    return 0;
+}